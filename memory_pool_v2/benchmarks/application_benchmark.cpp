@@ -0,0 +1,534 @@
+// 应用场景的基准测试：用真实的数据结构代替随机的申请与归还，分别使用 std::allocator 与 pool_allocator
+// 每个场景分为构建、遍历、释放三个阶段，遍历阶段不调用分配器，它的耗时只取决于节点在内存中的排布（数据局部性）
+// 遍历时记录相邻两次访问的节点地址，统计落在同一页以及相距不超过 256 字节的比例，硬件计数器可用时还会统计缓存未命中
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "pool_allocator.h"
+#include "benchmarks/layer_benchmark.h"
+#include "benchmarks/perf_counters.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        size_t elements = 200000;           // 每个场景中节点的个数
+        size_t rounds = 3;                  // 每个场景重复的次数，取平均
+        std::vector<std::string> kernels = {"map", "unordered_map", "graph", "string", "json", "lru"};
+        std::string mode = "all";           // std / pool / all
+    };
+
+    // 相邻两次访问的地址之间的距离
+    struct locality {
+        uintptr_t last = 0;
+        uint64_t steps = 0;
+        uint64_t same_page = 0;
+        uint64_t near = 0;
+
+        void visit(const void* ptr) {
+            const auto address = reinterpret_cast<uintptr_t>(ptr);
+            if (last != 0) {
+                const uintptr_t distance = address > last ? address - last : last - address;
+                steps++;
+                same_page += address / 4096 == last / 4096;
+                near += distance <= 256;
+            }
+            last = address;
+        }
+    };
+
+    // 一个场景一轮的结果
+    struct kernel_result {
+        double build_ms = 0;
+        double traverse_ms = 0;
+        double destroy_ms = 0;
+        locality visits;
+        perf_counters::values counters;
+        uint64_t checksum = 0;
+    };
+
+    // 遍历的结果写到这里，防止被编译器优化掉
+    volatile uint64_t g_checksum_sink = 0;
+
+    using steady_clock = std::chrono::steady_clock;
+    double elapsed_ms(steady_clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(steady_clock::now() - begin).count();
+    }
+
+    // 每个场景的三个阶段，由场景填写
+    struct phases {
+        std::function<void()> build;
+        std::function<void(locality&, uint64_t&)> traverse;
+        std::function<void()> destroy;
+    };
+
+    kernel_result run_phases(const phases& kernel, perf_counters::thread_counters& counters) {
+        kernel_result result;
+        auto begin = steady_clock::now();
+        kernel.build();
+        result.build_ms = elapsed_ms(begin);
+        counters.start();
+        begin = steady_clock::now();
+        kernel.traverse(result.visits, result.checksum);
+        result.traverse_ms = elapsed_ms(begin);
+        result.counters = counters.stop();
+        begin = steady_clock::now();
+        kernel.destroy();
+        result.destroy_ms = elapsed_ms(begin);
+        return result;
+    }
+
+    // 有序与无序的映射：插入随机的键，按迭代顺序遍历
+    template <template <typename> class Alloc>
+    kernel_result map_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        using map_type = std::map<uint64_t, uint64_t, std::less<>, Alloc<std::pair<const uint64_t, uint64_t>>>;
+        map_type map;
+        return run_phases({
+            [&] {
+                std::mt19937_64 rng(1);
+                for (size_t i = 0; i < config.elements; i++) {
+                    map.emplace(rng(), i);
+                }
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                for (auto& entry : map) {
+                    visits.visit(&entry);
+                    checksum += entry.second;
+                }
+            },
+            [&] { map_type().swap(map); },
+        }, counters);
+    }
+
+    template <template <typename> class Alloc>
+    kernel_result unordered_map_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        using map_type = std::unordered_map<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<>, Alloc<std::pair<const uint64_t, uint64_t>>>;
+        map_type map;
+        return run_phases({
+            [&] {
+                std::mt19937_64 rng(2);
+                for (size_t i = 0; i < config.elements; i++) {
+                    map.emplace(rng(), i);
+                }
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                for (auto& entry : map) {
+                    visits.visit(&entry);
+                    checksum += entry.second;
+                }
+            },
+            [&] { map_type().swap(map); },
+        }, counters);
+    }
+
+    // 图：每个节点有若干条指向随机节点的边，构建以后从第一个节点开始广度优先遍历
+    template <template <typename> class Alloc>
+    kernel_result graph_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        struct node {
+            uint64_t value = 0;
+            uint64_t visited = 0;
+            std::vector<node*, Alloc<node*>> edges;
+        };
+        Alloc<node> allocator;
+        std::vector<node*, Alloc<node*>> nodes;
+        return run_phases({
+            [&] {
+                std::mt19937_64 rng(3);
+                for (size_t i = 0; i < config.elements; i++) {
+                    node* n = std::allocator_traits<Alloc<node>>::allocate(allocator, 1);
+                    std::allocator_traits<Alloc<node>>::construct(allocator, n);
+                    n->value = i;
+                    nodes.push_back(n);
+                }
+                // 先连成一条链保证所有节点都能访问到，再加入随机的边
+                std::uniform_int_distribution<size_t> pick(0, nodes.size() - 1);
+                for (size_t i = 0; i < nodes.size(); i++) {
+                    if (i + 1 < nodes.size()) {
+                        nodes[i]->edges.push_back(nodes[i + 1]);
+                    }
+                    for (int e = 0; e < 3; e++) {
+                        nodes[i]->edges.push_back(nodes[pick(rng)]);
+                    }
+                }
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                // 队列的空间一次准备好，遍历过程中不再调用分配器
+                std::vector<node*, Alloc<node*>> queue;
+                queue.reserve(nodes.size());
+                queue.push_back(nodes.front());
+                nodes.front()->visited = 1;
+                for (size_t head = 0; head < queue.size(); head++) {
+                    node* current = queue[head];
+                    visits.visit(current);
+                    checksum += current->value;
+                    for (node* next : current->edges) {
+                        if (next->visited == 0) {
+                            next->visited = 1;
+                            queue.push_back(next);
+                        }
+                    }
+                }
+            },
+            [&] {
+                for (node* n : nodes) {
+                    std::allocator_traits<Alloc<node>>::destroy(allocator, n);
+                    std::allocator_traits<Alloc<node>>::deallocate(allocator, n, 1);
+                }
+                decltype(nodes)().swap(nodes);
+            },
+        }, counters);
+    }
+
+    // 字符串拼接：在一个滑动窗口中不断用旧的字符串拼接出新的字符串，长度超过短字符串优化的范围
+    template <template <typename> class Alloc>
+    kernel_result string_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        using string_type = std::basic_string<char, std::char_traits<char>, Alloc<char>>;
+        const size_t window = std::max<size_t>(1, config.elements / 16);
+        std::vector<string_type, Alloc<string_type>> strings(window);
+        return run_phases({
+            [&] {
+                std::mt19937_64 rng(4);
+                std::uniform_int_distribution<size_t> length(16, 200);
+                for (size_t i = 0; i < config.elements; i++) {
+                    string_type& target = strings[i % window];
+                    const string_type& source = strings[rng() % window];
+                    string_type next(length(rng), static_cast<char>('a' + i % 26));
+                    // 长度过长时从头开始，避免字符串无限增长
+                    if (source.size() < 1024) {
+                        next += source;
+                    }
+                    target = std::move(next);
+                }
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                for (auto& text : strings) {
+                    visits.visit(text.data());
+                    for (char c : text) {
+                        checksum += static_cast<unsigned char>(c);
+                    }
+                }
+            },
+            [&] { decltype(strings)().swap(strings); },
+        }, counters);
+    }
+
+    // 类似 JSON 的树：先生成一段文本（不计时），每一轮解析成树、遍历、释放
+    template <template <typename> class Alloc>
+    kernel_result json_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        using string_type = std::basic_string<char, std::char_traits<char>, Alloc<char>>;
+        struct json_node {
+            enum class kind { object, array, string, number } type = kind::number;
+            double number = 0;
+            string_type key;
+            string_type text;
+            std::vector<json_node*, Alloc<json_node*>> children;
+        };
+
+        // 生成的文本：对象与数组嵌套，叶子节点是字符串或数字，节点总数大约是 elements
+        std::string source;
+        {
+            std::mt19937_64 rng(5);
+            size_t remaining = config.elements;
+            std::function<void(int)> generate = [&](int depth) {
+                const bool is_object = rng() % 2 == 0;
+                source += is_object ? '{' : '[';
+                const size_t count = 2 + rng() % 8;
+                for (size_t i = 0; i < count && remaining > 0; i++) {
+                    remaining--;
+                    if (i != 0) {
+                        source += ',';
+                    }
+                    if (is_object) {
+                        source += "\"key_" + std::to_string(rng() % 100000) + "\":";
+                    }
+                    const uint64_t choice = rng() % 10;
+                    if (depth < 12 && choice < 3) {
+                        generate(depth + 1);
+                    } else if (choice < 6) {
+                        source += "\"" + std::string(8 + rng() % 40, static_cast<char>('a' + rng() % 26)) + "\"";
+                    } else {
+                        source += std::to_string(rng() % 1000000);
+                    }
+                }
+                source += is_object ? '}' : ']';
+            };
+            source += '[';
+            while (remaining > 0) {
+                generate(0);
+                if (remaining > 0) {
+                    source += ',';
+                }
+            }
+            source += ']';
+        }
+
+        Alloc<json_node> allocator;
+        json_node* root = nullptr;
+        auto create = [&] {
+            json_node* node = std::allocator_traits<Alloc<json_node>>::allocate(allocator, 1);
+            std::allocator_traits<Alloc<json_node>>::construct(allocator, node);
+            return node;
+        };
+        std::function<void(json_node*)> free_tree = [&](json_node* node) {
+            for (json_node* child : node->children) {
+                free_tree(child);
+            }
+            std::allocator_traits<Alloc<json_node>>::destroy(allocator, node);
+            std::allocator_traits<Alloc<json_node>>::deallocate(allocator, node, 1);
+        };
+
+        return run_phases({
+            [&] {
+                // 只处理生成的文本中出现的语法：没有空白、没有转义
+                size_t pos = 0;
+                auto read_string = [&] {
+                    const size_t end = source.find('"', pos + 1);
+                    string_type result(source.data() + pos + 1, end - pos - 1);
+                    pos = end + 1;
+                    return result;
+                };
+                std::function<json_node*()> parse = [&]() -> json_node* {
+                    json_node* node = create();
+                    const char c = source[pos];
+                    if (c == '{' || c == '[') {
+                        node->type = c == '{' ? json_node::kind::object : json_node::kind::array;
+                        const char close = c == '{' ? '}' : ']';
+                        pos++;
+                        while (source[pos] != close) {
+                            string_type key;
+                            if (node->type == json_node::kind::object) {
+                                key = read_string();
+                                pos++; // ':'
+                            }
+                            json_node* child = parse();
+                            child->key = std::move(key);
+                            node->children.push_back(child);
+                            if (source[pos] == ',') {
+                                pos++;
+                            }
+                        }
+                        pos++;
+                    } else if (c == '"') {
+                        node->type = json_node::kind::string;
+                        node->text = read_string();
+                    } else {
+                        node->type = json_node::kind::number;
+                        const size_t begin = pos;
+                        while (pos < source.size() && source[pos] >= '0' && source[pos] <= '9') {
+                            pos++;
+                        }
+                        node->number = std::strtod(source.data() + begin, nullptr);
+                    }
+                    return node;
+                };
+                root = parse();
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                std::function<void(const json_node*)> walk = [&](const json_node* node) {
+                    visits.visit(node);
+                    checksum += static_cast<uint64_t>(node->number) + node->key.size() + node->text.size();
+                    for (const json_node* child : node->children) {
+                        walk(child);
+                    }
+                };
+                walk(root);
+            },
+            [&] {
+                free_tree(root);
+                root = nullptr;
+            },
+        }, counters);
+    }
+
+    // LRU 缓存：链表保存访问顺序，哈希表保存键到链表节点的映射，访问的键偏向一小部分热点
+    template <template <typename> class Alloc>
+    kernel_result lru_kernel(const benchmark_config& config, perf_counters::thread_counters& counters) {
+        using string_type = std::basic_string<char, std::char_traits<char>, Alloc<char>>;
+        using entry = std::pair<uint64_t, string_type>;
+        using list_type = std::list<entry, Alloc<entry>>;
+        using index_type = std::unordered_map<uint64_t, typename list_type::iterator, std::hash<uint64_t>, std::equal_to<>,
+            Alloc<std::pair<const uint64_t, typename list_type::iterator>>>;
+        const size_t capacity = std::max<size_t>(1, config.elements / 4);
+        list_type order;
+        index_type index;
+        return run_phases({
+            [&] {
+                std::mt19937_64 rng(6);
+                std::uniform_int_distribution<size_t> length(16, 256);
+                const uint64_t key_space = capacity * 4;
+                for (size_t i = 0; i < config.elements * 4; i++) {
+                    // 80% 的访问落在 20% 的键上
+                    const uint64_t key = rng() % 5 != 0 ? rng() % (key_space / 5 + 1) : rng() % key_space;
+                    auto found = index.find(key);
+                    if (found != index.end()) {
+                        order.splice(order.begin(), order, found->second);
+                        continue;
+                    }
+                    order.emplace_front(key, string_type(length(rng), 'v'));
+                    index.emplace(key, order.begin());
+                    if (order.size() > capacity) {
+                        index.erase(order.back().first);
+                        order.pop_back();
+                    }
+                }
+            },
+            [&](locality& visits, uint64_t& checksum) {
+                for (auto& [key, value] : order) {
+                    visits.visit(&key);
+                    checksum += key + value.size();
+                }
+            },
+            [&] {
+                index_type().swap(index);
+                list_type().swap(order);
+            },
+        }, counters);
+    }
+
+    template <template <typename> class Alloc>
+    kernel_result run_kernel(std::string_view name, const benchmark_config& config, perf_counters::thread_counters& counters) {
+        if (name == "map") {
+            return map_kernel<Alloc>(config, counters);
+        }
+        if (name == "unordered_map") {
+            return unordered_map_kernel<Alloc>(config, counters);
+        }
+        if (name == "graph") {
+            return graph_kernel<Alloc>(config, counters);
+        }
+        if (name == "string") {
+            return string_kernel<Alloc>(config, counters);
+        }
+        if (name == "json") {
+            return json_kernel<Alloc>(config, counters);
+        }
+        return lru_kernel<Alloc>(config, counters);
+    }
+
+    template <typename T>
+    using std_allocator = std::allocator<T>;
+    template <typename T>
+    using pool_allocator = memory_pool_v2::pool_allocator<T>;
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        perf_counters::thread_counters counters;
+        std::cout << "[" << mode << "]" << std::endl;
+        std::cout << layer_benchmark::column("场景", 16, true) << layer_benchmark::column("构建 ms", 10) << layer_benchmark::column("遍历 ms", 10)
+                  << layer_benchmark::column("释放 ms", 10) << layer_benchmark::column("总计 ms", 10) << layer_benchmark::column("同一页", 10)
+                  << layer_benchmark::column("<=256B", 10) << layer_benchmark::column("L1D 未命中", 14) << layer_benchmark::column("LLC 未命中", 14)
+                  << std::endl;
+        for (const auto& name : config.kernels) {
+            kernel_result total;
+            for (size_t round = 0; round < config.rounds; round++) {
+                const kernel_result result = mode == "pool" ? run_kernel<pool_allocator>(name, config, counters)
+                                                             : run_kernel<std_allocator>(name, config, counters);
+                total.build_ms += result.build_ms;
+                total.traverse_ms += result.traverse_ms;
+                total.destroy_ms += result.destroy_ms;
+                total.visits.steps += result.visits.steps;
+                total.visits.same_page += result.visits.same_page;
+                total.visits.near += result.visits.near;
+                total.counters.merge(result.counters, round == 0);
+                total.checksum += result.checksum;
+            }
+            const double rounds = static_cast<double>(config.rounds);
+            const double steps = static_cast<double>(std::max<uint64_t>(1, total.visits.steps));
+            // 硬件计数器按遍历的每个节点换算，不可用时显示 "-"
+            auto per_visit = [&](perf_counters::event e) {
+                if (!total.counters.has(e)) {
+                    return std::string("-");
+                }
+                std::ostringstream text;
+                text << std::fixed << std::setprecision(3) << static_cast<double>(total.counters[e]) / steps;
+                return text.str();
+            };
+            std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(2) << std::setw(10)
+                      << total.build_ms / rounds << std::setw(10) << total.traverse_ms / rounds << std::setw(10) << total.destroy_ms / rounds
+                      << std::setw(10) << (total.build_ms + total.traverse_ms + total.destroy_ms) / rounds << std::setprecision(1) << std::setw(9)
+                      << 100.0 * static_cast<double>(total.visits.same_page) / steps << "%" << std::setw(9)
+                      << 100.0 * static_cast<double>(total.visits.near) / steps << "%" << std::setw(14) << per_visit(perf_counters::event::l1d_misses)
+                      << std::setw(14) << per_visit(perf_counters::event::llc_misses) << std::endl;
+            g_checksum_sink = total.checksum;
+        }
+        if (!counters.unavailable_reason().empty()) {
+            std::cout << "  部分硬件计数器不可用: " << counters.unavailable_reason() << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    const std::vector<std::string> all_kernels = config.kernels;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        if (arg.starts_with("--elements=")) {
+            config.elements = value("--elements=");
+        } else if (arg.starts_with("--rounds=")) {
+            config.rounds = value("--rounds=");
+        } else if (arg.starts_with("--kernels=")) {
+            // 逗号分隔的场景名称
+            config.kernels.clear();
+            std::string_view names = arg.substr(10);
+            while (!names.empty()) {
+                const size_t comma = names.find(',');
+                const std::string name(names.substr(0, comma));
+                invalid |= std::ranges::find(all_kernels, name) == all_kernels.end();
+                config.kernels.push_back(name);
+                names = comma == std::string_view::npos ? std::string_view() : names.substr(comma + 1);
+            }
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            invalid = true;
+        }
+    }
+    if (invalid || config.elements == 0 || config.rounds == 0 || config.kernels.empty() ||
+        (config.mode != "all" && config.mode != "std" && config.mode != "pool")) {
+        std::cerr << "用法: " << argv[0] << " [--elements=200000] [--rounds=3] [--kernels=map,unordered_map,graph,string,json,lru]"
+                  << " [--mode=all|std|pool]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "应用场景基准测试: 节点数 " << config.elements << ", 每个场景重复 " << config.rounds << " 次取平均" << std::endl;
+    std::cout << "同一页 / <=256B: 遍历时相邻两次访问的地址在同一页 / 相距不超过 256 字节的比例; 未命中: 遍历阶段平均每个节点的次数" << std::endl;
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    // 每一种分配器都在新的子进程中测试，互不影响堆的状态
+    for (std::string_view mode : {"std", "pool"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
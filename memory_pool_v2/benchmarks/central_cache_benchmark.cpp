@@ -0,0 +1,118 @@
+// 中心缓存的微基准测试：绕过线程缓存，直接调用 central_cache 的 allocate / deallocate 批量申请与归还内存块
+// 依次测试不同的批量大小与线程数，每个线程保存最近的若干批内存块，每一步申请新的一批并归还最早的一批
+// 输出每一批的延迟、平均到每个内存块的开销，以及中心缓存的锁需要等待的次数
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "central_cache.h"
+#include "memory_pool.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/layer_benchmark.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        std::vector<size_t> block_counts = {1, 8, 64, 512}; // 依次测试的每批内存块个数
+        std::vector<size_t> threads = {1, 2, 4};           // 依次测试的线程数
+        size_t size = 64;                                  // 内存块的大小
+        size_t ops = 20000;                                // 每个线程申请的批数
+        size_t live = 8;                                   // 每个线程同时存活的批数
+    };
+
+    using memory_pool_v2::central_cache;
+    // 调试模式下一批最多取一页中 8 字节内存块的个数，与 page_span::MAX_UNIT_COUNT 相同
+    constexpr size_t MAX_BLOCK_COUNT = memory_pool_v2::size_utils::PAGE_SIZE / memory_pool_v2::size_utils::ALIGNMENT;
+
+    layer_benchmark::run_result run(const benchmark_config& config, size_t block_count, size_t threads) {
+        return layer_benchmark::run_threads(threads, [&](size_t, std::latch& start, layer_benchmark::thread_result& result) {
+            central_cache& cache = central_cache::get_instance();
+            const latency::timer& timer = latency::timer::get_instance();
+            std::deque<std::byte*> batches;
+            start.arrive_and_wait();
+
+            for (size_t i = 0; i < config.ops; i++) {
+                if (batches.size() == config.live) {
+                    const uint64_t begin = timer.now();
+                    cache.deallocate(batches.front(), config.size);
+                    result.deallocate.record(timer.elapsed_ns(begin, timer.now()));
+                    batches.pop_front();
+                }
+                const uint64_t begin = timer.now();
+                auto batch = cache.allocate(config.size, block_count);
+                result.allocate.record(timer.elapsed_ns(begin, timer.now()));
+                if (!batch.has_value()) {
+                    std::cerr << "分配失败" << std::endl;
+                    std::exit(1);
+                }
+                batches.push_back(*batch);
+            }
+            for (std::byte* batch : batches) {
+                cache.deallocate(batch, config.size);
+            }
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        auto list = [&](std::string_view prefix, std::vector<size_t>& target) {
+            auto result = layer_benchmark::parse_list(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            target = result.value_or(target);
+        };
+        if (arg.starts_with("--block-counts=")) {
+            list("--block-counts=", config.block_counts);
+        } else if (arg.starts_with("--threads=")) {
+            list("--threads=", config.threads);
+        } else if (arg.starts_with("--size=")) {
+            config.size = value("--size=");
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = value("--ops=");
+        } else if (arg.starts_with("--live=")) {
+            config.live = value("--live=");
+        } else {
+            invalid = true;
+        }
+    }
+    // 中心缓存只处理 8 的倍数的大小
+    for (size_t block_count : config.block_counts) {
+        invalid |= block_count > MAX_BLOCK_COUNT;
+    }
+    if (invalid || config.size == 0 || config.size % memory_pool_v2::size_utils::ALIGNMENT != 0 ||
+        config.size > memory_pool_v2::size_utils::MAX_CACHED_UNIT_SIZE || config.ops == 0 || config.live == 0) {
+        std::cerr << "用法: " << argv[0] << " [--block-counts=1,8,64,512] [--threads=1,2,4] [--size=64] [--ops=20000] [--live=8]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "中心缓存基准测试: 内存块大小 " << config.size << " B, 每个线程申请 " << config.ops << " 批, 存活 " << config.live
+              << " 批 (延迟单位 ns, 每批)" << std::endl;
+    latency::timer::get_instance();
+    layer_benchmark::print_header("块数 x 线程数");
+    for (size_t block_count : config.block_counts) {
+        for (size_t threads : config.threads) {
+            const size_t contention = memory_pool_v2::memory_pool::stats().lock_contention_count;
+            const auto result = run(config, block_count, threads);
+            const size_t total_contention = memory_pool_v2::memory_pool::stats().lock_contention_count - contention;
+            layer_benchmark::print_row(std::to_string(block_count) + " x " + std::to_string(threads), result, total_contention);
+            const double per_block = static_cast<double>(block_count);
+            std::cout << "    每个内存块: 申请 " << std::fixed << std::setprecision(2) << result.allocate.mean() / per_block << " ns, 归还 "
+                      << result.deallocate.mean() / per_block << " ns" << std::endl;
+        }
+    }
+    return 0;
+}
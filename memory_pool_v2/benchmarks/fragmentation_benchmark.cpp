@@ -0,0 +1,187 @@
+// 长时间运行的碎片化基准测试：反复地增长、随机替换、收缩存活的对象集合
+// 每一轮收缩以后统计中心缓存中页面的使用情况，对比不同的页面选择策略下有多少页面可以还给页缓存
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "central_cache.h"
+#include "memory_pool.h"
+#include "page_cache.h"
+
+namespace {
+    struct benchmark_config {
+        size_t live = 200'000;          // 增长阶段结束时存活的对象个数
+        size_t churn = 2'000'000;       // 每一轮随机替换的次数
+        size_t rounds = 5;
+        size_t keep_percent = 10;       // 收缩以后保留的比例
+        size_t max_size = 1024;         // 对象大小在 [8, max_size] 之间，小对象更多
+        size_t top = 4;                 // 输出页面字节数最多的几个规格的直方图
+        std::string policy = "all";     // fullest / emptiest / all
+    };
+
+    struct class_report {
+        size_t memory_size;
+        memory_pool_v2::span_occupancy occupancy;
+    };
+
+    std::vector<class_report> collect_occupancy(size_t max_size) {
+        std::vector<class_report> reports;
+        for (size_t size = memory_pool_v2::size_utils::ALIGNMENT; size <= max_size; size += memory_pool_v2::size_utils::ALIGNMENT) {
+            auto occupancy = memory_pool_v2::central_cache::get_instance().get_span_occupancy(size);
+            if (occupancy.span_bytes > 0) {
+                reports.push_back({size, occupancy});
+            }
+        }
+        return reports;
+    }
+
+    void print_histogram(const memory_pool_v2::span_occupancy& occupancy) {
+        std::cout << "空 " << std::setw(4) << occupancy.empty_span_count << " |";
+        for (auto count : occupancy.partial_span_count) {
+            std::cout << std::setw(5) << count;
+        }
+        std::cout << " | 满 " << std::setw(4) << occupancy.full_span_count;
+    }
+
+    void run_policy(const benchmark_config& config, std::string_view policy_name) {
+        memory_pool_v2::central_cache::get_instance().set_span_selection_policy(
+            policy_name == "fullest" ? memory_pool_v2::span_selection_policy::fullest : memory_pool_v2::span_selection_policy::emptiest);
+
+        std::mt19937_64 rng(2025);
+        // 对数分布的大小，小对象占多数
+        std::uniform_real_distribution<double> log_size(std::log(8.0), std::log(static_cast<double>(config.max_size)));
+        auto random_size = [&] { return static_cast<size_t>(std::exp(log_size(rng))); };
+
+        std::vector<std::pair<void*, size_t>> live;
+        live.reserve(config.live);
+        auto allocate_one = [&] {
+            const size_t size = random_size();
+            void* ptr = memory_pool_v2::memory_pool::allocate(size).value_or(nullptr);
+            if (ptr == nullptr) {
+                std::cerr << "分配失败" << std::endl;
+                std::exit(1);
+            }
+            memset(ptr, 0x3C, std::min<size_t>(size, 16));
+            live.emplace_back(ptr, size);
+        };
+        auto free_at = [&](size_t i) {
+            memory_pool_v2::memory_pool::deallocate(live[i].first, live[i].second);
+            live[i] = live.back();
+            live.pop_back();
+        };
+
+        std::cout << "--- 策略: " << policy_name << " ---" << std::endl;
+        for (size_t round = 0; round < config.rounds; round++) {
+            while (live.size() < config.live) {
+                allocate_one();
+            }
+            for (size_t i = 0; i < config.churn; i++) {
+                free_at(std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng));
+                allocate_one();
+            }
+            // 收缩，随机保留一部分对象
+            const size_t keep = config.live * config.keep_percent / 100;
+            while (live.size() > keep) {
+                free_at(std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng));
+            }
+
+            size_t live_bytes = 0;
+            for (auto& [_, size] : live) {
+                live_bytes += memory_pool_v2::size_utils::align(size);
+            }
+            size_t span_bytes = 0;
+            size_t allocated_bytes = 0;
+            memory_pool_v2::span_occupancy total;
+            auto reports = collect_occupancy(config.max_size);
+            for (auto& [memory_size, occupancy] : reports) {
+                span_bytes += occupancy.span_bytes;
+                allocated_bytes += occupancy.allocated_unit_count * memory_size;
+                total.empty_span_count += occupancy.empty_span_count;
+                total.full_span_count += occupancy.full_span_count;
+                for (size_t bucket = 0; bucket < memory_pool_v2::span_occupancy::BUCKET_COUNT; bucket++) {
+                    total.partial_span_count[bucket] += occupancy.partial_span_count[bucket];
+                }
+            }
+            std::cout << "第 " << round + 1 << " 轮收缩后 | 存活: " << std::fixed << std::setprecision(2) << live_bytes / 1048576.0 << " MB"
+                      << " | 中心缓存页面: " << span_bytes / 1048576.0 << " MB"
+                      << " | 页面利用率: " << (span_bytes ? 100.0 * allocated_bytes / span_bytes : 0.0) << "%"
+                      << " | 页缓存申请: " << memory_pool_v2::page_cache::get_instance().mapped_bytes() / 1048576.0 << " MB" << std::endl;
+            std::cout << "    全部规格  ";
+            print_histogram(total);
+            std::cout << std::endl;
+
+            std::sort(reports.begin(), reports.end(), [](const class_report& a, const class_report& b) {
+                return a.occupancy.span_bytes > b.occupancy.span_bytes;
+            });
+            for (size_t i = 0; i < std::min(config.top, reports.size()); i++) {
+                std::cout << "    " << std::setw(5) << reports[i].memory_size << " B    ";
+                print_histogram(reports[i].occupancy);
+                std::cout << std::endl;
+            }
+        }
+        for (auto& [ptr, size] : live) {
+            memory_pool_v2::memory_pool::deallocate(ptr, size);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--live=")) {
+            config.live = std::stoull(std::string(arg.substr(7)));
+        } else if (arg.starts_with("--churn=")) {
+            config.churn = std::stoull(std::string(arg.substr(8)));
+        } else if (arg.starts_with("--rounds=")) {
+            config.rounds = std::stoull(std::string(arg.substr(9)));
+        } else if (arg.starts_with("--keep-percent=")) {
+            config.keep_percent = std::stoull(std::string(arg.substr(15)));
+        } else if (arg.starts_with("--max-size=")) {
+            config.max_size = std::stoull(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--top=")) {
+            config.top = std::stoull(std::string(arg.substr(6)));
+        } else if (arg.starts_with("--policy=")) {
+            config.policy = arg.substr(9);
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--live=200000] [--churn=2000000] [--rounds=5] [--keep-percent=10] [--max-size=1024] [--top=4] [--policy=all|fullest|emptiest]" << std::endl;
+            return 1;
+        }
+    }
+    if (config.live == 0 || config.max_size < 8 || config.max_size > memory_pool_v2::size_utils::MAX_CACHED_UNIT_SIZE) {
+        std::cerr << "参数不合法" << std::endl;
+        return 1;
+    }
+
+    std::cout << "碎片化基准测试: 存活对象 " << config.live << ", 每轮替换 " << config.churn << " 次, " << config.rounds
+              << " 轮, 收缩后保留 " << config.keep_percent << "%, 大小 8 - " << config.max_size << " B" << std::endl;
+    std::cout << "直方图: 空页面个数 | 部分分配的页面按使用率 [0, 1/8) ... [7/8, 1) 分组的个数 | 满页面个数" << std::endl;
+    if (config.policy != "all") {
+        run_policy(config, config.policy);
+        return 0;
+    }
+    // 页面的状态是全局的，每一种策略都在新的子进程中测试
+    for (std::string_view policy : {"emptiest", "fullest"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_policy(config, policy);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
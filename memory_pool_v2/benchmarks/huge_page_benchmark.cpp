@@ -0,0 +1,180 @@
+// 大页感知模式的基准测试：用大量小对象组成一个随机顺序的链表，然后顺着链表访问（pointer chasing）
+// 每一次访问几乎都会落在不同的页面上，所以耗时主要取决于 dTLB 的命中率
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+#include "page_cache.h"
+
+namespace {
+    struct benchmark_config {
+        size_t total_mb = 1024;         // 链表节点占用的总内存
+        size_t node_size = 64;          // 每个节点的大小
+        size_t hops = 50'000'000;       // 访问的次数
+        std::string mode = "all";       // pool / pool_huge / malloc / all
+    };
+
+    // 打开一个只统计当前线程用户态事件的硬件计数器，失败时返回 -1
+    int open_counter(uint32_t type, uint64_t config) {
+        perf_event_attr attr {};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+    // 读取 /proc/self/smaps_rollup 中的 AnonHugePages，单位 KB
+    size_t read_anon_huge_pages_kb() {
+        std::ifstream file("/proc/self/smaps_rollup");
+        std::string key;
+        size_t value = 0;
+        while (file >> key) {
+            if (key == "AnonHugePages:") {
+                file >> value;
+                return value;
+            }
+            file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        return 0;
+    }
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        const bool use_pool = mode != "malloc";
+        if (mode == "pool_huge") {
+            memory_pool_v2::page_cache::get_instance().set_huge_page_mode(true);
+        }
+
+        const size_t node_count = config.total_mb * 1024 * 1024 / config.node_size;
+        std::vector<void*> nodes(node_count);
+        for (auto& node : nodes) {
+            node = use_pool ? memory_pool_v2::memory_pool::allocate(config.node_size).value_or(nullptr) : malloc(config.node_size);
+            if (node == nullptr) {
+                std::cerr << "分配失败" << std::endl;
+                std::exit(1);
+            }
+        }
+
+        // 按照随机的顺序把所有节点串成一个环
+        std::vector<size_t> order(node_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), std::mt19937_64(12345));
+        for (size_t i = 0; i < node_count; i++) {
+            *static_cast<void**>(nodes[order[i]]) = nodes[order[(i + 1) % node_count]];
+        }
+
+        const int dtlb_fd = open_counter(PERF_TYPE_HW_CACHE,
+                                         PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+
+        // 先走一遍预热，让所有的页面都完成缺页
+        void* current = nodes[order[0]];
+        for (size_t i = 0; i < node_count; i++) {
+            current = *static_cast<void**>(current);
+        }
+
+        if (dtlb_fd >= 0) {
+            ioctl(dtlb_fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(dtlb_fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < config.hops; i++) {
+            current = *static_cast<void**>(current);
+        }
+        auto end = std::chrono::steady_clock::now();
+        uint64_t dtlb_misses = 0;
+        if (dtlb_fd >= 0) {
+            ioctl(dtlb_fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(dtlb_fd, &dtlb_misses, sizeof(dtlb_misses)) != sizeof(dtlb_misses)) {
+                dtlb_misses = 0;
+            }
+            close(dtlb_fd);
+        }
+        // 防止编译器把整个循环优化掉
+        if (current == nullptr) {
+            std::cerr << "链表损坏" << std::endl;
+        }
+
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        std::cout << std::left << std::setw(12) << mode
+                  << " | 节点数: " << std::setw(10) << node_count
+                  << " | 每次访问: " << std::fixed << std::setprecision(2) << std::setw(8) << ns / config.hops << " ns"
+                  << " | dTLB miss/次: ";
+        if (dtlb_fd >= 0) {
+            std::cout << std::setw(6) << static_cast<double>(dtlb_misses) / config.hops;
+        } else {
+            std::cout << std::setw(6) << "N/A";
+        }
+        std::cout << " | AnonHugePages: " << read_anon_huge_pages_kb() / 1024 << " MB" << std::endl;
+
+        for (auto node : nodes) {
+            if (use_pool) {
+                memory_pool_v2::memory_pool::deallocate(node, config.node_size);
+            } else {
+                free(node);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--total-mb=")) {
+            config.total_mb = std::stoull(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--node-size=")) {
+            config.node_size = std::stoull(std::string(arg.substr(12)));
+        } else if (arg.starts_with("--hops=")) {
+            config.hops = std::stoull(std::string(arg.substr(7)));
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--total-mb=1024] [--node-size=64] [--hops=50000000] [--mode=all|pool|pool_huge|malloc]" << std::endl;
+            return 1;
+        }
+    }
+    if (config.node_size < sizeof(void*)) {
+        config.node_size = sizeof(void*);
+    }
+
+    std::cout << "指针追逐基准测试: 总大小 " << config.total_mb << " MB, 节点大小 " << config.node_size
+              << " B, 访问次数 " << config.hops << std::endl;
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    // 页缓存的模式只对新申请的页面生效，所以每一种模式都在新的子进程中测试
+    for (std::string_view mode : {"malloc", "pool", "pool_huge"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+// 统计开销的基准测试：同一份代码分别链接关闭与开启统计的库，对比热路径的耗时
+// memory_pool_instrumentation_benchmark_v2 使用默认的库（默认关闭统计，与没有统计的代码完全相同），
+// memory_pool_instrumented_benchmark_v2 使用开启统计的库，并在结束时输出各层的事件统计
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "instrumentation.h"
+#include "memory_pool.h"
+
+namespace {
+    struct benchmark_config {
+        size_t ops = 5'000'000;
+        size_t batch = 1024;
+        size_t repeat = 5;
+    };
+
+    // 同一个大小反复申请与归还，只走线程缓存的快速路径
+    void fast_path(const benchmark_config& config) {
+        for (size_t i = 0; i < config.ops; i++) {
+            void* ptr = memory_pool_v2::memory_pool::allocate(64).value_or(nullptr);
+            static_cast<volatile char*>(ptr)[0] = 1;
+            memory_pool_v2::memory_pool::deallocate(ptr, 64);
+        }
+    }
+
+    // 一次申请一批不同大小的内存块再全部归还，会经过中心缓存与页缓存
+    void batch(const benchmark_config& config, const std::vector<size_t>& sizes) {
+        std::vector<void*> ptrs(config.batch);
+        for (size_t done = 0; done < config.ops; done += config.batch) {
+            for (size_t i = 0; i < config.batch; i++) {
+                ptrs[i] = memory_pool_v2::memory_pool::allocate(sizes[i]).value_or(nullptr);
+                static_cast<volatile char*>(ptrs[i])[0] = 1;
+            }
+            for (size_t i = 0; i < config.batch; i++) {
+                memory_pool_v2::memory_pool::deallocate(ptrs[i], sizes[i]);
+            }
+        }
+    }
+
+    template<typename F>
+    double best_ns_per_op(const benchmark_config& config, F&& workload) {
+        double best = 0;
+        for (size_t round = 0; round < config.repeat; round++) {
+            auto start = std::chrono::steady_clock::now();
+            workload();
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            const double per_op = ns / static_cast<double>(config.ops);
+            best = round == 0 ? per_op : std::min(best, per_op);
+        }
+        return best;
+    }
+
+    void print_events() {
+        auto stats = memory_pool_v2::get_instrumentation_stats();
+        std::cout << std::left << std::setw(28) << "事件" << std::right << std::setw(14) << "次数" << std::setw(18) << "字节数"
+                  << "  最常见的大小区间" << std::endl;
+        for (size_t event = 0; event < stats.events.size(); event++) {
+            auto& event_stats = stats.events[event];
+            auto most_common = std::max_element(event_stats.size_histogram.begin(), event_stats.size_histogram.end());
+            const size_t bucket = most_common - event_stats.size_histogram.begin();
+            std::cout << std::left << std::setw(28) << memory_pool_v2::instrument_event_name(static_cast<memory_pool_v2::instrument_event>(event))
+                      << std::right << std::setw(14) << event_stats.count << std::setw(18) << event_stats.bytes;
+            if (event_stats.count > 0) {
+                std::cout << "  [" << (bucket == 0 ? 0 : 1ull << (bucket - 1)) << ", " << (1ull << bucket) << ") B";
+            }
+            std::cout << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--ops=")) {
+            config.ops = std::stoull(std::string(arg.substr(6)));
+        } else if (arg.starts_with("--batch=")) {
+            config.batch = std::stoull(std::string(arg.substr(8)));
+        } else if (arg.starts_with("--repeat=")) {
+            config.repeat = std::stoull(std::string(arg.substr(9)));
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--ops=5000000] [--batch=1024] [--repeat=5]" << std::endl;
+            return 1;
+        }
+    }
+    if (config.ops == 0 || config.batch == 0 || config.repeat == 0) {
+        std::cerr << "参数不合法" << std::endl;
+        return 1;
+    }
+
+    std::mt19937_64 rng(7);
+    std::uniform_int_distribution<size_t> size_distribution(8, 4096);
+    std::vector<size_t> sizes(config.batch);
+    for (auto& size : sizes) {
+        size = size_distribution(rng);
+    }
+
+    std::cout << "统计: " << (memory_pool_v2::instrumentation_enabled ? "开启" : "关闭")
+              << " | 操作数 " << config.ops << ", 每批 " << config.batch << " 个, 取 " << config.repeat << " 轮中最快的一轮" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "快速路径 (64 B 申请 + 归还): " << best_ns_per_op(config, [&] { fast_path(config); }) << " ns/op" << std::endl;
+    std::cout << "批量 (8 - 4096 B 随机大小):   " << best_ns_per_op(config, [&] { batch(config, sizes); }) << " ns/op" << std::endl;
+    if (memory_pool_v2::instrumentation_enabled) {
+        print_events();
+    }
+    return 0;
+}
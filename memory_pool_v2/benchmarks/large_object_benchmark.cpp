@@ -0,0 +1,152 @@
+// 大内存块的基准测试：每个线程维护一组存活的内存块，随机替换其中的一个
+// 大小在 [min-size, max-size] 之间按对数均匀分布，覆盖 performance_test 没有覆盖的 16KB - 4MB 区间
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+
+namespace {
+    struct benchmark_config {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t ops = 200'000;               // 每个线程的操作次数
+        size_t live = 64;                   // 每个线程同时存活的内存块个数
+        size_t min_size = 16 * 1024;
+        size_t max_size = 4 * 1024 * 1024;
+        std::string mode = "all";           // pool / malloc / all
+    };
+
+    // 生成按对数均匀分布的大小序列，两种模式使用相同的序列
+    std::vector<std::pair<size_t, size_t>> make_operations(const benchmark_config& config, size_t thread_id) {
+        std::mt19937_64 rng(12345 + thread_id);
+        std::uniform_real_distribution<double> log_size(std::log(static_cast<double>(config.min_size)),
+                                                        std::log(static_cast<double>(config.max_size)));
+        std::uniform_int_distribution<size_t> slot(0, config.live - 1);
+        std::vector<std::pair<size_t, size_t>> operations(config.ops);
+        for (auto& [index, size] : operations) {
+            index = slot(rng);
+            size = static_cast<size_t>(std::exp(log_size(rng)));
+        }
+        return operations;
+    }
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        const bool use_pool = mode == "pool";
+        std::vector<std::vector<std::pair<size_t, size_t>>> operations;
+        for (size_t t = 0; t < config.threads; t++) {
+            operations.push_back(make_operations(config, t));
+        }
+
+        auto worker = [&](size_t thread_id) {
+            std::vector<std::pair<void*, size_t>> slots(config.live, {nullptr, 0});
+            for (auto [index, size] : operations[thread_id]) {
+                auto& [ptr, old_size] = slots[index];
+                if (ptr != nullptr) {
+                    if (use_pool) {
+                        memory_pool_v2::memory_pool::deallocate(ptr, old_size);
+                    } else {
+                        free(ptr);
+                    }
+                }
+                ptr = use_pool ? memory_pool_v2::memory_pool::allocate(size).value_or(nullptr) : malloc(size);
+                if (ptr == nullptr) {
+                    std::cerr << "分配失败" << std::endl;
+                    std::exit(1);
+                }
+                old_size = size;
+                // 只写首尾两个字节，模拟只使用了一部分的缓冲区
+                static_cast<volatile char*>(ptr)[0] = 1;
+                static_cast<volatile char*>(ptr)[size - 1] = 1;
+            }
+            for (auto [ptr, size] : slots) {
+                if (ptr == nullptr) continue;
+                if (use_pool) {
+                    memory_pool_v2::memory_pool::deallocate(ptr, size);
+                } else {
+                    free(ptr);
+                }
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < config.threads; t++) {
+            threads.emplace_back(worker, t);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        const double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        const double total_ops = static_cast<double>(config.threads * config.ops);
+        std::cout << std::left << std::setw(8) << mode
+                  << " | 总耗时: " << std::fixed << std::setprecision(1) << std::setw(8) << ns / 1e6 << " ms"
+                  << " | 每次替换: " << std::setprecision(1) << std::setw(8) << ns / total_ops * config.threads << " ns"
+                  << " | 吞吐量: " << std::setprecision(2) << std::setw(8) << total_ops / ns * 1e3 << " M ops/s"
+                  << " | 峰值 RSS: " << usage.ru_maxrss / 1024 << " MB"
+                  << " | 缺页 (minor): " << usage.ru_minflt << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--threads=")) {
+            config.threads = std::stoull(std::string(arg.substr(10)));
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = std::stoull(std::string(arg.substr(6)));
+        } else if (arg.starts_with("--live=")) {
+            config.live = std::stoull(std::string(arg.substr(7)));
+        } else if (arg.starts_with("--min-size=")) {
+            config.min_size = std::stoull(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--max-size=")) {
+            config.max_size = std::stoull(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--threads=N] [--ops=200000] [--live=64] [--min-size=16384] [--max-size=4194304] [--mode=all|pool|malloc]" << std::endl;
+            return 1;
+        }
+    }
+    if (config.threads == 0 || config.live == 0 || config.min_size == 0 || config.min_size > config.max_size) {
+        std::cerr << "参数不合法" << std::endl;
+        return 1;
+    }
+
+    std::cout << "大内存块基准测试: 线程数 " << config.threads << ", 每线程操作数 " << config.ops
+              << ", 每线程存活块数 " << config.live << ", 大小 " << config.min_size << " - " << config.max_size << " B" << std::endl;
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    // 每一种分配器都在新的子进程中测试，峰值 RSS 互不影响
+    for (std::string_view mode : {"malloc", "pool"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
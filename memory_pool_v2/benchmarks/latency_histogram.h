@@ -0,0 +1,200 @@
+//
+// Created by ghost-him on 25-5-11.
+//
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LATENCY_HAS_TSC 1
+#else
+#define LATENCY_HAS_TSC 0
+#endif
+
+// 基准测试中单次操作的计时与延迟分布
+// 计时使用 TSC，开销只有几纳秒；延迟记录在每个线程自己的对数线性直方图中，结束时合并，不需要保存每一次的样本
+namespace latency {
+
+    // 对数线性直方图（与 HdrHistogram 相同的分组方式）
+    // 小于 2^SUB_BUCKET_BITS 的值每个值一组；之后每个 2 的幂区间再等分为 2^SUB_BUCKET_BITS 组，相对误差不超过 1/32
+    class histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 5;
+        static constexpr size_t SUB_BUCKET_COUNT = size_t(1) << SUB_BUCKET_BITS;
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        void record(uint64_t value) {
+            m_counts[index_of(value)]++;
+            m_count++;
+            m_sum += value;
+            m_max = std::max(m_max, value);
+        }
+
+        void merge(const histogram& other) {
+            for (size_t i = 0; i < BUCKET_COUNT; i++) {
+                m_counts[i] += other.m_counts[i];
+            }
+            m_count += other.m_count;
+            m_sum += other.m_sum;
+            m_max = std::max(m_max, other.m_max);
+        }
+
+        void clear() {
+            m_counts.fill(0);
+            m_count = 0;
+            m_sum = 0;
+            m_max = 0;
+        }
+
+        /// 第 p 百分位（p 在 0 到 1 之间）所在组的上界，不超过记录过的最大值
+        uint64_t percentile(double p) const {
+            if (m_count == 0) {
+                return 0;
+            }
+            const uint64_t target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(m_count))));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKET_COUNT; i++) {
+                seen += m_counts[i];
+                if (seen >= target) {
+                    return std::min(upper_bound_of(i), m_max);
+                }
+            }
+            return m_max;
+        }
+
+        uint64_t count() const { return m_count; }
+        uint64_t sum() const { return m_sum; }
+        uint64_t max() const { return m_max; }
+        double mean() const { return m_count == 0 ? 0.0 : static_cast<double>(m_sum) / static_cast<double>(m_count); }
+
+        static size_t index_of(uint64_t value) {
+            if (value < SUB_BUCKET_COUNT) {
+                return static_cast<size_t>(value);
+            }
+            // value 在 [2^e, 2^(e+1)) 中，取最高的 SUB_BUCKET_BITS + 1 位
+            const int e = std::bit_width(value) - 1;
+            const uint64_t sub = (value >> (e - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+            return (e - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + static_cast<size_t>(sub);
+        }
+
+        static uint64_t upper_bound_of(size_t index) {
+            if (index < SUB_BUCKET_COUNT) {
+                return index;
+            }
+            const size_t block = index / SUB_BUCKET_COUNT;
+            const uint64_t sub = index % SUB_BUCKET_COUNT;
+            const int shift = static_cast<int>(block) - 1;
+            const uint64_t lower = (SUB_BUCKET_COUNT + sub) << shift;
+            return lower + ((uint64_t(1) << shift) - 1);
+        }
+
+    private:
+        std::array<uint64_t, BUCKET_COUNT> m_counts = {};
+        uint64_t m_count = 0;
+        uint64_t m_sum = 0;
+        uint64_t m_max = 0;
+    };
+
+    // 输出用的百分位数，单位为纳秒
+    struct percentiles {
+        uint64_t count = 0;
+        double mean = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+        uint64_t max = 0;
+    };
+
+    inline percentiles summarize(const histogram& h) {
+        return {h.count(), h.mean(), h.percentile(0.5), h.percentile(0.9), h.percentile(0.99), h.percentile(0.999), h.max()};
+    }
+
+    // 计时器：支持不变的 TSC 时使用 rdtsc，否则使用 steady_clock
+    // 启动时校准每个计数对应的纳秒数，以及连续两次读取之间的固有开销，测量的结果会减去这个开销
+    class timer {
+    public:
+        static const timer& get_instance() {
+            static timer instance;
+            return instance;
+        }
+
+        /// 读取当前的计数，前面的 lfence 保证之前的指令已经执行完
+        uint64_t now() const {
+#if LATENCY_HAS_TSC
+            if (m_use_tsc) {
+                _mm_lfence();
+                const uint64_t ticks = __rdtsc();
+                _mm_lfence();
+                return ticks;
+            }
+#endif
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        /// 把两次读取之间的计数差转换为纳秒，并减去计时本身的开销
+        uint64_t elapsed_ns(uint64_t start, uint64_t end) const {
+            const uint64_t ticks = end > start + m_overhead_ticks ? end - start - m_overhead_ticks : 0;
+            return static_cast<uint64_t>(static_cast<double>(ticks) * m_ns_per_tick + 0.5);
+        }
+
+        bool uses_tsc() const { return m_use_tsc; }
+        double ns_per_tick() const { return m_ns_per_tick; }
+        uint64_t overhead_ticks() const { return m_overhead_ticks; }
+        double overhead_ns() const { return static_cast<double>(m_overhead_ticks) * m_ns_per_tick; }
+
+    private:
+        timer() {
+            m_use_tsc = LATENCY_HAS_TSC && has_invariant_tsc();
+            if (m_use_tsc) {
+                // 与 steady_clock 对比 20ms，得到 TSC 的频率
+                const auto wall_start = std::chrono::steady_clock::now();
+                const uint64_t tick_start = now();
+                while (std::chrono::steady_clock::now() - wall_start < std::chrono::milliseconds(20)) {
+                }
+                const uint64_t tick_end = now();
+                const double wall_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - wall_start).count();
+                m_ns_per_tick = wall_ns / static_cast<double>(tick_end - tick_start);
+            }
+            // 连续两次读取的最小差值就是计时本身的开销
+            uint64_t overhead = UINT64_MAX;
+            for (int i = 0; i < 10000; i++) {
+                const uint64_t start = now();
+                const uint64_t end = now();
+                overhead = std::min(overhead, end - start);
+            }
+            m_overhead_ticks = overhead;
+        }
+
+        // 频率不随 CPU 调频与休眠变化的 TSC 才能用来计时
+        static bool has_invariant_tsc() {
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(cpuinfo, line)) {
+                if (line.starts_with("flags")) {
+                    return line.find(" constant_tsc") != std::string::npos && line.find(" nonstop_tsc") != std::string::npos;
+                }
+            }
+            return false;
+        }
+
+        bool m_use_tsc = false;
+        double m_ns_per_tick = 1.0;
+        uint64_t m_overhead_ticks = 0;
+    };
+
+} // latency
+
+#endif //LATENCY_HISTOGRAM_H
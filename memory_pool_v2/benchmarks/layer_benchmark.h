@@ -0,0 +1,109 @@
+//
+// Created by ghost-him on 25-5-11.
+//
+
+#ifndef LAYER_BENCHMARK_H
+#define LAYER_BENCHMARK_H
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/workload.h"
+
+// 单独测试某一层的微基准测试共用的部分：多个线程同时开始，分别记录每种操作的延迟，结束后合并
+namespace layer_benchmark {
+
+    // 一个线程中两种操作（申请与归还）的延迟
+    struct thread_result {
+        latency::histogram allocate;
+        latency::histogram deallocate;
+    };
+
+    struct run_result {
+        double seconds = 0;
+        latency::histogram allocate;
+        latency::histogram deallocate;
+    };
+
+    /// 启动 threads 个线程执行 body(线程编号, 开始的信号, 线程的结果)，返回总耗时与合并后的延迟
+    /// body 在准备工作完成后调用 start.arrive_and_wait()，之前的部分不计入总耗时
+    template <typename Body>
+    run_result run_threads(size_t threads, Body body) {
+        std::vector<thread_result> results(threads);
+        std::latch start(static_cast<std::ptrdiff_t>(threads + 1));
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] { body(t, start, results[t]); });
+        }
+        start.arrive_and_wait();
+        const auto begin = std::chrono::steady_clock::now();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        run_result result;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        for (auto& thread : results) {
+            result.allocate.merge(thread.allocate);
+            result.deallocate.merge(thread.deallocate);
+        }
+        return result;
+    }
+
+    /// 解析逗号分隔的正整数列表，比如 "1,2,4"
+    inline std::optional<std::vector<size_t>> parse_list(std::string_view text) {
+        std::vector<size_t> result;
+        while (!text.empty()) {
+            const size_t comma = text.find(',');
+            auto value = workload::parse_size(text.substr(0, comma));
+            if (!value.has_value() || *value == 0) {
+                return std::nullopt;
+            }
+            result.push_back(*value);
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+        }
+        if (result.empty()) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    /// 按显示宽度对齐的一列，中文字符占 3 个字节但只占 2 列，setw 按字节计算时需要补上差值
+    inline std::string column(std::string_view text, size_t width, bool left = false) {
+        size_t display = 0;
+        for (unsigned char c : text) {
+            if ((c & 0xC0) != 0x80) {
+                display += c >= 0xE0 ? 2 : 1;
+            }
+        }
+        const std::string padding(display < width ? width - display : 0, ' ');
+        return left ? std::string(text) + padding : padding + std::string(text);
+    }
+
+    /// 输出表头与一行结果，每次操作的平均、p50、p99 延迟，以及这次运行期间锁需要等待的次数
+    inline void print_header(std::string_view label) {
+        std::cout << column(label, 20, true) << column("吞吐 M/s", 12) << column("申请 平均", 10) << column("p50", 8) << column("p99", 8)
+                  << column("归还 平均", 10) << column("p50", 8) << column("p99", 8) << column("锁等待", 12) << std::endl;
+    }
+
+    inline void print_row(const std::string& label, const run_result& result, size_t contention) {
+        const auto allocate = latency::summarize(result.allocate);
+        const auto deallocate = latency::summarize(result.deallocate);
+        const double operations = static_cast<double>(allocate.count + deallocate.count);
+        std::cout << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(2) << std::setw(12)
+                  << (result.seconds > 0 ? operations / result.seconds / 1e6 : 0.0) << std::setprecision(1) << std::setw(10) << allocate.mean
+                  << std::setw(8) << allocate.p50 << std::setw(8) << allocate.p99 << std::setw(10) << deallocate.mean << std::setw(8)
+                  << deallocate.p50 << std::setw(8) << deallocate.p99 << std::setw(12) << contention << std::endl;
+    }
+
+} // layer_benchmark
+
+#endif //LAYER_BENCHMARK_H
@@ -0,0 +1,116 @@
+// 页缓存的微基准测试：绕过线程缓存与中心缓存，直接调用 allocate_page / deallocate_page
+// 每个线程保存若干段存活的页面，每一步随机替换其中一段，页数在给定范围内随机，空闲页会被不断地切分与合并
+// 输出每次申请与归还的延迟、页面的锁需要等待的次数，以及结束时的空闲页段数（碎片的程度）
+#include <cstdlib>
+#include <iostream>
+#include <latch>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "page_cache.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/layer_benchmark.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        std::vector<size_t> threads = {1, 2, 4};   // 依次测试的线程数
+        size_t ops = 200000;                        // 每个线程替换的次数
+        size_t live = 256;                          // 每个线程同时存活的页面段数
+        size_t min_pages = 1;
+        size_t max_pages = 16;
+    };
+
+    using memory_pool_v2::memory_span;
+    using memory_pool_v2::page_cache;
+
+    layer_benchmark::run_result run(const benchmark_config& config, size_t threads) {
+        return layer_benchmark::run_threads(threads, [&](size_t t, std::latch& start, layer_benchmark::thread_result& result) {
+            page_cache& cache = page_cache::get_instance();
+            const latency::timer& timer = latency::timer::get_instance();
+            std::mt19937_64 rng(1234 + t);
+            std::uniform_int_distribution<size_t> page_distribution(config.min_pages, config.max_pages);
+            std::uniform_int_distribution<size_t> slot_distribution(0, config.live - 1);
+            std::vector<std::optional<memory_span>> slots(config.live);
+            start.arrive_and_wait();
+
+            for (size_t i = 0; i < config.ops; i++) {
+                auto& slot = slots[slot_distribution(rng)];
+                if (slot.has_value()) {
+                    const uint64_t begin = timer.now();
+                    cache.deallocate_page(*slot);
+                    result.deallocate.record(timer.elapsed_ns(begin, timer.now()));
+                }
+                const size_t page_count = page_distribution(rng);
+                const uint64_t begin = timer.now();
+                slot = cache.allocate_page(page_count);
+                result.allocate.record(timer.elapsed_ns(begin, timer.now()));
+                if (!slot.has_value()) {
+                    std::cerr << "分配失败" << std::endl;
+                    std::exit(1);
+                }
+            }
+            for (auto& slot : slots) {
+                if (slot.has_value()) {
+                    cache.deallocate_page(*slot);
+                }
+            }
+        });
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        if (arg.starts_with("--threads=")) {
+            auto list = layer_benchmark::parse_list(arg.substr(10));
+            invalid |= !list.has_value();
+            config.threads = list.value_or(config.threads);
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = value("--ops=");
+        } else if (arg.starts_with("--live=")) {
+            config.live = value("--live=");
+        } else if (arg.starts_with("--pages=")) {
+            // 页数的范围，比如 1-16
+            const std::string_view range = arg.substr(8);
+            const size_t dash = range.find('-');
+            auto low = workload::parse_size(range.substr(0, dash));
+            auto high = dash == std::string_view::npos ? low : workload::parse_size(range.substr(dash + 1));
+            invalid |= !low.has_value() || !high.has_value();
+            config.min_pages = low.value_or(0);
+            config.max_pages = high.value_or(0);
+        } else {
+            invalid = true;
+        }
+    }
+    if (invalid || config.ops == 0 || config.live == 0 || config.min_pages == 0 || config.min_pages > config.max_pages) {
+        std::cerr << "用法: " << argv[0] << " [--threads=1,2,4] [--ops=200000] [--live=256] [--pages=1-16]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "页缓存基准测试: 每个线程替换 " << config.ops << " 次, 存活 " << config.live << " 段, 页数 " << config.min_pages << " - "
+              << config.max_pages << " (延迟单位 ns)" << std::endl;
+    latency::timer::get_instance();
+    page_cache& cache = page_cache::get_instance();
+    layer_benchmark::print_header("线程数");
+    for (size_t threads : config.threads) {
+        const size_t contention = cache.lock_contention_count();
+        const auto result = run(config, threads);
+        layer_benchmark::print_row(std::to_string(threads), result, cache.lock_contention_count() - contention);
+    }
+    const auto stats = cache.get_stats();
+    std::cout << "结束时向系统申请 " << static_cast<double>(stats.mapped_bytes) / 1024.0 / 1024.0 << " MB, 空闲页 "
+              << stats.free_span_count << " 段, 共 " << static_cast<double>(stats.free_bytes) / 1024.0 / 1024.0 << " MB" << std::endl;
+    return 0;
+}
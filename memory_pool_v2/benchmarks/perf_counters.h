@@ -0,0 +1,173 @@
+//
+// Created by ghost-him on 25-5-11.
+//
+
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// 基准测试中每个线程的硬件计数器
+// 使用 perf_event_open 只统计调用线程自己的事件；虚拟机、容器或者 perf_event_paranoid 不允许时对应的计数器不可用，其他统计照常进行
+namespace perf_counters {
+
+    enum class event : size_t {
+        cycles,
+        instructions,
+        l1d_misses,
+        llc_misses,
+        dtlb_misses,
+        page_faults,
+    };
+    constexpr size_t EVENT_COUNT = 6;
+
+    inline const char* event_name(event e) {
+        switch (e) {
+            case event::cycles: return "周期";
+            case event::instructions: return "指令";
+            case event::l1d_misses: return "L1D 未命中";
+            case event::llc_misses: return "LLC 未命中";
+            case event::dtlb_misses: return "dTLB 未命中";
+            case event::page_faults: return "缺页";
+        }
+        return "";
+    }
+
+    // 一组计数器的结果，可以在线程之间累加；不可用的计数器 available 为 false
+    // 只包含数组，可以直接通过共享内存从子进程传回
+    struct values {
+        std::array<uint64_t, EVENT_COUNT> counts = {};
+        std::array<bool, EVENT_COUNT> available = {};
+
+        uint64_t operator[](event e) const { return counts[static_cast<size_t>(e)]; }
+        bool has(event e) const { return available[static_cast<size_t>(e)]; }
+
+        /// 合并另一个线程的结果，任何一个线程不可用的计数器都视为不可用
+        void merge(const values& other, bool first) {
+            for (size_t i = 0; i < EVENT_COUNT; i++) {
+                counts[i] += other.counts[i];
+                available[i] = (first || available[i]) && other.available[i];
+            }
+        }
+    };
+
+    // 调用线程的计数器，构造时打开，start/stop 之间的事件被统计
+    // 每个计数器单独打开而不是作为一组，硬件计数器不够时由内核轮流使用，读取时按实际运行的时间比例换算
+    class thread_counters {
+    public:
+        thread_counters() {
+            for (size_t i = 0; i < EVENT_COUNT; i++) {
+                m_fds[i] = open(static_cast<event>(i), m_unavailable_reason);
+            }
+        }
+
+        ~thread_counters() {
+            for (int fd : m_fds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+        }
+
+        thread_counters(const thread_counters&) = delete;
+        thread_counters& operator=(const thread_counters&) = delete;
+
+        void start() {
+            for (int fd : m_fds) {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+            }
+        }
+
+        /// 停止统计并读取 start 以来的结果
+        values stop() {
+            for (int fd : m_fds) {
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+                }
+            }
+            values result;
+            for (size_t i = 0; i < EVENT_COUNT; i++) {
+                if (m_fds[i] < 0) {
+                    continue;
+                }
+                // 值，启用的时间，实际计数的时间
+                uint64_t data[3] = {};
+                if (read(m_fds[i], data, sizeof(data)) != sizeof(data)) {
+                    continue;
+                }
+                result.available[i] = true;
+                result.counts[i] = data[2] == 0 || data[2] >= data[1] ? data[0]
+                    : static_cast<uint64_t>(static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]));
+            }
+            return result;
+        }
+
+        /// 第一个打开失败的计数器与原因，全部可用时为空
+        const std::string& unavailable_reason() const {
+            return m_unavailable_reason;
+        }
+
+    private:
+        static int open(event e, std::string& unavailable_reason) {
+            perf_event_attr attr{};
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            switch (e) {
+                case event::cycles:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                    break;
+                case event::instructions:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                    break;
+                case event::l1d_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case event::llc_misses:
+                    attr.type = PERF_TYPE_HARDWARE;
+                    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                    break;
+                case event::dtlb_misses:
+                    attr.type = PERF_TYPE_HW_CACHE;
+                    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                    break;
+                case event::page_faults:
+                    attr.type = PERF_TYPE_SOFTWARE;
+                    attr.config = PERF_COUNT_SW_PAGE_FAULTS;
+                    break;
+            }
+            // 分配器在内核中的时间（缺页、mmap）也要统计，没有权限时只统计用户态
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+            if (fd < 0 && unavailable_reason.empty()) {
+                unavailable_reason = std::string(event_name(e)) + ": " + std::strerror(errno);
+            }
+            return fd;
+        }
+
+        std::array<int, EVENT_COUNT> m_fds = {};
+        std::string m_unavailable_reason;
+    };
+
+} // perf_counters
+
+#endif //PERF_COUNTERS_H
@@ -0,0 +1,377 @@
+// 生产者/消费者基准测试：内存块由一个线程申请，通过队列交给另一个线程归还
+// 其他基准测试中每个线程只归还自己申请的内存块，这里测试的是内存块在线程缓存之间迁移、堆积到中心缓存的路径
+// spsc: 每一对生产者与消费者之间有一个单生产者单消费者队列，生产者轮流发给每个消费者（扇出），消费者轮流读取每个生产者（扇入）
+// mpmc: 所有线程共用一个多生产者多消费者队列
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        size_t producers = 1;
+        size_t consumers = 1;
+        std::string queue = "spsc";         // spsc / mpmc
+        size_t ops = 1'000'000;             // 每个生产者申请的内存块个数
+        size_t capacity = 1024;             // 每个队列的容量，决定了同时存活的内存块个数的上限
+        workload::size_distribution sizes = workload::size_distribution::parse("uniform:8-1024").value();
+        size_t samples = 10;                // 运行期间记录 RSS 的次数
+        std::string mode = "all";           // pool / malloc / all
+    };
+
+    struct item {
+        void* ptr = nullptr;
+        size_t size = 0;
+    };
+
+    // 单生产者单消费者的环形队列，头尾各占一个缓存行
+    class spsc_queue {
+    public:
+        explicit spsc_queue(size_t capacity) : m_items(capacity + 1) {}
+
+        bool push(const item& value) {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            const size_t next = tail + 1 == m_items.size() ? 0 : tail + 1;
+            if (next == m_head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            m_items[tail] = value;
+            m_tail.store(next, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(item& value) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire)) {
+                return false;
+            }
+            value = m_items[head];
+            m_head.store(head + 1 == m_items.size() ? 0 : head + 1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        std::vector<item> m_items;
+        alignas(64) std::atomic<size_t> m_head = 0;
+        alignas(64) std::atomic<size_t> m_tail = 0;
+    };
+
+    // 有界的多生产者多消费者队列，每个位置带一个序号（Dmitry Vyukov 的做法）
+    class mpmc_queue {
+    public:
+        explicit mpmc_queue(size_t capacity) : m_mask(std::bit_ceil(capacity) - 1), m_cells(std::bit_ceil(capacity)) {
+            for (size_t i = 0; i < m_cells.size(); i++) {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        bool push(const item& value) {
+            size_t position = m_enqueue.load(std::memory_order_relaxed);
+            while (true) {
+                cell& c = m_cells[position & m_mask];
+                const size_t sequence = c.sequence.load(std::memory_order_acquire);
+                if (sequence == position) {
+                    if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        c.value = value;
+                        c.sequence.store(position + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (sequence < position) {
+                    return false;
+                } else {
+                    position = m_enqueue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool pop(item& value) {
+            size_t position = m_dequeue.load(std::memory_order_relaxed);
+            while (true) {
+                cell& c = m_cells[position & m_mask];
+                const size_t sequence = c.sequence.load(std::memory_order_acquire);
+                if (sequence == position + 1) {
+                    if (m_dequeue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = c.value;
+                        c.sequence.store(position + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                } else if (sequence < position + 1) {
+                    return false;
+                } else {
+                    position = m_dequeue.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct cell {
+            std::atomic<size_t> sequence;
+            item value;
+        };
+        const size_t m_mask;
+        std::vector<cell> m_cells;
+        alignas(64) std::atomic<size_t> m_enqueue = 0;
+        alignas(64) std::atomic<size_t> m_dequeue = 0;
+    };
+
+    size_t read_rss_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        if (!(statm >> total_pages >> resident_pages)) {
+            return 0;
+        }
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        const bool use_pool = mode == "pool";
+        const bool use_spsc = config.queue == "spsc";
+        // spsc 时第 p 个生产者发给第 c 个消费者的队列是 spsc_queues[p * consumers + c]
+        std::vector<std::unique_ptr<spsc_queue>> spsc_queues;
+        std::unique_ptr<mpmc_queue> shared_queue;
+        if (use_spsc) {
+            for (size_t i = 0; i < config.producers * config.consumers; i++) {
+                spsc_queues.push_back(std::make_unique<spsc_queue>(config.capacity));
+            }
+        } else {
+            shared_queue = std::make_unique<mpmc_queue>(config.capacity);
+        }
+
+        // 每个生产者的大小序列在开始前生成，两种模式使用相同的序列
+        std::vector<std::vector<size_t>> sizes(config.producers);
+        for (size_t p = 0; p < config.producers; p++) {
+            std::mt19937_64 rng(54321 + p);
+            sizes[p].resize(config.ops);
+            std::ranges::generate(sizes[p], [&] { return config.sizes.sample(rng); });
+        }
+
+        const latency::timer& timer = latency::timer::get_instance();
+        std::vector<latency::histogram> allocate_latency(config.producers);
+        std::vector<latency::histogram> deallocate_latency(config.consumers);
+        std::atomic<size_t> producers_running = config.producers;
+        std::atomic<size_t> consumed = 0;
+        std::latch ready(config.producers + config.consumers + 1);
+        const auto before = use_pool ? memory_pool_v2::memory_pool::stats() : memory_pool_v2::memory_pool_stats {};
+        const size_t baseline_rss = read_rss_bytes();
+
+        auto producer = [&](size_t p) {
+            auto& histogram = allocate_latency[p];
+            ready.arrive_and_wait();
+            size_t consumer = 0;
+            for (size_t size : sizes[p]) {
+                const uint64_t begin = timer.now();
+                void* ptr = use_pool ? memory_pool_v2::memory_pool::allocate(size).value_or(nullptr) : malloc(size);
+                histogram.record(timer.elapsed_ns(begin, timer.now()));
+                if (ptr == nullptr) {
+                    std::cerr << "分配失败" << std::endl;
+                    std::exit(1);
+                }
+                static_cast<volatile char*>(ptr)[0] = 1;
+                const item value {ptr, size};
+                if (use_spsc) {
+                    while (!spsc_queues[p * config.consumers + consumer]->push(value)) {
+                        std::this_thread::yield();
+                    }
+                    consumer = consumer + 1 == config.consumers ? 0 : consumer + 1;
+                } else {
+                    while (!shared_queue->push(value)) {
+                        std::this_thread::yield();
+                    }
+                }
+            }
+            producers_running.fetch_sub(1, std::memory_order_release);
+        };
+
+        auto consumer = [&](size_t c) {
+            auto& histogram = deallocate_latency[c];
+            ready.arrive_and_wait();
+            size_t producer_index = 0;
+            size_t idle = 0;
+            while (true) {
+                item value;
+                bool got = false;
+                if (use_spsc) {
+                    // 从上一次的位置开始轮流检查每个生产者的队列
+                    for (size_t i = 0; i < config.producers && !got; i++) {
+                        got = spsc_queues[producer_index * config.consumers + c]->pop(value);
+                        producer_index = producer_index + 1 == config.producers ? 0 : producer_index + 1;
+                    }
+                } else {
+                    got = shared_queue->pop(value);
+                }
+                if (!got) {
+                    // 所有生产者都结束以后再检查一遍，队列为空时才退出
+                    if (producers_running.load(std::memory_order_acquire) == 0 && ++idle > config.producers) {
+                        break;
+                    }
+                    std::this_thread::yield();
+                    continue;
+                }
+                idle = 0;
+                // 读一次内存块，模拟消费者使用收到的数据
+                (void)static_cast<volatile char*>(value.ptr)[0];
+                const uint64_t begin = timer.now();
+                if (use_pool) {
+                    memory_pool_v2::memory_pool::deallocate(value.ptr, value.size);
+                } else {
+                    free(value.ptr);
+                }
+                histogram.record(timer.elapsed_ns(begin, timer.now()));
+                consumed.fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < config.producers; p++) {
+            threads.emplace_back(producer, p);
+        }
+        for (size_t c = 0; c < config.consumers; c++) {
+            threads.emplace_back(consumer, c);
+        }
+
+        // 按消费的进度记录 RSS，同时存活的内存块个数有上限，RSS 持续增长说明内存没有被复用
+        const size_t total = config.producers * config.ops;
+        std::vector<std::pair<double, size_t>> timeline;
+        ready.arrive_and_wait();
+        const auto start = std::chrono::steady_clock::now();
+        size_t next_sample = 1;
+        while (true) {
+            const size_t done = consumed.load(std::memory_order_relaxed);
+            if (done * config.samples >= next_sample * total) {
+                const size_t rss = read_rss_bytes();
+                timeline.emplace_back(static_cast<double>(done) / static_cast<double>(total), rss > baseline_rss ? rss - baseline_rss : 0);
+                next_sample++;
+            }
+            if (done == total) {
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const size_t end_rss = read_rss_bytes();
+
+        latency::histogram allocate;
+        latency::histogram deallocate;
+        for (auto& histogram : allocate_latency) {
+            allocate.merge(histogram);
+        }
+        for (auto& histogram : deallocate_latency) {
+            deallocate.merge(histogram);
+        }
+        auto print_latency = [](const char* label, const latency::histogram& histogram) {
+            const auto p = latency::summarize(histogram);
+            std::cout << "  " << label << std::fixed << std::setprecision(1) << " 平均 " << p.mean << " | p50 " << p.p50 << " | p99 " << p.p99
+                      << " | p99.9 " << p.p999 << " | 最大 " << p.max << " (ns)" << std::endl;
+        };
+        const double mb = 1024.0 * 1024.0;
+        std::cout << "[" << mode << "] 总耗时 " << std::fixed << std::setprecision(1) << seconds * 1e3 << " ms | 吞吐量 " << std::setprecision(2)
+                  << static_cast<double>(total) / seconds / 1e6 << " M 个内存块/s" << std::endl;
+        print_latency("申请 (生产者)", allocate);
+        print_latency("归还 (消费者)", deallocate);
+        std::cout << "  RSS 增量 (MB) 随进度的变化:";
+        for (auto [progress, rss] : timeline) {
+            std::cout << " " << std::setprecision(0) << progress * 100 << "%:" << std::setprecision(2) << static_cast<double>(rss) / mb;
+        }
+        std::cout << std::endl;
+        if (timeline.size() >= 2) {
+            // 第一次记录时已经达到了稳定的存活内存，之后的增长就是漂移
+            const double drift = static_cast<double>(timeline.back().second) - static_cast<double>(timeline.front().second);
+            std::cout << "  内存漂移 (最后一次 - 第一次记录): " << std::setprecision(2) << drift / mb << " MB, 全部归还后 RSS 增量 "
+                      << static_cast<double>(end_rss > baseline_rss ? end_rss - baseline_rss : 0) / mb << " MB" << std::endl;
+        }
+        if (use_pool) {
+            const auto after = memory_pool_v2::memory_pool::stats();
+            std::cout << "  中心缓存锁等待 " << after.lock_contention_count - before.lock_contention_count << " 次"
+                      << " | 线程缓存向中心缓存申请 " << after.refill_count - before.refill_count << " 次, 归还 "
+                      << after.overflow_count - before.overflow_count << " 次" << std::endl;
+            std::cout << "  结束时线程缓存中空闲 " << static_cast<double>(after.thread_cache_bytes) / mb << " MB, 中心缓存中空闲 "
+                      << static_cast<double>(after.central_cache_bytes) / mb << " MB, 页缓存中空闲 "
+                      << static_cast<double>(after.pages.free_bytes) / mb << " MB" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value() || *result == 0;
+            return result.value_or(1);
+        };
+        if (arg.starts_with("--producers=")) {
+            config.producers = value("--producers=");
+        } else if (arg.starts_with("--consumers=")) {
+            config.consumers = value("--consumers=");
+        } else if (arg.starts_with("--queue=")) {
+            config.queue = arg.substr(8);
+            invalid |= config.queue != "spsc" && config.queue != "mpmc";
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = value("--ops=");
+        } else if (arg.starts_with("--capacity=")) {
+            config.capacity = value("--capacity=");
+        } else if (arg.starts_with("--sizes=")) {
+            auto sizes = workload::size_distribution::parse(arg.substr(8));
+            invalid |= !sizes.has_value();
+            config.sizes = sizes.value_or(config.sizes);
+        } else if (arg.starts_with("--samples=")) {
+            config.samples = value("--samples=");
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            invalid = true;
+        }
+    }
+    if (invalid) {
+        std::cerr << "用法: " << argv[0] << " [--producers=1] [--consumers=1] [--queue=spsc|mpmc] [--ops=1000000] [--capacity=1024]"
+                  << " [--sizes=uniform:8-1024] [--samples=10] [--mode=all|pool|malloc]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "生产者/消费者基准测试: " << config.producers << " 个生产者, " << config.consumers << " 个消费者, " << config.queue
+              << " 队列 (容量 " << config.capacity << "), 每个生产者申请 " << config.ops << " 个内存块, 大小 " << config.sizes.describe() << std::endl;
+    // 先校准计时器，子进程会继承校准的结果
+    latency::timer::get_instance();
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    // 每一种分配器都在新的子进程中测试，RSS 互不影响
+    for (std::string_view mode : {"malloc", "pool"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
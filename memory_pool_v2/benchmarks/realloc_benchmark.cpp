@@ -0,0 +1,150 @@
+// 不断增长的缓冲区的基准测试：从 start-kb 开始反复翻倍直到 max-mb，只统计调整大小本身的耗时
+// 每次翻倍以后都会写满新增的部分，这样复制的方式需要真正复制已经写过的数据
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <string_view>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+
+namespace {
+    struct benchmark_config {
+        size_t start_kb = 1024;
+        size_t max_mb = 1024;
+        size_t rounds = 3;
+        std::string mode = "all";       // pool / pool_copy / realloc / malloc_copy / all
+    };
+
+    void* allocate(std::string_view mode, size_t size) {
+        if (mode == "pool" || mode == "pool_copy") {
+            return memory_pool_v2::memory_pool::allocate(size).value_or(nullptr);
+        }
+        return malloc(size);
+    }
+
+    void* reallocate(std::string_view mode, void* ptr, size_t old_size, size_t new_size) {
+        if (mode == "pool" || mode == "pool_copy") {
+            return memory_pool_v2::memory_pool::reallocate(ptr, old_size, new_size).value_or(nullptr);
+        }
+        if (mode == "realloc") {
+            return realloc(ptr, new_size);
+        }
+        void* result = malloc(new_size);
+        if (result != nullptr) {
+            memcpy(result, ptr, old_size);
+            free(ptr);
+        }
+        return result;
+    }
+
+    void deallocate(std::string_view mode, void* ptr, size_t size) {
+        if (mode == "pool" || mode == "pool_copy") {
+            memory_pool_v2::memory_pool::deallocate(ptr, size);
+        } else {
+            free(ptr);
+        }
+    }
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        if (mode == "pool_copy") {
+            // 不使用单独 mmap，每次调整大小都要复制
+            memory_pool_v2::memory_pool::set_direct_map_threshold(std::numeric_limits<size_t>::max());
+        }
+        const size_t start_size = config.start_kb * 1024;
+        const size_t max_size = config.max_mb * 1024 * 1024;
+
+        std::chrono::steady_clock::duration total {};
+        size_t steps = 0;
+        size_t moved = 0;
+        for (size_t round = 0; round < config.rounds; round++) {
+            size_t size = start_size;
+            auto buffer = static_cast<std::byte*>(allocate(mode, size));
+            if (buffer == nullptr) {
+                std::cerr << "分配失败" << std::endl;
+                std::exit(1);
+            }
+            memset(buffer, 0x5A, size);
+            while (size * 2 <= max_size) {
+                auto start = std::chrono::steady_clock::now();
+                auto grown = static_cast<std::byte*>(reallocate(mode, buffer, size, size * 2));
+                total += std::chrono::steady_clock::now() - start;
+                if (grown == nullptr) {
+                    std::cerr << "调整大小失败: " << size * 2 << " B" << std::endl;
+                    std::exit(1);
+                }
+                if (grown != buffer) {
+                    moved++;
+                }
+                if (grown[size - 1] != std::byte{0x5A}) {
+                    std::cerr << "数据损坏" << std::endl;
+                    std::exit(1);
+                }
+                buffer = grown;
+                memset(buffer + size, 0x5A, size);
+                size *= 2;
+                steps++;
+            }
+            deallocate(mode, buffer, size);
+        }
+
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        const double ms = std::chrono::duration<double, std::milli>(total).count();
+        std::cout << std::left << std::setw(12) << mode
+                  << " | 调整大小总耗时: " << std::fixed << std::setprecision(2) << std::setw(9) << ms << " ms"
+                  << " | 平均每次: " << std::setw(8) << ms / static_cast<double>(steps) << " ms"
+                  << " | 地址改变: " << moved << "/" << steps
+                  << " | 峰值 RSS: " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--start-kb=")) {
+            config.start_kb = std::stoull(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--max-mb=")) {
+            config.max_mb = std::stoull(std::string(arg.substr(9)));
+        } else if (arg.starts_with("--rounds=")) {
+            config.rounds = std::stoull(std::string(arg.substr(9)));
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            std::cerr << "用法: " << argv[0] << " [--start-kb=1024] [--max-mb=1024] [--rounds=3] [--mode=all|pool|pool_copy|realloc|malloc_copy]" << std::endl;
+            return 1;
+        }
+    }
+    if (config.start_kb == 0 || config.rounds == 0) {
+        std::cerr << "参数不合法" << std::endl;
+        return 1;
+    }
+
+    std::cout << "缓冲区翻倍基准测试: 从 " << config.start_kb << " KB 翻倍到 " << config.max_mb << " MB, 重复 "
+              << config.rounds << " 轮" << std::endl;
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    for (std::string_view mode : {"malloc_copy", "realloc", "pool_copy", "pool"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+// 长时间运行的稳态测试：负载分为若干个阶段循环执行，每个阶段使用不同的大小分布，存活的总字节数保持不变
+// 每个线程保存一组存活的内存块，不断随机替换其中的一个；阶段切换时按新的分布调整存活的个数
+// 定期输出 RSS、各层的字节数与吞吐量，并比较每一轮（所有阶段执行一遍）的 RSS 峰值，内存没有稳定下来时以非 0 的返回值结束
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "memory_pool.h"
+#include "benchmarks/layer_benchmark.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        double duration = 60;               // 总时长（秒）
+        double phase = 5;                   // 每个阶段的时长（秒）
+        double report = 1;                  // 输出的间隔（秒）
+        size_t threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t live_bytes = 64 * 1024 * 1024; // 所有线程存活的内存块的总字节数
+        std::vector<std::string> phases = {"powerlaw:8-512:1.5", "uniform:1024-16384", "bimodal:32,4096:90", "uniform:16384-131072"};
+        size_t warmup_cycles = 1;           // 不参与稳定性判断的轮数
+        double tolerance = 10;              // 允许的 RSS 峰值增长（百分比）
+        std::string log;                    // 每次输出同时写入的 CSV 文件
+        std::string mode = "pool";          // pool / malloc
+    };
+
+    // 一个阶段的大小分布，以及按存活字节数换算出的每个线程的存活个数
+    struct phase_info {
+        workload::size_distribution sizes;
+        size_t live_per_thread = 0;
+    };
+
+    // 每个线程的操作次数，放在不同的缓存行中
+    struct alignas(64) thread_counter {
+        std::atomic<uint64_t> ops = 0;
+    };
+
+    size_t read_rss_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        if (!(statm >> total_pages >> resident_pages)) {
+            return 0;
+        }
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    /// 解析时长，支持 s / m / h 后缀，没有后缀时单位为秒
+    std::optional<double> parse_duration(std::string_view text) {
+        double unit = 1;
+        if (text.ends_with('s')) {
+            text.remove_suffix(1);
+        } else if (text.ends_with('m')) {
+            unit = 60;
+            text.remove_suffix(1);
+        } else if (text.ends_with('h')) {
+            unit = 3600;
+            text.remove_suffix(1);
+        }
+        auto value = workload::parse_double(text);
+        if (!value.has_value() || *value <= 0) {
+            return std::nullopt;
+        }
+        return *value * unit;
+    }
+
+    int run(const benchmark_config& config) {
+        const bool use_pool = config.mode == "pool";
+        auto allocate = [use_pool](size_t size) -> void* {
+            return use_pool ? memory_pool_v2::memory_pool::allocate(size).value_or(nullptr) : malloc(size);
+        };
+        auto deallocate = [use_pool](void* ptr, size_t size) {
+            if (use_pool) {
+                memory_pool_v2::memory_pool::deallocate(ptr, size);
+            } else {
+                free(ptr);
+            }
+        };
+
+        // 采样估计每个分布的平均大小，使每个阶段存活的总字节数大致相同
+        std::vector<phase_info> phases;
+        std::mt19937_64 sample_rng(7);
+        for (const auto& spec : config.phases) {
+            phase_info info {*workload::size_distribution::parse(spec)};
+            double total = 0;
+            for (int i = 0; i < 10000; i++) {
+                total += static_cast<double>(info.sizes.sample(sample_rng));
+            }
+            const double mean = total / 10000;
+            info.live_per_thread = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(config.live_bytes) / mean / static_cast<double>(config.threads)));
+            std::cout << "  阶段 " << phases.size() << ": " << info.sizes.describe() << ", 平均 " << std::fixed << std::setprecision(0) << mean
+                      << " B, 每个线程存活 " << info.live_per_thread << " 个" << std::endl;
+            phases.push_back(std::move(info));
+        }
+
+        std::atomic<size_t> current_phase = 0;
+        std::atomic<bool> stop = false;
+        std::vector<thread_counter> counters(config.threads);
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < config.threads; t++) {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 rng(1000 + t);
+                // 直方图分布在采样时会修改内部状态，每个线程使用自己的副本
+                std::vector<phase_info> local_phases = phases;
+                std::vector<std::pair<void*, size_t>> live;
+                size_t phase = static_cast<size_t>(-1);
+                uint64_t ops = 0;
+                while (!stop.load(std::memory_order_relaxed)) {
+                    // 阶段切换时调整存活的个数，多余的内存块直接归还
+                    const size_t next_phase = current_phase.load(std::memory_order_relaxed);
+                    if (next_phase != phase) {
+                        phase = next_phase;
+                        const size_t target = local_phases[phase].live_per_thread;
+                        while (live.size() > target) {
+                            deallocate(live.back().first, live.back().second);
+                            live.pop_back();
+                        }
+                        while (live.size() < target) {
+                            const size_t size = local_phases[phase].sizes.sample(rng);
+                            live.emplace_back(allocate(size), size);
+                        }
+                    }
+                    // 每次检查阶段之间执行一小批操作
+                    for (int i = 0; i < 256; i++) {
+                        auto& slot = live[rng() % live.size()];
+                        deallocate(slot.first, slot.second);
+                        slot.second = local_phases[phase].sizes.sample(rng);
+                        slot.first = allocate(slot.second);
+                        if (slot.first == nullptr) {
+                            std::cerr << "分配失败" << std::endl;
+                            std::exit(1);
+                        }
+                        static_cast<volatile char*>(slot.first)[0] = 1;
+                    }
+                    ops += 256;
+                    counters[t].ops.store(ops, std::memory_order_relaxed);
+                }
+                for (auto [ptr, size] : live) {
+                    deallocate(ptr, size);
+                }
+            });
+        }
+
+        std::ofstream log;
+        if (!config.log.empty()) {
+            log.open(config.log);
+            log << "seconds,phase,ops_per_second,rss_bytes,thread_cache_bytes,central_cache_bytes,page_free_bytes,mapped_bytes\n";
+        }
+        constexpr double mb = 1024.0 * 1024.0;
+        using layer_benchmark::column;
+        std::cout << column("时间 s", 8) << column("阶段", 6) << column("M ops/s", 12) << column("RSS MB", 10);
+        if (use_pool) {
+            std::cout << column("线程缓存", 12) << column("中心缓存", 12) << column("空闲页", 12) << column("已申请", 12);
+        }
+        std::cout << std::endl;
+
+        const size_t cycle_length = phases.size();
+        std::vector<size_t> cycle_peaks;
+        size_t peak = 0;
+        uint64_t last_ops = 0;
+        const auto start = std::chrono::steady_clock::now();
+        auto last_report = start;
+        for (size_t report = 1;; report++) {
+            const auto next = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(config.report * report));
+            std::this_thread::sleep_until(next);
+            const auto now = std::chrono::steady_clock::now();
+            const double seconds = std::chrono::duration<double>(now - start).count();
+
+            uint64_t ops = 0;
+            for (auto& counter : counters) {
+                ops += counter.ops.load(std::memory_order_relaxed);
+            }
+            const double rate = static_cast<double>(ops - last_ops) / std::chrono::duration<double>(now - last_report).count();
+            last_ops = ops;
+            last_report = now;
+            const size_t rss = read_rss_bytes();
+            const size_t phase = current_phase.load(std::memory_order_relaxed);
+            peak = std::max(peak, rss);
+
+            std::cout << std::fixed << std::setprecision(1) << std::setw(8) << seconds << std::setw(6) << phase << std::setprecision(2)
+                      << std::setw(12) << rate / 1e6 << std::setw(10) << static_cast<double>(rss) / mb;
+            memory_pool_v2::memory_pool_stats stats;
+            if (use_pool) {
+                stats = memory_pool_v2::memory_pool::stats();
+                std::cout << std::setw(12) << static_cast<double>(stats.thread_cache_bytes) / mb << std::setw(12)
+                          << static_cast<double>(stats.central_cache_bytes) / mb << std::setw(12) << static_cast<double>(stats.pages.free_bytes) / mb
+                          << std::setw(12) << static_cast<double>(stats.pages.mapped_bytes) / mb;
+            }
+            std::cout << std::endl;
+            if (log.is_open()) {
+                log << seconds << ',' << phase << ',' << rate << ',' << rss << ',' << stats.thread_cache_bytes << ',' << stats.central_cache_bytes
+                    << ',' << stats.pages.free_bytes << ',' << stats.pages.mapped_bytes << std::endl;
+            }
+
+            if (seconds >= config.duration) {
+                break;
+            }
+            // 切换阶段，所有阶段都执行过一遍时记录这一轮的峰值
+            const size_t elapsed_phases = static_cast<size_t>(seconds / config.phase);
+            while (cycle_peaks.size() < elapsed_phases / cycle_length) {
+                cycle_peaks.push_back(peak);
+                peak = 0;
+            }
+            current_phase.store(elapsed_phases % cycle_length, std::memory_order_relaxed);
+        }
+        stop = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        std::cout << "每一轮的 RSS 峰值 (MB):";
+        for (size_t i = 0; i < cycle_peaks.size(); i++) {
+            std::cout << " " << std::setprecision(1) << static_cast<double>(cycle_peaks[i]) / mb << (i < config.warmup_cycles ? "(预热)" : "");
+        }
+        std::cout << std::endl;
+        if (cycle_peaks.size() < config.warmup_cycles + 2) {
+            std::cout << "完整的轮数不足 " << config.warmup_cycles + 2 << " 轮，无法判断内存是否稳定，请增加 --duration 或减小 --phase" << std::endl;
+            return 0;
+        }
+        // 预热以后的第一轮作为基准，最后一轮的峰值超过基准的 tolerance% 时认为内存在持续增长（另外允许 1MB 的误差）
+        const double baseline = static_cast<double>(cycle_peaks[config.warmup_cycles]);
+        const double last = static_cast<double>(cycle_peaks.back());
+        const double limit = baseline * (1 + config.tolerance / 100) + mb;
+        std::cout << "基准 " << baseline / mb << " MB, 最后一轮 " << last / mb << " MB, 上限 " << limit / mb << " MB: ";
+        if (last > limit) {
+            std::cout << "内存没有稳定下来" << std::endl;
+            return 2;
+        }
+        std::cout << "内存已经稳定" << std::endl;
+        return 0;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto duration = [&](std::string_view prefix) {
+            auto result = parse_duration(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        if (arg.starts_with("--duration=")) {
+            config.duration = duration("--duration=");
+        } else if (arg.starts_with("--phase=")) {
+            config.phase = duration("--phase=");
+        } else if (arg.starts_with("--report=")) {
+            config.report = duration("--report=");
+        } else if (arg.starts_with("--threads=")) {
+            auto threads = workload::parse_size(arg.substr(10));
+            invalid |= !threads.has_value() || *threads == 0;
+            config.threads = threads.value_or(1);
+        } else if (arg.starts_with("--live-bytes=")) {
+            auto bytes = workload::parse_size(arg.substr(13));
+            invalid |= !bytes.has_value() || *bytes == 0;
+            config.live_bytes = bytes.value_or(1);
+        } else if (arg.starts_with("--phases=")) {
+            // 分号分隔的大小分布，格式与其他基准测试的 --sizes 相同
+            config.phases.clear();
+            std::string_view specs = arg.substr(9);
+            while (!specs.empty()) {
+                const size_t separator = specs.find(';');
+                const std::string spec(specs.substr(0, separator));
+                invalid |= !workload::size_distribution::parse(spec).has_value();
+                config.phases.push_back(spec);
+                specs = separator == std::string_view::npos ? std::string_view() : specs.substr(separator + 1);
+            }
+            invalid |= config.phases.empty();
+        } else if (arg.starts_with("--warmup-cycles=")) {
+            auto cycles = workload::parse_size(arg.substr(16));
+            invalid |= !cycles.has_value();
+            config.warmup_cycles = cycles.value_or(0);
+        } else if (arg.starts_with("--tolerance=")) {
+            auto tolerance = workload::parse_double(arg.substr(12));
+            invalid |= !tolerance.has_value() || *tolerance < 0;
+            config.tolerance = tolerance.value_or(0);
+        } else if (arg.starts_with("--log=")) {
+            config.log = arg.substr(6);
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            invalid = true;
+        }
+    }
+    if (invalid || config.report > config.phase || (config.mode != "pool" && config.mode != "malloc")) {
+        std::cerr << "用法: " << argv[0] << " [--duration=60s|10m|2h] [--phase=5s] [--report=1s] [--threads=N] [--live-bytes=64M]"
+                  << " [--phases=分布;分布;...] [--warmup-cycles=1] [--tolerance=10] [--log=soak.csv] [--mode=pool|malloc]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "稳态测试 [" << config.mode << "]: 时长 " << config.duration << " s, 每个阶段 " << config.phase << " s, 线程数 " << config.threads
+              << ", 存活 " << static_cast<double>(config.live_bytes) / 1024.0 / 1024.0 << " MB" << std::endl;
+    return run(config);
+}
@@ -0,0 +1,139 @@
+// 线程缓存快速路径的微基准测试：直接调用 thread_cache 的 allocate / deallocate，先预热使空闲链表中有足够的内存块
+// 之后每一次申请与归还都不会访问中心缓存，测得的就是快速路径本身的开销
+// 单次操作只有几纳秒，逐次计时的误差太大，所以对整个循环计时再平均，重复多次取最好与平均的结果
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "memory_pool.h"
+#include "thread_cache.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/layer_benchmark.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        std::vector<size_t> sizes = {16, 64, 256, 1024};
+        size_t ops = 1'000'000;         // 每次重复中申请与归还的次数
+        size_t batch = 64;              // 批量模式下一次连续申请的个数，需要小于空闲链表的上限
+        size_t repeat = 5;
+    };
+
+    using memory_pool_v2::thread_cache;
+
+    struct loop_result {
+        double best_ns = 0;
+        double mean_ns = 0;
+    };
+
+    /// 重复执行 body 并计时，返回每次操作的最好与平均耗时
+    template <typename Body>
+    loop_result time_loop(const benchmark_config& config, size_t operations, Body body) {
+        const latency::timer& timer = latency::timer::get_instance();
+        loop_result result;
+        result.best_ns = 1e18;
+        for (size_t r = 0; r < config.repeat; r++) {
+            const uint64_t begin = timer.now();
+            body();
+            const double ns = static_cast<double>(timer.elapsed_ns(begin, timer.now())) / static_cast<double>(operations);
+            result.best_ns = std::min(result.best_ns, ns);
+            result.mean_ns += ns / static_cast<double>(config.repeat);
+        }
+        return result;
+    }
+
+    void run_size(const benchmark_config& config, size_t size) {
+        thread_cache& cache = thread_cache::get_instance();
+        std::vector<void*> ptrs(config.batch);
+        auto allocate = [&](size_t i) {
+            ptrs[i] = cache.allocate(size).value_or(nullptr);
+            if (ptrs[i] == nullptr) {
+                std::cerr << "分配失败" << std::endl;
+                std::exit(1);
+            }
+        };
+        // 预热：空闲链表中至少有一批内存块
+        for (size_t i = 0; i < config.batch; i++) {
+            allocate(i);
+        }
+        for (size_t i = 0; i < config.batch; i++) {
+            cache.deallocate(ptrs[i], size);
+        }
+
+        const auto before = memory_pool_v2::memory_pool::stats();
+        // 同一个大小申请后立即归还
+        const auto pair = time_loop(config, config.ops * 2, [&] {
+            for (size_t i = 0; i < config.ops; i++) {
+                allocate(0);
+                static_cast<volatile char*>(ptrs[0])[0] = 1;
+                cache.deallocate(ptrs[0], size);
+            }
+        });
+        // 连续申请一批再全部归还
+        const size_t rounds = std::max<size_t>(1, config.ops / config.batch);
+        const auto batch = time_loop(config, rounds * config.batch * 2, [&] {
+            for (size_t round = 0; round < rounds; round++) {
+                for (size_t i = 0; i < config.batch; i++) {
+                    allocate(i);
+                }
+                for (size_t i = 0; i < config.batch; i++) {
+                    cache.deallocate(ptrs[i], size);
+                }
+            }
+        });
+        const auto after = memory_pool_v2::memory_pool::stats();
+
+        std::cout << std::left << std::setw(10) << size << std::right << std::fixed << std::setprecision(2) << std::setw(12) << pair.best_ns
+                  << std::setw(12) << pair.mean_ns << std::setw(12) << batch.best_ns << std::setw(12) << batch.mean_ns << std::setw(12)
+                  << after.refill_count - before.refill_count << std::setw(12) << after.overflow_count - before.overflow_count << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        if (arg.starts_with("--sizes=")) {
+            auto list = layer_benchmark::parse_list(arg.substr(8));
+            invalid |= !list.has_value();
+            config.sizes = list.value_or(config.sizes);
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = value("--ops=");
+        } else if (arg.starts_with("--batch=")) {
+            config.batch = value("--batch=");
+        } else if (arg.starts_with("--repeat=")) {
+            config.repeat = value("--repeat=");
+        } else {
+            invalid = true;
+        }
+    }
+    // 一批的总字节数超过空闲链表的上限时会归还给中心缓存，就不再是快速路径了
+    for (size_t size : config.sizes) {
+        invalid |= size > memory_pool_v2::size_utils::MAX_CACHED_UNIT_SIZE || size * config.batch > thread_cache::MAX_FREE_BYTES_PER_LISTS;
+    }
+    if (invalid || config.ops == 0 || config.batch == 0 || config.repeat == 0) {
+        std::cerr << "用法: " << argv[0] << " [--sizes=16,64,256,1024] [--ops=1000000] [--batch=64] [--repeat=5]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "线程缓存快速路径基准测试: 每次重复 " << config.ops << " 次, 批量 " << config.batch << " 个, 重复 " << config.repeat
+              << " 次 (单位 ns/次操作)" << std::endl;
+    latency::timer::get_instance();
+    std::cout << layer_benchmark::column("大小", 10, true) << layer_benchmark::column("成对 最好", 12) << layer_benchmark::column("成对 平均", 12)
+              << layer_benchmark::column("批量 最好", 12) << layer_benchmark::column("批量 平均", 12) << layer_benchmark::column("补充次数", 12)
+              << layer_benchmark::column("溢出次数", 12) << std::endl;
+    for (size_t size : config.sizes) {
+        run_size(config, size);
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+// 短时间存在的线程的基准测试：每一轮同时创建若干个线程，每个线程申请并归还一小批内存块后退出，主线程等待它们结束后开始下一轮
+// 每个新线程都要初始化自己的线程缓存，退出时把缓存的内存块还回去，这是线程缓存最不擅长的负载
+// 输出线程启动的开销、第一次申请的延迟（包括线程缓存的初始化）、吞吐量，以及 RSS 随轮数的变化
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "memory_pool.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/workload.h"
+
+namespace {
+    struct benchmark_config {
+        size_t threads = std::max(1u, std::thread::hardware_concurrency()); // 每一轮同时存在的线程数
+        size_t rounds = 2000;               // 创建线程的轮数
+        size_t burst = 64;                  // 每个线程申请的内存块个数
+        size_t min_size = 8;
+        size_t max_size = 1024;
+        size_t report_every = 200;          // 每多少轮记录一次 RSS
+        std::string mode = "all";           // pool / malloc / all
+    };
+
+    // 每个线程的结果，线程退出前写入，主线程在 join 以后读取
+    struct thread_result {
+        uint64_t created = 0;               // 主线程创建线程之前的时间
+        uint64_t started = 0;               // 线程开始执行的时间
+        uint64_t first_allocate_ns = 0;     // 第一次申请的延迟
+        uint64_t burst_ns = 0;              // 申请并归还整批内存块的时间
+    };
+
+    size_t read_rss_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        if (!(statm >> total_pages >> resident_pages)) {
+            return 0;
+        }
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    void run_mode(const benchmark_config& config, std::string_view mode) {
+        const bool use_pool = mode == "pool";
+        auto allocate = [use_pool](size_t size) -> void* {
+            return use_pool ? memory_pool_v2::memory_pool::allocate(size).value_or(nullptr) : malloc(size);
+        };
+        auto deallocate = [use_pool](void* ptr, size_t size) {
+            if (use_pool) {
+                memory_pool_v2::memory_pool::deallocate(ptr, size);
+            } else {
+                free(ptr);
+            }
+        };
+
+        // 每个线程的大小序列在开始前生成，两种模式使用相同的序列
+        std::vector<std::vector<size_t>> sizes(config.threads);
+        std::mt19937_64 rng(54321);
+        std::uniform_int_distribution<size_t> size_distribution(config.min_size, config.max_size);
+        for (auto& thread_sizes : sizes) {
+            thread_sizes.resize(config.burst);
+            std::ranges::generate(thread_sizes, [&] { return size_distribution(rng); });
+        }
+
+        const latency::timer& timer = latency::timer::get_instance();
+        latency::histogram startup;
+        latency::histogram first_allocate;
+        latency::histogram burst;
+        std::vector<thread_result> results(config.threads);
+        std::vector<std::thread> threads;
+        threads.reserve(config.threads);
+        const size_t baseline_rss = read_rss_bytes();
+        std::vector<std::pair<size_t, size_t>> timeline;
+
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t round = 1; round <= config.rounds; round++) {
+            for (size_t t = 0; t < config.threads; t++) {
+                results[t].created = timer.now();
+                threads.emplace_back([&, t] {
+                    thread_result& result = results[t];
+                    result.started = timer.now();
+                    std::vector<void*> ptrs(config.burst);
+                    const uint64_t begin = timer.now();
+                    for (size_t i = 0; i < config.burst; i++) {
+                        ptrs[i] = allocate(sizes[t][i]);
+                        if (ptrs[i] == nullptr) {
+                            std::cerr << "分配失败" << std::endl;
+                            std::exit(1);
+                        }
+                        static_cast<volatile char*>(ptrs[i])[0] = 1;
+                        if (i == 0) {
+                            result.first_allocate_ns = timer.elapsed_ns(begin, timer.now());
+                        }
+                    }
+                    for (size_t i = 0; i < config.burst; i++) {
+                        deallocate(ptrs[i], sizes[t][i]);
+                    }
+                    result.burst_ns = timer.elapsed_ns(begin, timer.now());
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            threads.clear();
+            for (auto& result : results) {
+                startup.record(timer.elapsed_ns(result.created, result.started));
+                first_allocate.record(result.first_allocate_ns);
+                burst.record(result.burst_ns);
+            }
+            if (round % config.report_every == 0 || round == config.rounds) {
+                const size_t rss = read_rss_bytes();
+                timeline.emplace_back(round, rss > baseline_rss ? rss - baseline_rss : 0);
+            }
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        const double total_threads = static_cast<double>(config.threads * config.rounds);
+        const double total_ops = total_threads * static_cast<double>(config.burst) * 2;
+        auto print_latency = [](const char* label, const latency::histogram& histogram) {
+            const auto p = latency::summarize(histogram);
+            std::cout << "  " << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(1)
+                      << " 平均 " << std::setw(9) << p.mean << " | p50 " << std::setw(8) << p.p50 << " | p99 " << std::setw(8) << p.p99
+                      << " | 最大 " << std::setw(10) << p.max << " (ns)" << std::endl;
+        };
+        std::cout << "[" << mode << "] 总耗时 " << std::fixed << std::setprecision(1) << seconds * 1e3 << " ms"
+                  << " | 每秒线程数 " << std::setprecision(0) << total_threads / seconds
+                  << " | 吞吐量 " << std::setprecision(2) << total_ops / seconds / 1e6 << " M ops/s" << std::endl;
+        print_latency("线程启动", startup);
+        print_latency("第一次申请", first_allocate);
+        print_latency("整批申请与归还", burst);
+        std::cout << "  RSS 增量 (MB) 随轮数的变化:";
+        for (auto [round, rss] : timeline) {
+            std::cout << " " << round << ":" << std::setprecision(2) << static_cast<double>(rss) / 1024.0 / 1024.0;
+        }
+        std::cout << std::endl;
+        if (use_pool) {
+            const auto stats = memory_pool_v2::memory_pool::stats();
+            std::cout << "  结束时存活的线程缓存 " << stats.thread_count << " 个, 线程缓存中的空闲内存 "
+                      << static_cast<double>(stats.thread_cache_bytes) / 1024.0 << " KB" << std::endl;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_config config;
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view prefix) {
+            auto result = workload::parse_size(arg.substr(prefix.size()));
+            invalid |= !result.has_value();
+            return result.value_or(0);
+        };
+        if (arg.starts_with("--threads=")) {
+            config.threads = value("--threads=");
+        } else if (arg.starts_with("--rounds=")) {
+            config.rounds = value("--rounds=");
+        } else if (arg.starts_with("--burst=")) {
+            config.burst = value("--burst=");
+        } else if (arg.starts_with("--min-size=")) {
+            config.min_size = value("--min-size=");
+        } else if (arg.starts_with("--max-size=")) {
+            config.max_size = value("--max-size=");
+        } else if (arg.starts_with("--report-every=")) {
+            config.report_every = value("--report-every=");
+        } else if (arg.starts_with("--mode=")) {
+            config.mode = arg.substr(7);
+        } else {
+            invalid = true;
+        }
+    }
+    if (invalid || config.threads == 0 || config.rounds == 0 || config.burst == 0 || config.report_every == 0 || config.min_size == 0 ||
+        config.min_size > config.max_size) {
+        std::cerr << "用法: " << argv[0] << " [--threads=N] [--rounds=2000] [--burst=64] [--min-size=8] [--max-size=1024] [--report-every=200]"
+                  << " [--mode=all|pool|malloc]" << std::endl;
+        return 1;
+    }
+
+    std::cout << "线程创建与退出基准测试: 每轮线程数 " << config.threads << ", 轮数 " << config.rounds << ", 每个线程申请 " << config.burst
+              << " 个内存块, 大小 " << config.min_size << " - " << config.max_size << " B" << std::endl;
+    // 先校准计时器，子进程会继承校准的结果
+    latency::timer::get_instance();
+    if (config.mode != "all") {
+        run_mode(config, config.mode);
+        return 0;
+    }
+    // 每一种分配器都在新的子进程中测试，RSS 互不影响
+    for (std::string_view mode : {"malloc", "pool"}) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_mode(config, mode);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,542 @@
+//
+// Created by ghost-him on 25-5-10.
+//
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// 基准测试的负载生成器：大小分布、申请与归还的比例、归还的顺序与对象的生命周期都可以在命令行中指定
+// 操作序列在计时之前生成，每一次归还都已经确定要归还第几次申请的内存块，所以不同的分配器执行完全相同的序列
+namespace workload {
+
+    enum class op_type { allocate, deallocate };
+
+    struct operation {
+        op_type type = op_type::allocate;
+        // 申请的大小，归还时为对应申请的大小
+        size_t size = 0;
+        // 只用于归还：归还这个线程第几次申请的内存块
+        size_t target = 0;
+    };
+
+    // 归还的顺序
+    enum class free_order {
+        // 从存活的内存块中随机选择
+        random,
+        // 最后申请的最先归还，类似栈上的临时对象
+        lifo,
+        // 最先申请的最先归还，类似队列与缓存淘汰
+        fifo,
+    };
+
+    inline std::optional<size_t> parse_size(std::string_view text) {
+        if (text.empty()) {
+            return std::nullopt;
+        }
+        size_t value = 0;
+        size_t i = 0;
+        for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+            value = value * 10 + (text[i] - '0');
+        }
+        if (i == 0) {
+            return std::nullopt;
+        }
+        std::string_view unit = text.substr(i);
+        if (unit == "" || unit == "B") {
+            return value;
+        }
+        if (unit == "K" || unit == "KB") {
+            return value * 1024;
+        }
+        if (unit == "M" || unit == "MB") {
+            return value * 1024 * 1024;
+        }
+        return std::nullopt;
+    }
+
+    inline std::optional<double> parse_double(std::string_view text) {
+        try {
+            size_t used = 0;
+            double value = std::stod(std::string(text), &used);
+            if (used != text.size()) {
+                return std::nullopt;
+            }
+            return value;
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    // 申请大小的分布
+    // fixed:64                固定大小
+    // uniform:8-4096          均匀分布
+    // powerlaw:8-4096:1.5     幂律分布，p(x) 正比于 x^-alpha，小对象多、大对象少
+    // bimodal:32,4096:90      双峰分布，90% 为 32 B，其余为 4096 B
+    // histogram:FILE          从文件读取，每行为 "大小 权重"，# 开头的行是注释
+    struct size_distribution {
+        enum class kind { fixed, uniform, powerlaw, bimodal, histogram };
+        kind type = kind::uniform;
+        size_t min = 8;
+        size_t max = 4096;
+        double alpha = 1.5;
+        size_t small = 32;
+        size_t large = 4096;
+        double small_percent = 90;
+        std::string file;
+        std::vector<size_t> sizes;
+        // 按权重选择 sizes 中的下标，采样时会修改内部状态
+        mutable std::discrete_distribution<size_t> histogram_index;
+
+        static std::optional<size_distribution> parse(std::string_view spec) {
+            size_distribution result;
+            const size_t colon = spec.find(':');
+            const std::string_view name = spec.substr(0, colon);
+            const std::string_view args = colon == std::string_view::npos ? std::string_view() : spec.substr(colon + 1);
+            auto parse_range = [&result](std::string_view range) {
+                const size_t dash = range.find('-');
+                if (dash == std::string_view::npos) {
+                    return false;
+                }
+                auto min = parse_size(range.substr(0, dash));
+                auto max = parse_size(range.substr(dash + 1));
+                if (!min || !max || *min == 0 || *min > *max) {
+                    return false;
+                }
+                result.min = *min;
+                result.max = *max;
+                return true;
+            };
+
+            if (name == "fixed") {
+                auto size = parse_size(args);
+                if (!size || *size == 0) {
+                    return std::nullopt;
+                }
+                result.type = kind::fixed;
+                result.min = result.max = *size;
+            } else if (name == "uniform") {
+                result.type = kind::uniform;
+                if (!parse_range(args)) {
+                    return std::nullopt;
+                }
+            } else if (name == "powerlaw") {
+                result.type = kind::powerlaw;
+                const size_t second = args.find(':');
+                if (!parse_range(args.substr(0, second))) {
+                    return std::nullopt;
+                }
+                if (second != std::string_view::npos) {
+                    auto alpha = parse_double(args.substr(second + 1));
+                    if (!alpha || *alpha <= 0) {
+                        return std::nullopt;
+                    }
+                    result.alpha = *alpha;
+                }
+            } else if (name == "bimodal") {
+                result.type = kind::bimodal;
+                const size_t comma = args.find(',');
+                const size_t second = args.find(':');
+                if (comma == std::string_view::npos) {
+                    return std::nullopt;
+                }
+                auto small = parse_size(args.substr(0, comma));
+                auto large = parse_size(args.substr(comma + 1, second == std::string_view::npos ? std::string_view::npos : second - comma - 1));
+                if (!small || !large || *small == 0 || *large == 0) {
+                    return std::nullopt;
+                }
+                result.small = *small;
+                result.large = *large;
+                if (second != std::string_view::npos) {
+                    auto percent = parse_double(args.substr(second + 1));
+                    if (!percent || *percent < 0 || *percent > 100) {
+                        return std::nullopt;
+                    }
+                    result.small_percent = *percent;
+                }
+                result.min = std::min(result.small, result.large);
+                result.max = std::max(result.small, result.large);
+            } else if (name == "histogram") {
+                result.type = kind::histogram;
+                result.file = args;
+                std::ifstream in(result.file);
+                if (!in.is_open()) {
+                    return std::nullopt;
+                }
+                std::string line;
+                std::vector<double> weights;
+                while (std::getline(in, line)) {
+                    if (line.empty() || line[0] == '#') {
+                        continue;
+                    }
+                    std::istringstream fields(line);
+                    size_t size = 0;
+                    double weight = 0;
+                    if (!(fields >> size >> weight) || size == 0 || weight < 0) {
+                        return std::nullopt;
+                    }
+                    result.sizes.push_back(size);
+                    weights.push_back(weight);
+                }
+                if (result.sizes.empty()) {
+                    return std::nullopt;
+                }
+                result.histogram_index = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+                result.min = *std::min_element(result.sizes.begin(), result.sizes.end());
+                result.max = *std::max_element(result.sizes.begin(), result.sizes.end());
+            } else {
+                return std::nullopt;
+            }
+            return result;
+        }
+
+        template<typename Rng>
+        size_t sample(Rng& rng) const {
+            switch (type) {
+                case kind::fixed:
+                    return min;
+                case kind::uniform:
+                    return std::uniform_int_distribution<size_t>(min, max)(rng);
+                case kind::powerlaw: {
+                    // 对连续的幂律分布做逆变换采样
+                    const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+                    const double lo = static_cast<double>(min);
+                    const double hi = static_cast<double>(max) + 1;
+                    double x = 0;
+                    if (std::abs(alpha - 1.0) < 1e-9) {
+                        x = lo * std::pow(hi / lo, u);
+                    } else {
+                        const double e = 1.0 - alpha;
+                        x = std::pow(std::pow(lo, e) + u * (std::pow(hi, e) - std::pow(lo, e)), 1.0 / e);
+                    }
+                    return std::clamp(static_cast<size_t>(x), min, max);
+                }
+                case kind::bimodal:
+                    return std::uniform_real_distribution<double>(0.0, 100.0)(rng) < small_percent ? small : large;
+                case kind::histogram:
+                    return sizes[histogram_index(rng)];
+            }
+            return min;
+        }
+
+        std::string describe() const {
+            std::ostringstream out;
+            switch (type) {
+                case kind::fixed: out << "fixed " << min << " B"; break;
+                case kind::uniform: out << "uniform " << min << " - " << max << " B"; break;
+                case kind::powerlaw: out << "powerlaw " << min << " - " << max << " B, alpha " << alpha; break;
+                case kind::bimodal: out << "bimodal " << small << " B (" << small_percent << "%) / " << large << " B"; break;
+                case kind::histogram: out << "histogram " << file << " (" << sizes.size() << " 种大小, " << min << " - " << max << " B)"; break;
+            }
+            return out.str();
+        }
+    };
+
+    // 对象的生命周期，以这个线程的操作数为单位
+    // none                    不指定，由申请的比例与归还的顺序决定
+    // fixed:N                 每个对象在申请以后第 N 次操作时归还
+    // exponential:MEAN        指数分布，大部分对象很快归还，少数存活很久
+    // uniform:MIN-MAX         均匀分布
+    struct lifetime_distribution {
+        enum class kind { none, fixed, exponential, uniform };
+        kind type = kind::none;
+        double mean = 0;
+        size_t min = 0;
+        size_t max = 0;
+
+        static std::optional<lifetime_distribution> parse(std::string_view spec) {
+            lifetime_distribution result;
+            const size_t colon = spec.find(':');
+            const std::string_view name = spec.substr(0, colon);
+            const std::string_view args = colon == std::string_view::npos ? std::string_view() : spec.substr(colon + 1);
+            if (name == "none") {
+                return result;
+            }
+            if (name == "fixed") {
+                auto value = parse_size(args);
+                if (!value) {
+                    return std::nullopt;
+                }
+                result.type = kind::fixed;
+                result.min = result.max = *value;
+            } else if (name == "exponential") {
+                auto mean = parse_double(args);
+                if (!mean || *mean <= 0) {
+                    return std::nullopt;
+                }
+                result.type = kind::exponential;
+                result.mean = *mean;
+            } else if (name == "uniform") {
+                const size_t dash = args.find('-');
+                if (dash == std::string_view::npos) {
+                    return std::nullopt;
+                }
+                auto min = parse_size(args.substr(0, dash));
+                auto max = parse_size(args.substr(dash + 1));
+                if (!min || !max || *min > *max) {
+                    return std::nullopt;
+                }
+                result.type = kind::uniform;
+                result.min = *min;
+                result.max = *max;
+            } else {
+                return std::nullopt;
+            }
+            return result;
+        }
+
+        template<typename Rng>
+        size_t sample(Rng& rng) const {
+            switch (type) {
+                case kind::none:
+                case kind::fixed:
+                    return min;
+                case kind::exponential:
+                    return static_cast<size_t>(std::exponential_distribution<double>(1.0 / mean)(rng));
+                case kind::uniform:
+                    return std::uniform_int_distribution<size_t>(min, max)(rng);
+            }
+            return min;
+        }
+
+        std::string describe() const {
+            std::ostringstream out;
+            switch (type) {
+                case kind::none: out << "none"; break;
+                case kind::fixed: out << "fixed " << min << " ops"; break;
+                case kind::exponential: out << "exponential, 平均 " << mean << " ops"; break;
+                case kind::uniform: out << "uniform " << min << " - " << max << " ops"; break;
+            }
+            return out.str();
+        }
+    };
+
+    inline const char* free_order_name(free_order order) {
+        switch (order) {
+            case free_order::random: return "random";
+            case free_order::lifo: return "lifo";
+            case free_order::fifo: return "fifo";
+        }
+        return "random";
+    }
+
+    struct workload_config {
+        unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+        size_t ops_per_thread = 100000;
+        // 申请操作所占的百分比，指定了生命周期时不使用
+        int alloc_percent = 60;
+        unsigned int seed = 54321;
+        size_distribution sizes = size_distribution::parse("uniform:8-4096").value();
+        free_order order = free_order::random;
+        lifetime_distribution lifetime;
+        std::string preset = "default";
+    };
+
+    // 命名的预设，用于复现常见的负载，之后的参数可以覆盖预设中的值
+    struct preset {
+        const char* name;
+        const char* description;
+        const char* sizes;
+        int alloc_percent;
+        free_order order;
+        const char* lifetime;
+    };
+
+    inline constexpr preset PRESETS[] = {
+        {"default", "8 - 4096 B 均匀分布，随机归还（原来的固定配置）", "uniform:8-4096", 60, free_order::random, "none"},
+        {"small", "以 8 - 256 B 的小对象为主，后申请先归还，类似请求处理中的临时对象", "powerlaw:8-256:1.5", 55, free_order::lifo, "none"},
+        {"server", "请求对象与大缓冲区的双峰分布，生命周期服从指数分布", "bimodal:64,16K:95", 60, free_order::random, "exponential:256"},
+        {"cache", "16 B - 2 KB 的长尾分布，先进先出，类似缓存淘汰", "powerlaw:16-2K:1.1", 60, free_order::fifo, "none"},
+        {"large", "4 KB - 256 KB 的大块内存，随机归还", "uniform:4K-256K", 55, free_order::random, "none"},
+    };
+
+    inline bool apply_preset(workload_config& config, std::string_view name) {
+        for (auto& preset : PRESETS) {
+            if (name == preset.name) {
+                config.preset = preset.name;
+                config.sizes = size_distribution::parse(preset.sizes).value();
+                config.alloc_percent = preset.alloc_percent;
+                config.order = preset.order;
+                config.lifetime = lifetime_distribution::parse(preset.lifetime).value();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    enum class parse_result {
+        // 不是负载相关的参数
+        not_matched,
+        ok,
+        invalid,
+    };
+
+    /// 解析一个负载相关的命令行参数，--preset 需要在其他参数之前应用
+    inline parse_result parse_argument(workload_config& config, std::string_view arg) {
+        auto value_of = [&arg](std::string_view key) -> std::optional<std::string_view> {
+            if (arg.starts_with(key)) {
+                return arg.substr(key.size());
+            }
+            return std::nullopt;
+        };
+        if (auto value = value_of("--preset=")) {
+            return apply_preset(config, *value) ? parse_result::ok : parse_result::invalid;
+        }
+        if (auto value = value_of("--threads=")) {
+            auto threads = parse_size(*value);
+            if (!threads || *threads == 0) {
+                return parse_result::invalid;
+            }
+            config.threads = static_cast<unsigned int>(*threads);
+            return parse_result::ok;
+        }
+        if (auto value = value_of("--ops=")) {
+            auto ops = parse_size(*value);
+            if (!ops || *ops == 0) {
+                return parse_result::invalid;
+            }
+            config.ops_per_thread = *ops;
+            return parse_result::ok;
+        }
+        if (auto value = value_of("--alloc-percent=")) {
+            auto percent = parse_size(*value);
+            if (!percent || *percent == 0 || *percent > 100) {
+                return parse_result::invalid;
+            }
+            config.alloc_percent = static_cast<int>(*percent);
+            return parse_result::ok;
+        }
+        if (auto value = value_of("--seed=")) {
+            auto seed = parse_size(*value);
+            if (!seed) {
+                return parse_result::invalid;
+            }
+            config.seed = static_cast<unsigned int>(*seed);
+            return parse_result::ok;
+        }
+        if (auto value = value_of("--sizes=")) {
+            auto sizes = size_distribution::parse(*value);
+            if (!sizes) {
+                return parse_result::invalid;
+            }
+            config.sizes = std::move(*sizes);
+            return parse_result::ok;
+        }
+        if (auto value = value_of("--free-order=")) {
+            for (auto order : {free_order::random, free_order::lifo, free_order::fifo}) {
+                if (*value == free_order_name(order)) {
+                    config.order = order;
+                    return parse_result::ok;
+                }
+            }
+            return parse_result::invalid;
+        }
+        if (auto value = value_of("--lifetime=")) {
+            auto lifetime = lifetime_distribution::parse(*value);
+            if (!lifetime) {
+                return parse_result::invalid;
+            }
+            config.lifetime = *lifetime;
+            return parse_result::ok;
+        }
+        return parse_result::not_matched;
+    }
+
+    inline const char* usage() {
+        return "[--preset=default|small|server|cache|large] [--threads=N] [--ops=N] [--alloc-percent=60] [--seed=N]\n"
+               "    [--sizes=fixed:64|uniform:8-4096|powerlaw:8-4096:1.5|bimodal:32,4096:90|histogram:FILE]\n"
+               "    [--free-order=random|lifo|fifo] [--lifetime=none|fixed:N|exponential:MEAN|uniform:MIN-MAX]";
+    }
+
+    /// 生成一个线程的操作序列
+    /// 没有指定生命周期时，每一步按比例决定申请还是归还，归还时按 free_order 选择存活的内存块，没有存活的内存块时这一步不生成操作
+    /// 指定了生命周期时，每个内存块在申请时决定在第几步归还，每一步如果有到期的内存块就归还最早到期的一个，否则申请
+    inline std::vector<operation> generate_thread(const workload_config& config, unsigned int thread_id) {
+        std::mt19937_64 rng(static_cast<uint64_t>(config.seed) * 1000003 + thread_id);
+        std::vector<operation> ops;
+        ops.reserve(config.ops_per_thread);
+        std::vector<size_t> sizes;
+        auto allocate = [&] {
+            const size_t size = config.sizes.sample(rng);
+            ops.push_back({op_type::allocate, size, 0});
+            sizes.push_back(size);
+            return sizes.size() - 1;
+        };
+        auto deallocate = [&](size_t target) {
+            ops.push_back({op_type::deallocate, sizes[target], target});
+        };
+
+        if (config.lifetime.type != lifetime_distribution::kind::none) {
+            // (到期的步数, 申请的序号)
+            using expiry = std::pair<size_t, size_t>;
+            std::priority_queue<expiry, std::vector<expiry>, std::greater<>> live;
+            for (size_t step = 0; step < config.ops_per_thread; step++) {
+                if (!live.empty() && live.top().first <= step) {
+                    deallocate(live.top().second);
+                    live.pop();
+                } else {
+                    const size_t target = allocate();
+                    live.emplace(step + 1 + config.lifetime.sample(rng), target);
+                }
+            }
+            return ops;
+        }
+
+        std::uniform_int_distribution<int> percent(1, 100);
+        std::deque<size_t> live;
+        for (size_t step = 0; step < config.ops_per_thread; step++) {
+            if (percent(rng) <= config.alloc_percent) {
+                live.push_back(allocate());
+                continue;
+            }
+            if (live.empty()) {
+                continue;
+            }
+            size_t target = 0;
+            switch (config.order) {
+                case free_order::lifo:
+                    target = live.back();
+                    live.pop_back();
+                    break;
+                case free_order::fifo:
+                    target = live.front();
+                    live.pop_front();
+                    break;
+                case free_order::random: {
+                    const size_t index = std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng);
+                    target = live[index];
+                    live[index] = live.back();
+                    live.pop_back();
+                    break;
+                }
+            }
+            deallocate(target);
+        }
+        return ops;
+    }
+
+    /// 生成所有线程的操作序列，同样的配置总是生成同样的序列
+    inline std::vector<std::vector<operation>> generate(const workload_config& config) {
+        std::vector<std::vector<operation>> result(config.threads);
+        for (unsigned int i = 0; i < config.threads; i++) {
+            result[i] = generate_thread(config, i);
+        }
+        return result;
+    }
+
+} // workload
+
+#endif //WORKLOAD_H
@@ -11,6 +11,7 @@
 #include <iostream>
 #include <thread>
 
+#include "instrumentation.h"
 #include "page_cache.h"
 #include "thread_cache.h"
 
@@ -21,183 +22,101 @@ namespace memory_pool_v2 {
         // 一次性申请的空间只可以小于512，如果出错了，则一定是代码写错了，所以使用assert
         assert(block_count <= page_span::MAX_UNIT_COUNT);
 
+        MEMORY_POOL_INSTRUMENT(central_cache_allocate, memory_size * block_count);
         if (memory_size == 0 || block_count == 0) {
             return std::nullopt;
         }
 
-        if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            return page_cache::get_instance().allocate_unit(memory_size).transform([this](memory_span memory) {
-                return memory.data();
-            });
+        // 直接使用中心缓存时（没有经过线程缓存），也要在第一次申请前确定参数
+        runtime_config::freeze();
+        if (memory_size > runtime_config::max_cached_unit_size()) {
+            return allocate_large(memory_size);
         }
 
         const size_t index = size_utils::get_index(memory_size);
         std::byte* result = nullptr;
+        size_t result_count = 0;
 
-        atomic_flag_guard guard(m_status[index]);
-
-        try {
-            if (m_free_array_size[index] < block_count) {
-                // 如果当前缓存的个数小于申请的块数，则向页分配器申请
-
-                // 一共要申请的大小
-                //size_t total_size = block_count * memory_size;
-                // 要申请的页面的个数
-                // 原本使用这个，只分配适量的空间
-                //size_t allocate_page_count = size_utils::align(total_size, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
-                // 现在改成直接分配能分配的最大的大小
-                size_t allocate_page_count = get_page_allocate_count(memory_size);
-                auto ret = get_page_from_page_cache(allocate_page_count);
-                if (!ret.has_value()) {
-                    return std::nullopt;
-                }
-                memory_span memory = ret.value();
-
-                // 用于管理这个页面
-                page_span page_span(memory, memory_size);
+        atomic_flag_guard guard(m_status[index], m_lock_contention_count[index]);
 
-#ifndef NDEBUG
-                // 如果使用的page_span是固定大小管理的，则可分配的个数也是固定的
-                size_t allocate_unit_count = page_span::MAX_UNIT_COUNT;
-#else
-                // 否则就是可以直接分配的
-                size_t allocate_unit_count = memory.size() / memory_size;
-#endif
-
-                // 根据分配出来的内存，实际可以划分出的内存个数
-                //assert((memory.size() / memory_size) >= allocate_page_count);
-                for (size_t i = 0; i < block_count; i++) {
-                    memory_span split_memory = memory.subspan(0, memory_size);
-                    memory = memory.subspan(memory_size);
-                    assert((index + 1) * 8 == split_memory.size());
-
-                    *(reinterpret_cast<std::byte**>(split_memory.data())) = result;
-                    result = split_memory.data();
-
-                    // 这个页面已经被分配出去了
-                    page_span.allocate(split_memory);
-                }
-
-                // 完成页面分配的管理
-                auto start_addr = page_span.data();
-                auto [_, succeed] = m_page_set[index].emplace(start_addr, std::move(page_span));
-                // 如果插入失败了，说明代码写的有问题
-                assert(succeed == true);
-
-                // 多余的值存到空闲列表中
-                allocate_unit_count -= block_count;
-                for (size_t i = 0; i < allocate_unit_count; i++) {
-                    memory_span split_memory = memory.subspan(0, memory_size);
-                    memory = memory.subspan(memory_size);
-                    assert((index + 1) * 8 == split_memory.size());
-
-                    *(reinterpret_cast<std::byte**>(split_memory.data())) = m_free_array[index];
-                    m_free_array[index] = split_memory.data();
-                    m_free_array_size[index] ++;
+        while (result_count < block_count) {
+            // 优先从部分分配的页面中取，其次是还没有归还的空页面，都没有的时候才向页缓存申请
+            page_span* span = select_partial_span(index);
+            if (span == nullptr) {
+                span = m_empty_spans[index].front();
+            }
+            if (span == nullptr) {
+                span = create_page_span(index, memory_size);
+            }
+            if (span == nullptr) {
+                // 申请失败了，已经取出来的内存块要放回去，保证返回的个数与申请的个数一致
+                std::byte* current = result;
+                while (current != nullptr) {
+                    std::byte* next = *(reinterpret_cast<std::byte**>(current));
+                    page_span& owner = find_page_span(index, current);
+                    owner.deallocate_unit(current);
+                    m_free_unit_count[index] ++;
+                    update_span_list(index, &owner);
+                    current = next;
                 }
-            } else {
-                auto& target_list = m_free_array[index];
-                assert(m_free_array_size[index] >= block_count);
-                // 直接从中心缓存区中分配内存
-                for (size_t i = 0; i < block_count; i++) {
-                    assert(m_free_array[index] != nullptr);
-
-                    std::byte* node = m_free_array[index];
-                    m_free_array[index] = *(reinterpret_cast<std::byte**>(node));
-                    m_free_array_size[index] --;
-
-                    record_allocated_memory_span(node, memory_size);
+                return std::nullopt;
+            }
 
-                    *(reinterpret_cast<std::byte**>(node)) = result;
-                    result = node;
-                }
+            // 一次性从这个页面中取出尽可能多的内存块
+            while (result_count < block_count && !span->is_full()) {
+                std::byte* node = span->allocate_unit();
+                *(reinterpret_cast<std::byte**>(node)) = result;
+                result = node;
+                result_count ++;
+                m_free_unit_count[index] --;
             }
-        } catch (...) {
-            throw std::runtime_error("Memory allocation failed");
-            return std::nullopt;
+            update_span_list(index, span);
         }
 
-
+        m_allocated_count[index] += block_count;
+        m_peak_allocated_count[index] = std::max(m_peak_allocated_count[index], m_allocated_count[index]);
+        m_max_batch_count[index] = std::max(m_max_batch_count[index], block_count);
         assert(check_ptr_length(result) == block_count);
         return result;
     }
 
     void central_cache::deallocate(std::byte* memory_list, size_t memory_size) {
         assert(memory_list != nullptr);
+        MEMORY_POOL_INSTRUMENT(central_cache_deallocate, memory_size);
 
-        if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            // 如果是超大内存块，则直接返回给page_cache管理
-            page_cache::get_instance().deallocate_unit(memory_span(memory_list, memory_size));
+        if (memory_size > runtime_config::max_cached_unit_size()) {
+            // 如果是超大内存块，则放到大内存块的缓存中
+            deallocate_large(memory_list, memory_size);
             return;
         }
 
         const size_t index = size_utils::get_index(memory_size);
-        atomic_flag_guard guard(m_status[index]);
+        atomic_flag_guard guard(m_status[index], m_lock_contention_count[index]);
 
+        // 同一批归还的内存块大多来自同一个页面，记住上一次找到的页面，可以省去大部分的查找
+        page_span* span = nullptr;
         std::byte* current_memory = memory_list;
         while (current_memory != nullptr) {
             std::byte* next_node_to_add = *(reinterpret_cast<std::byte**>(current_memory));
-            // 先归还到数组中
             assert((index + 1) * 8 == memory_size);
 
-            *(reinterpret_cast<std::byte**>(current_memory)) = m_free_array[index];
-            m_free_array[index] = current_memory;
-            m_free_array_size[index] ++;
-
-
-            // 然后再还给页面管理器中
-            auto it = m_page_set[index].upper_bound(current_memory);
-            assert(it != m_page_set[index].begin());
-            -- it;
-            assert(it->second.is_valid_unit_span(memory_span(current_memory, memory_size)));
-            it->second.deallocate(memory_span(current_memory, memory_size));
-            // 同时判断需不需要返回给页面管理器
-            if (it->second.is_empty()) {
-                // 如果已经还清内存了，则将这块内存还给页面管理器(page_cache)
-                auto page_start_addr = it->second.data();
-                auto page_end_addr = page_start_addr + it->second.size();
-                assert(it->second.unit_size() == memory_size);
-
-                std::byte* current = m_free_array[index];
-                std::byte* prev = nullptr;
-                // 遍历这个数组
-                while (current != nullptr) {
-                    std::byte* next = *(reinterpret_cast<std::byte**>(current));
-                    bool should_remove = false;
-                    auto memory_start_addr = current;
-                    auto memory_end_addr = memory_start_addr + memory_size;
-
-                    if (memory_start_addr >= page_start_addr && memory_end_addr <= page_end_addr) {
-                        // 如果这个内存在这个范围内，则说明是正确的
-                        // 一定是满足要求的，如果不满足，则说明代码写错了
-                        assert(it->second.is_valid_unit_span(memory_span(current, memory_size)));
-                        should_remove = true;
-                    }
-                    // 只有在不需要删除的时候才会更新prev
-                    if (should_remove) {
-                        // 从链表中移除 current
-                        if (prev == nullptr) { // 移除的是头节点
-                            m_free_array[index] = next;
-                        } else { // 移除的是中间或尾部节点
-                            *(reinterpret_cast<std::byte**>(prev)) = next;
-                        }
-                        m_free_array_size[index]--;
-                        // 注意：当移除 current 时，prev 保持不变，因为它仍然是 next 的前一个节点
-                    } else {
-                        // current 未被移除，它成为下一次迭代的 prev
-                        prev = current;
-                    }
-                    current = next;
-                }
-                memory_span page_memory = it->second.get_memory_span();
-                m_page_set[index].erase(it);
-                // 如果是动态分配申请页面的
-#ifdef NDEBUG
-                // 如果回收了指定的页面，则说明当前这个空间分配的过多了，下一次申请内存的时候要少一点申请
-                m_next_allocate_memory_group_count[index] /= 2;
-#endif
-
-                page_cache::get_instance().deallocate_page(page_memory);
+            if (span == nullptr || current_memory < span->data() || current_memory >= span->data() + span->size()) {
+                span = &find_page_span(index, current_memory);
+            }
+            assert(span->is_valid_unit_span(memory_span(current_memory, memory_size)));
+            // 直接还给所属的页面
+            span->deallocate_unit(current_memory);
+            m_free_unit_count[index] ++;
+            m_allocated_count[index] --;
+            if (span->is_empty() && !t_defer_span_release && !m_defer_span_release.load(std::memory_order_relaxed)) {
+                // 如果已经还清内存了，则直接将这个页面还给页面管理器(page_cache)，不需要遍历任何链表
+                span_list::list_of(span)->remove(span);
+                m_free_unit_count[index] -= span->total_unit_count();
+                return_page_span(index, span);
+                span = nullptr;
+            } else {
+                // 延迟归还时，空的页面放到空页面链表中，留给 trim 统一处理
+                update_span_list(index, span);
             }
             current_memory = next_node_to_add;
         }
@@ -214,19 +133,247 @@ namespace memory_pool_v2 {
         size_t result = m_next_allocate_memory_group_count[index];
         // 最小要分配一组的数据
         result = std::max(result, static_cast<size_t>(1));
-        // 下一次再请求分配的时候，就再加一组的数据
-        size_t next_allocate_page_count = result + 1;
+        // 下一次再请求分配的时候，就再加一组的数据，但不超过上限，否则长时间运行以后每次申请的页面会无限增大
+        size_t next_allocate_page_count = std::min(result + 1, runtime_config::max_page_group_count());
         m_next_allocate_memory_group_count[index] = next_allocate_page_count;
-        return size_utils::align(result * thread_cache::MAX_FREE_BYTES_PER_LISTS, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+        return size_utils::align(result * runtime_config::max_free_bytes(index), size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
 #endif
     }
 
-    void central_cache::record_allocated_memory_span(std::byte* memory, const size_t memory_size) {
+    size_t central_cache::release_empty_spans() {
+        size_t released_size = 0;
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            atomic_flag_guard guard(m_status[index]);
+            // 空的页面中的内存块都在页面自己的空闲链表中，直接归还即可
+            while (page_span* span = m_empty_spans[index].front()) {
+                m_empty_spans[index].remove(span);
+                m_free_unit_count[index] -= span->total_unit_count();
+                released_size += span->size();
+                return_page_span(index, span);
+            }
+        }
+        return released_size;
+    }
+
+    size_t central_cache::trim(size_t max_free_bytes_per_list) {
+        // 不论规格的空闲链表有多长，空的页面都要归还，否则空闲内存块较少的规格中的空页面永远不会被归还
+        size_t trimmed_size = release_empty_spans();
+
+        for (size_t index = 0; index < size_utils::LARGE_CACHE_LINE_SIZE; index++) {
+            const size_t memory_size = (index + 1) * size_utils::PAGE_SIZE;
+            std::byte* list = nullptr;
+            {
+                atomic_flag_guard guard(m_large_status[index]);
+                if (m_large_free_array_size[index] * memory_size <= max_free_bytes_per_list) {
+                    continue;
+                }
+                list = m_large_free_array[index];
+                m_large_cached_bytes.fetch_sub(m_large_free_array_size[index] * memory_size, std::memory_order_relaxed);
+                m_large_free_array[index] = nullptr;
+                m_large_free_array_size[index] = 0;
+            }
+            // 归还给页缓存时不需要持有锁
+            while (list != nullptr) {
+                std::byte* next = *(reinterpret_cast<std::byte**>(list));
+                page_cache::get_instance().deallocate_unit(memory_span(list, memory_size));
+                trimmed_size += memory_size;
+                list = next;
+            }
+        }
+        return trimmed_size;
+    }
+
+    std::optional<std::byte*> central_cache::allocate_large(size_t memory_size) {
+        if (memory_size <= size_utils::MAX_LARGE_CACHED_UNIT_SIZE) {
+            const size_t index = size_utils::get_large_index(memory_size);
+            atomic_flag_guard guard(m_large_status[index], m_large_lock_contention_count);
+            if (m_large_free_array[index] != nullptr) {
+                std::byte* result = m_large_free_array[index];
+                m_large_free_array[index] = *(reinterpret_cast<std::byte**>(result));
+                m_large_free_array_size[index] --;
+                m_large_cached_bytes.fetch_sub((index + 1) * size_utils::PAGE_SIZE, std::memory_order_relaxed);
+                *(reinterpret_cast<std::byte**>(result)) = nullptr;
+                return result;
+            }
+        }
+        return page_cache::get_instance().allocate_unit(memory_size).transform([](memory_span memory) {
+            // 与小内存块一样，返回的是一个只有一个结点的链表
+            *(reinterpret_cast<std::byte**>(memory.data())) = nullptr;
+            return memory.data();
+        });
+    }
+
+    void central_cache::deallocate_large(std::byte* memory, size_t memory_size) {
+        if (memory_size <= size_utils::MAX_LARGE_CACHED_UNIT_SIZE) {
+            const size_t index = size_utils::get_large_index(memory_size);
+            const size_t page_size = (index + 1) * size_utils::PAGE_SIZE;
+            // 先占用缓存的额度，超过上限时就不缓存了
+            if (m_large_cached_bytes.fetch_add(page_size, std::memory_order_relaxed) + page_size <= MAX_LARGE_CACHED_BYTES) {
+                atomic_flag_guard guard(m_large_status[index], m_large_lock_contention_count);
+                *(reinterpret_cast<std::byte**>(memory)) = m_large_free_array[index];
+                m_large_free_array[index] = memory;
+                m_large_free_array_size[index] ++;
+                return;
+            }
+            m_large_cached_bytes.fetch_sub(page_size, std::memory_order_relaxed);
+        }
+        page_cache::get_instance().deallocate_unit(memory_span(memory, memory_size));
+    }
+
+    page_span* central_cache::create_page_span(size_t index, size_t memory_size) {
+        // 直接分配能分配的最大的大小
+        size_t allocate_page_count = get_page_allocate_count(memory_size);
+        auto ret = get_page_from_page_cache(allocate_page_count);
+        if (!ret.has_value()) {
+            return nullptr;
+        }
+        // 用于管理这个页面，内存块在分配的时候才会切分出来
+        auto [it, succeed] = m_page_set[index].emplace(ret->data(), page_span(ret.value(), memory_size));
+        // 如果插入失败了，说明代码写的有问题
+        assert(succeed == true);
+        page_span* span = &it->second;
+        // map 中的节点地址是稳定的，可以直接记录到页面映射中
+        page_cache::get_instance().set_page_owner(span->get_memory_span(), span);
+        m_free_unit_count[index] += span->total_unit_count();
+        m_span_bytes[index] += span->size();
+        m_empty_spans[index].push_front(span);
+        return span;
+    }
+
+    void central_cache::update_span_list(size_t index, page_span* span) {
+        span_list& target = span->is_full() ? m_full_spans[index] :
+                            span->is_empty() ? m_empty_spans[index] : m_partial_spans[index][occupancy_bucket(span)];
+        span_list* current = span_list::list_of(span);
+        if (current != &target) {
+            if (current != nullptr) {
+                current->remove(span);
+            }
+            target.push_front(span);
+        }
+    }
+
+    page_span* central_cache::select_partial_span(size_t index) {
+        auto& buckets = m_partial_spans[index];
+        if (get_span_selection_policy() == span_selection_policy::fullest) {
+            for (size_t bucket = span_occupancy::BUCKET_COUNT; bucket > 0; bucket--) {
+                if (!buckets[bucket - 1].empty()) {
+                    return buckets[bucket - 1].front();
+                }
+            }
+        } else {
+            for (auto& list : buckets) {
+                if (!list.empty()) {
+                    return list.front();
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    span_occupancy central_cache::get_span_occupancy(size_t memory_size) {
+        assert(memory_size % 8 == 0 && memory_size > 0 && memory_size <= size_utils::MAX_CACHED_UNIT_SIZE);
         const size_t index = size_utils::get_index(memory_size);
+        span_occupancy result;
+        atomic_flag_guard guard(m_status[index]);
+        result.empty_span_count = m_empty_spans[index].size();
+        result.full_span_count = m_full_spans[index].size();
+        for (size_t bucket = 0; bucket < span_occupancy::BUCKET_COUNT; bucket++) {
+            result.partial_span_count[bucket] = m_partial_spans[index][bucket].size();
+        }
+        for (auto& [_, span] : m_page_set[index]) {
+            result.span_bytes += span.size();
+            result.total_unit_count += span.total_unit_count();
+        }
+        result.allocated_unit_count = result.total_unit_count - m_free_unit_count[index];
+        return result;
+    }
+
+    void central_cache::collect_stats(memory_pool_stats& stats) {
+        assert(stats.size_classes.size() == size_utils::CACHE_LINE_SIZE);
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            size_class_stats& result = stats.size_classes[index];
+            atomic_flag_guard guard(m_status[index]);
+            result.central_cache_count = m_free_unit_count[index];
+            result.span_count = m_page_set[index].size();
+            result.span_bytes = m_span_bytes[index];
+            result.lock_contention_count = m_lock_contention_count[index].load(std::memory_order_relaxed);
+        }
+        for (size_t index = 0; index < size_utils::LARGE_CACHE_LINE_SIZE; index++) {
+            atomic_flag_guard guard(m_large_status[index]);
+            stats.large.central_cache_count += m_large_free_array_size[index];
+        }
+        stats.large.central_cache_bytes = large_cached_bytes();
+        stats.large.lock_contention_count = m_large_lock_contention_count.load(std::memory_order_relaxed);
+    }
+
+    std::vector<allocation_profile_entry> central_cache::get_allocation_profile() {
+        std::vector<allocation_profile_entry> result;
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            atomic_flag_guard guard(m_status[index]);
+            if (m_peak_allocated_count[index] == 0) {
+                continue;
+            }
+            allocation_profile_entry entry;
+            entry.memory_size = (index + 1) * size_utils::ALIGNMENT;
+            entry.batch_count = m_max_batch_count[index];
+            entry.peak_count = m_peak_allocated_count[index];
+#ifdef NDEBUG
+            entry.page_group_count = m_next_allocate_memory_group_count[index];
+#endif
+            result.push_back(entry);
+        }
+        return result;
+    }
+
+    void central_cache::apply_allocation_profile(const std::vector<allocation_profile_entry>& profile) {
+#ifdef NDEBUG
+        // 组数的上限取决于参数，所以参数要在这之前生效
+        runtime_config::freeze();
+        for (const auto& entry : profile) {
+            if (entry.memory_size == 0 || entry.memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
+                continue;
+            }
+            const size_t index = size_utils::get_index(entry.memory_size);
+            atomic_flag_guard guard(m_status[index]);
+            m_next_allocate_memory_group_count[index] = std::min(entry.page_group_count, runtime_config::max_page_group_count());
+        }
+#else
+        // 调试模式下每个页面的大小是固定的，不需要设置
+        (void)profile;
+#endif
+    }
+
+    void central_cache::reset_allocation_peaks() {
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            atomic_flag_guard guard(m_status[index]);
+            m_peak_allocated_count[index] = m_allocated_count[index];
+            m_max_batch_count[index] = 0;
+        }
+    }
+
+    void central_cache::return_page_span(size_t index, page_span* span) {
+        assert(span_list::list_of(span) == nullptr);
+        memory_span page_memory = span->get_memory_span();
+        page_cache::get_instance().set_page_owner(page_memory, nullptr);
+        m_span_bytes[index] -= page_memory.size();
+        m_page_set[index].erase(page_memory.data());
+        // 如果是动态分配申请页面的
+#ifdef NDEBUG
+        // 如果回收了指定的页面，则说明当前这个空间分配的过多了，下一次申请内存的时候要少一点申请
+        m_next_allocate_memory_group_count[index] /= 2;
+#endif
+
+        page_cache::get_instance().deallocate_page(page_memory);
+    }
+
+    page_span& central_cache::find_page_span(size_t index, std::byte* memory) {
+        if (void* owner = page_cache::get_instance().page_owner(memory); owner != nullptr) {
+            return *static_cast<page_span*>(owner);
+        }
         auto it = m_page_set[index].upper_bound(memory);
         assert(it != m_page_set[index].begin());
         --it;
-        it->second.allocate(memory_span(memory, memory_size));
+        return it->second;
     }
 
     std::optional<memory_span> central_cache::get_page_from_page_cache(size_t page_allocate_count) {
@@ -12,18 +12,103 @@
 #include <mutex>
 #include <set>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "memory_pool_config.h"
+#include "memory_pool_stats.h"
 #include "utils.h"
 
 class CentralCacheTest;
 
 namespace memory_pool_v2 {
+    // 页面的侵入式双向链表，每个页面同一时间最多只在一个链表中，插入与删除都是 O(1)
+    class span_list {
+    public:
+        page_span* front() const { return m_head; }
+        bool empty() const { return m_head == nullptr; }
+        size_t size() const { return m_size; }
+
+        void push_front(page_span* span) {
+            assert(span->m_list == nullptr);
+            span->m_list = this;
+            span->m_prev = nullptr;
+            span->m_next = m_head;
+            if (m_head != nullptr) {
+                m_head->m_prev = span;
+            }
+            m_head = span;
+            m_size ++;
+        }
+
+        void remove(page_span* span) {
+            assert(span->m_list == this);
+            if (span->m_prev != nullptr) {
+                span->m_prev->m_next = span->m_next;
+            } else {
+                m_head = span->m_next;
+            }
+            if (span->m_next != nullptr) {
+                span->m_next->m_prev = span->m_prev;
+            }
+            span->m_list = nullptr;
+            span->m_prev = span->m_next = nullptr;
+            m_size --;
+        }
+
+        /// 页面所在的链表，不在任何链表中时返回 nullptr
+        static span_list* list_of(const page_span* span) { return span->m_list; }
+        /// 链表中的下一个页面
+        static page_span* next(const page_span* span) { return span->m_next; }
+
+    private:
+        page_span* m_head = nullptr;
+        size_t m_size = 0;
+    };
+
+    // 中心缓存从哪一个部分分配的页面中取内存块
+    enum class span_selection_policy {
+        // 优先使用使用率最高的页面，使用率低的页面更容易变空并还给页缓存
+        fullest,
+        // 优先使用使用率最低的页面，接近原来从空闲链表头部取内存块的行为，用于对比
+        emptiest,
+    };
+
+    // 一个规格中所有页面的使用情况
+    struct span_occupancy {
+        // 部分分配的页面按使用率分组的个数，第 i 组的使用率在 [i / N, (i + 1) / N) 之间
+        static constexpr size_t BUCKET_COUNT = 8;
+        size_t empty_span_count = 0;
+        std::array<size_t, BUCKET_COUNT> partial_span_count = {};
+        size_t full_span_count = 0;
+        // 页面的总字节数，以及其中已经分配出去的内存块的个数与总个数
+        size_t span_bytes = 0;
+        size_t allocated_unit_count = 0;
+        size_t total_unit_count = 0;
+    };
+
+    // 一个规格学习到的需求，可以保存到文件中，下一次启动时直接使用
+    struct allocation_profile_entry {
+        size_t memory_size = 0;
+        // 线程缓存一次申请的最多内存块个数
+        size_t batch_count = 0;
+        // 同时分配出去（在线程缓存中或者正在使用）的内存块个数的峰值
+        size_t peak_count = 0;
+        // 下一次向页缓存申请的组数，只在 release 模式下使用
+        size_t page_group_count = 0;
+    };
+
     // 中心存储器
     class central_cache {
     public:
-        friend class CentralCacheTest;
+        friend class ::CentralCacheTest;
         // 一次性申请8页的空间
         static constexpr size_t PAGE_SPAN = 8;
+        // 一次向页缓存申请的组数上限的默认值（一组为线程缓存中这个规格的空闲链表上限），页面越大越难完全空闲、还给页缓存
+        // 实际使用的值见 runtime_config::max_page_group_count()
+        static constexpr size_t MAX_PAGE_GROUP_COUNT = memory_pool_config::DEFAULT_MAX_PAGE_GROUP_COUNT;
+        // 全局缓存的大内存块的总字节数上限
+        static constexpr size_t MAX_LARGE_CACHED_BYTES = 16 * 1024 * 1024;
         static central_cache& get_instance() {
             static central_cache instance;
             return instance;
@@ -39,22 +124,113 @@ namespace memory_pool_v2 {
         /// 注意点：这一个列表中，每一个内存块大小必须是一样的。
         void deallocate(std::byte* memory_list, size_t memory_size);
 
+        /// 设置页面变空以后是否延迟归还给页缓存
+        /// 延迟归还时，空的页面会留在中心缓存中，直到调用 trim 才会归还
+        /// 内存块个数在一个页面附近来回变化的规格可以直接重用空页面，不需要每次都加页缓存的锁、重新切分页面
+        void set_defer_span_release(bool defer) { m_defer_span_release.store(defer, std::memory_order_relaxed); }
+        bool defer_span_release() const { return m_defer_span_release.load(std::memory_order_relaxed); }
+
+        /// 只在调用线程中延迟归还空的页面，不影响其他线程，用于预热时保留页面
+        /// 返回值：原来的设置，用于之后恢复
+        static bool set_thread_defer_span_release(bool defer) { return std::exchange(t_defer_span_release, defer); }
+
+        /// 设置从部分分配的页面中取内存块时的选择策略
+        void set_span_selection_policy(span_selection_policy policy) { m_span_selection_policy.store(policy, std::memory_order_relaxed); }
+        span_selection_policy get_span_selection_policy() const { return m_span_selection_policy.load(std::memory_order_relaxed); }
+
+        /// 统计一个规格中所有页面的使用情况
+        /// 参数：memory_size: 内存块的大小，需要是 8 的倍数并且不超过 MAX_CACHED_UNIT_SIZE
+        span_occupancy get_span_occupancy(size_t memory_size);
+
+        /// 统计每个规格的空闲内存块与页面，以及缓存的大内存块
+        /// 每次只持有一个规格的锁，并且只复制几个计数器，不会长时间阻塞分配
+        /// 参数：stats: 结果，其中的 size_classes 需要已经按下标准备好 CACHE_LINE_SIZE 个元素
+        void collect_stats(memory_pool_stats& stats);
+
+        /// 每个规格学习到的需求，只包含分配过内存块的规格
+        std::vector<allocation_profile_entry> get_allocation_profile();
+
+        /// 使用之前保存的需求，设置每个规格下一次向页缓存申请的组数
+        void apply_allocation_profile(const std::vector<allocation_profile_entry>& profile);
+
+        /// 重新开始统计峰值与一次申请的最多个数，峰值从当前分配出去的个数开始，用于去掉预热的影响
+        void reset_allocation_peaks();
+
+        /// 当前全局缓存的大内存块的总字节数
+        size_t large_cached_bytes() const { return m_large_cached_bytes.load(std::memory_order_relaxed); }
+
+        /// 将延迟归还的空页面全部归还给页缓存
+        /// 返回值：归还给页缓存的字节数
+        size_t release_empty_spans();
+
+        /// 将延迟归还的空页面全部归还给页缓存，同时把缓存的字节数超过阈值的大内存块链表全部归还给页缓存
+        /// 参数：max_free_bytes_per_list: 大内存块链表的字节数超过这个值时才会归还
+        /// 返回值：归还给页缓存的字节数
+        size_t trim(size_t max_free_bytes_per_list);
+
     private:
         size_t get_page_allocate_count(size_t memory_size);
 
-        /// 将分配出去的内存块记录下来
-        void record_allocated_memory_span(std::byte* memory, const size_t memory_size);
+        /// 分配一个大内存块，优先使用缓存中相同页数的内存块
+        std::optional<std::byte*> allocate_large(size_t memory_size);
+
+        /// 回收一个大内存块，缓存已满或者太大时直接还给页缓存
+        void deallocate_large(std::byte* memory, size_t memory_size);
+
+        /// 向页缓存申请页面并创建一个新的 page_span，放在空页面链表中，失败时返回 nullptr
+        page_span* create_page_span(size_t index, size_t memory_size);
+
+        /// 根据页面的使用情况，把页面移动到对应的链表中
+        void update_span_list(size_t index, page_span* span);
+
+        /// 按照选择策略取一个部分分配的页面，没有时返回 nullptr
+        page_span* select_partial_span(size_t index);
+
+        /// 部分分配的页面所在的使用率分组
+        static size_t occupancy_bucket(const page_span* span) {
+            return span->allocated_unit_count() * span_occupancy::BUCKET_COUNT / span->total_unit_count();
+        }
 
         std::optional<memory_span> get_page_from_page_cache(size_t page_allocate_count);
 
-        // 空闲链表
-        std::array<std::byte*, size_utils::CACHE_LINE_SIZE> m_free_array = {};
-        // 空闲链表的长度有多少
-        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_free_array_size = {};
+        /// 查找一个内存块所属的页面
+        /// 页缓存预留了地址空间时直接查页面映射，否则在这个规格的页面集合中查找
+        page_span& find_page_span(size_t index, std::byte* memory);
+
+        /// 将一个已经完全空闲的页面归还给页缓存，调用前需要已经把页面从链表中移除
+        void return_page_span(size_t index, page_span* span);
+
+        // 空闲的内存块的个数（包括页面中还没有切分的部分）
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_free_unit_count = {};
+        // 每个规格的页面的总字节数
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_span_bytes = {};
         // 指定长度的锁
         std::array<std::atomic_flag, size_utils::CACHE_LINE_SIZE> m_status;
-        // 用于页面的管理
+        // 分配出去的内存块个数与它的峰值，以及线程缓存一次申请的最多个数
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_allocated_count = {};
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_peak_allocated_count = {};
+        std::array<size_t, size_utils::CACHE_LINE_SIZE> m_max_batch_count = {};
+        // 每个规格的锁需要等待其他线程的次数
+        std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> m_lock_contention_count = {};
+        // 用于页面的管理，按起始地址排序，同时负责 page_span 的存储
         std::array<std::map<std::byte*, page_span>, size_utils::CACHE_LINE_SIZE> m_page_set;
+        // 按照使用情况划分的页面：部分分配的（再按使用率分组）、全部分配出去的、全部空闲的（只有延迟归还时才会留下）
+        std::array<std::array<span_list, span_occupancy::BUCKET_COUNT>, size_utils::CACHE_LINE_SIZE> m_partial_spans;
+        std::array<span_list, size_utils::CACHE_LINE_SIZE> m_full_spans;
+        std::array<span_list, size_utils::CACHE_LINE_SIZE> m_empty_spans;
+        // 是否延迟归还空的页面
+        std::atomic<bool> m_defer_span_release = false;
+        // 当前线程是否延迟归还空的页面，与 m_defer_span_release 任意一个开启时都会延迟
+        static inline thread_local bool t_defer_span_release = false;
+        // 部分分配的页面的选择策略
+        std::atomic<span_selection_policy> m_span_selection_policy = span_selection_policy::fullest;
+
+        // 大内存块的缓存，按页数分组，每一组是一个侵入式链表
+        std::array<std::byte*, size_utils::LARGE_CACHE_LINE_SIZE> m_large_free_array = {};
+        std::array<size_t, size_utils::LARGE_CACHE_LINE_SIZE> m_large_free_array_size = {};
+        std::array<std::atomic_flag, size_utils::LARGE_CACHE_LINE_SIZE> m_large_status;
+        std::atomic<size_t> m_large_lock_contention_count = 0;
+        std::atomic<size_t> m_large_cached_bytes = 0;
 
 #ifdef NDEBUG
         // 动态决定不同的内存长度要分配几个页面，与线程缓存相同的思路
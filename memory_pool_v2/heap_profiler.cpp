@@ -0,0 +1,177 @@
+//
+// Created by ghost-him on 25-5-8.
+//
+
+#include "heap_profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+
+namespace memory_pool_v2 {
+    namespace {
+        // 按调用栈合并以后的估算值
+        struct stack_total {
+            double count = 0;
+            double bytes = 0;
+        };
+
+        std::string symbolize(void* address) {
+            // 返回地址指向调用指令的下一条指令，减一以后才在调用者的范围内
+            Dl_info info {};
+            if (dladdr(static_cast<char*>(address) - 1, &info) != 0 && info.dli_sname != nullptr) {
+                int status = 0;
+                char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+                std::string result = status == 0 ? demangled : info.dli_sname;
+                free(demangled);
+                return result;
+            }
+            char buffer[32];
+            snprintf(buffer, sizeof(buffer), "%p", address);
+            return buffer;
+        }
+    }
+
+    void heap_profiler::start(size_t sample_interval) {
+        m_sample_interval.store(std::max<size_t>(sample_interval, 1), std::memory_order_relaxed);
+        m_running.store(true, std::memory_order_relaxed);
+    }
+
+    void heap_profiler::stop() {
+        m_running.store(false, std::memory_order_relaxed);
+    }
+
+    void heap_profiler::clear() {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        for (auto& [ptr, _] : m_samples) {
+            m_sample_filter[filter_index(ptr)].fetch_sub(1, std::memory_order_relaxed);
+        }
+        m_samples.clear();
+        m_live_sample_count.store(0, std::memory_order_relaxed);
+    }
+
+    size_t heap_profiler::next_sample_distance() {
+        if (!is_running()) {
+            return DISABLED_CHECK_INTERVAL;
+        }
+        const size_t interval = sample_interval();
+        if (interval <= 1) {
+            return 0;
+        }
+        static thread_local std::mt19937_64 rng(std::random_device{}());
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        // 指数分布，使每一个字节被采样的概率相同，与申请的大小无关
+        const double distance = -std::log(1.0 - uniform(rng)) * static_cast<double>(interval);
+        return static_cast<size_t>(std::min(distance, static_cast<double>(DISABLED_CHECK_INTERVAL) * 16));
+    }
+
+    void heap_profiler::record_allocation(void* ptr, size_t size) {
+        heap_sample sample;
+        sample.size = size;
+        sample.sample_interval = sample_interval();
+        // 跳过当前函数这一层
+        std::array<void*, heap_sample::MAX_STACK_DEPTH + 1> stack;
+        const int depth = backtrace(stack.data(), static_cast<int>(stack.size()));
+        if (depth > 1) {
+            sample.stack_depth = depth - 1;
+            std::copy_n(stack.begin() + 1, sample.stack_depth, sample.stack.begin());
+        }
+
+        std::unique_lock<std::mutex> guard(m_mutex);
+        if (m_samples.insert_or_assign(ptr, sample).second) {
+            m_sample_filter[filter_index(ptr)].fetch_add(1, std::memory_order_relaxed);
+            m_live_sample_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void heap_profiler::record_deallocation(void* ptr) {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        if (m_samples.erase(ptr) != 0) {
+            m_sample_filter[filter_index(ptr)].fetch_sub(1, std::memory_order_relaxed);
+            m_live_sample_count.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    void heap_profiler::record_reallocation(void* old_ptr, void* new_ptr, size_t new_size) {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        auto node = m_samples.extract(old_ptr);
+        if (node.empty()) {
+            return;
+        }
+        m_sample_filter[filter_index(old_ptr)].fetch_sub(1, std::memory_order_relaxed);
+        node.key() = new_ptr;
+        node.mapped().size = new_size;
+        m_samples.insert(std::move(node));
+        m_sample_filter[filter_index(new_ptr)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::vector<heap_sample> heap_profiler::live_samples() {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        std::vector<heap_sample> result;
+        result.reserve(m_samples.size());
+        for (auto& [_, sample] : m_samples) {
+            result.push_back(sample);
+        }
+        return result;
+    }
+
+    void heap_profiler::dump(std::ostream& out, heap_profile_format format) {
+        // 先复制出来，输出时不持有锁
+        std::map<std::vector<void*>, stack_total> totals;
+        stack_total sum;
+        for (auto& sample : live_samples()) {
+            // 采样的概率是 1 - e^(-size / interval)，按概率的倒数放大
+            double scale = 1.0;
+            if (sample.sample_interval > 1) {
+                scale = 1.0 / -std::expm1(-static_cast<double>(sample.size) / static_cast<double>(sample.sample_interval));
+            }
+            auto& total = totals[std::vector<void*>(sample.stack.begin(), sample.stack.begin() + sample.stack_depth)];
+            total.count += scale;
+            total.bytes += scale * static_cast<double>(sample.size);
+            sum.count += scale;
+            sum.bytes += scale * static_cast<double>(sample.size);
+        }
+
+        if (format == heap_profile_format::collapsed) {
+            // 调用栈从最外层的调用者开始
+            for (auto& [stack, total] : totals) {
+                for (size_t i = stack.size(); i > 0; i--) {
+                    out << symbolize(stack[i - 1]) << (i > 1 ? ";" : "");
+                }
+                out << " " << std::llround(total.bytes) << "\n";
+            }
+            return;
+        }
+
+        // 存活的与累计的都使用存活的采样
+        auto counts = [&out](const stack_total& total) {
+            out << std::llround(total.count) << ": " << std::llround(total.bytes) << " [" << std::llround(total.count) << ": "
+                << std::llround(total.bytes) << "]";
+        };
+        out << "heap profile: ";
+        counts(sum);
+        out << " @ heapprofile\n";
+        for (auto& [stack, total] : totals) {
+            counts(total);
+            out << " @";
+            for (void* address : stack) {
+                out << " " << address;
+            }
+            out << "\n";
+        }
+        // pprof 需要地址空间的布局才能把地址对应到符号
+        out << "\nMAPPED_LIBRARIES:\n";
+        if (std::ifstream maps("/proc/self/maps"); maps.is_open()) {
+            out << maps.rdbuf();
+        }
+    }
+} // memory_pool_v2
@@ -0,0 +1,112 @@
+//
+// Created by ghost-him on 25-5-8.
+//
+
+#ifndef HEAP_PROFILER_H
+#define HEAP_PROFILER_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace memory_pool_v2 {
+
+    // 堆分析结果的输出格式
+    enum class heap_profile_format {
+        // gperftools 的文本格式，可以直接用 pprof 打开
+        pprof,
+        // 折叠的调用栈，每行是 "调用者;...;被调用者 字节数"，可以用 flamegraph.pl 生成火焰图
+        collapsed,
+    };
+
+    // 一次被采样的申请
+    struct heap_sample {
+        static constexpr size_t MAX_STACK_DEPTH = 32;
+        size_t size = 0;
+        // 采样时的平均间隔，用于估算这次采样代表的申请
+        size_t sample_interval = 0;
+        size_t stack_depth = 0;
+        std::array<void*, MAX_STACK_DEPTH> stack = {};
+    };
+
+    // 采样的堆分析：平均每申请 sample_interval 字节采样一次，记录调用栈，直到这块内存被归还
+    // 线程缓存维护一个字节数的计数器，只有计数器减到 0 以下时才会进入采样的慢速路径
+    class heap_profiler {
+    public:
+        static constexpr size_t DEFAULT_SAMPLE_INTERVAL = 512 * 1024;
+        // 没有开启时，线程缓存每申请这么多字节检查一次是否开启了，所以开启以后最多在这么多字节以后开始采样
+        static constexpr size_t DISABLED_CHECK_INTERVAL = 64 * 1024 * 1024;
+
+        static heap_profiler& get_instance() {
+            static heap_profiler instance;
+            return instance;
+        }
+
+        /// 开始采样
+        /// 参数：sample_interval: 平均每申请多少字节采样一次，为 1 时每次申请都会被采样
+        void start(size_t sample_interval = DEFAULT_SAMPLE_INTERVAL);
+
+        /// 停止采样，已经记录的采样仍然保留，直到被归还或者调用 clear
+        void stop();
+
+        /// 清除所有记录的采样
+        void clear();
+
+        bool is_running() const { return m_running.load(std::memory_order_relaxed); }
+        size_t sample_interval() const { return m_sample_interval.load(std::memory_order_relaxed); }
+
+        /// 计算下一次采样前还要申请的字节数，采样的间隔服从指数分布，平均值为 sample_interval
+        /// 没有开启时返回 DISABLED_CHECK_INTERVAL
+        size_t next_sample_distance();
+
+        /// 记录一次被采样的申请，会抓取当前的调用栈
+        void record_allocation(void* ptr, size_t size);
+
+        /// 判断一个指针可能是被采样的，返回 false 时一定没有被采样
+        /// 没有任何存活的采样时只读取一个计数器
+        bool might_be_sampled(const void* ptr) const {
+            if (m_live_sample_count.load(std::memory_order_relaxed) == 0) {
+                return false;
+            }
+            return m_sample_filter[filter_index(ptr)].load(std::memory_order_relaxed) != 0;
+        }
+
+        /// 内存块被归还时移除对应的采样
+        void record_deallocation(void* ptr);
+
+        /// 内存块被 mremap 移动或者调整大小时，把采样移到新的地址
+        void record_reallocation(void* old_ptr, void* new_ptr, size_t new_size);
+
+        /// 当前存活的采样
+        std::vector<heap_sample> live_samples();
+        size_t live_sample_count() const { return m_live_sample_count.load(std::memory_order_relaxed); }
+
+        /// 输出当前存活的采样，按调用栈合并，个数与字节数已经按采样的概率放大为估算值
+        void dump(std::ostream& out, heap_profile_format format);
+
+    private:
+        heap_profiler() = default;
+
+        static constexpr size_t FILTER_SIZE = 64 * 1024;
+        static size_t filter_index(const void* ptr) {
+            // 内存块至少按 8 字节对齐，去掉低位以后做乘法散列
+            return static_cast<size_t>((reinterpret_cast<uintptr_t>(ptr) >> 3) * 0x9E3779B97F4A7C15ull >> 48) % FILTER_SIZE;
+        }
+
+        std::atomic<bool> m_running = false;
+        std::atomic<size_t> m_sample_interval = DEFAULT_SAMPLE_INTERVAL;
+
+        std::mutex m_mutex;
+        std::unordered_map<void*, heap_sample> m_samples;
+        // 存活的采样的个数，以及按地址散列以后每个位置上的个数，用于在回收时快速排除没有被采样的指针
+        std::atomic<size_t> m_live_sample_count = 0;
+        std::array<std::atomic<uint32_t>, FILTER_SIZE> m_sample_filter = {};
+    };
+
+} // memory_pool_v2
+
+#endif //HEAP_PROFILER_H
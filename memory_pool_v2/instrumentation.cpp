@@ -0,0 +1,101 @@
+//
+// Created by ghost-him on 25-5-7.
+//
+
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace memory_pool_v2 {
+    const char* instrument_event_name(instrument_event event) {
+        switch (event) {
+            case instrument_event::thread_cache_allocate: return "thread_cache_allocate";
+            case instrument_event::thread_cache_fast_path: return "thread_cache_fast_path";
+            case instrument_event::thread_cache_deallocate: return "thread_cache_deallocate";
+            case instrument_event::thread_cache_refill: return "thread_cache_refill";
+            case instrument_event::central_cache_allocate: return "central_cache_allocate";
+            case instrument_event::central_cache_deallocate: return "central_cache_deallocate";
+            case instrument_event::page_cache_allocate_page: return "page_cache_allocate_page";
+            case instrument_event::page_cache_system_allocate: return "page_cache_system_allocate";
+            case instrument_event::system_mmap: return "mmap";
+            case instrument_event::system_munmap: return "munmap";
+            case instrument_event::system_madvise: return "madvise";
+            case instrument_event::system_mremap: return "mremap";
+            case instrument_event::COUNT: break;
+        }
+        return "unknown";
+    }
+
+#ifdef MEMORY_POOL_INSTRUMENTATION
+    namespace {
+        // 所有存活线程的计数器，以及已经退出的线程累计的结果
+        struct counters_registry {
+            std::mutex mutex;
+            std::vector<instrument_counters*> counters;
+            instrumentation_stats retired;
+        };
+
+        counters_registry& get_registry() {
+            static counters_registry registry;
+            return registry;
+        }
+    }
+
+    instrument_counters::instrument_counters() {
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        registry.counters.push_back(this);
+    }
+
+    instrument_counters::~instrument_counters() {
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        t_destroyed = true;
+        std::erase(registry.counters, this);
+        for (size_t event = 0; event < m_events.size(); event++) {
+            auto& result = registry.retired.events[event];
+            result.count += m_events[event].count.load(std::memory_order_relaxed);
+            result.bytes += m_events[event].bytes.load(std::memory_order_relaxed);
+            for (size_t bucket = 0; bucket < instrument_event_stats::BUCKET_COUNT; bucket++) {
+                result.size_histogram[bucket] += m_events[event].size_histogram[bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void instrument_counters::record_retired(instrument_event event, size_t bytes) {
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        auto& result = registry.retired.events[static_cast<size_t>(event)];
+        result.count += 1;
+        result.bytes += bytes;
+        result.size_histogram[std::bit_width(bytes)] += 1;
+    }
+
+    instrumentation_stats instrument_counters::snapshot() {
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        instrumentation_stats result = registry.retired;
+        for (const instrument_counters* counters : registry.counters) {
+            for (size_t event = 0; event < counters->m_events.size(); event++) {
+                auto& source = counters->m_events[event];
+                result.events[event].count += source.count.load(std::memory_order_relaxed);
+                result.events[event].bytes += source.bytes.load(std::memory_order_relaxed);
+                for (size_t bucket = 0; bucket < instrument_event_stats::BUCKET_COUNT; bucket++) {
+                    result.events[event].size_histogram[bucket] += source.size_histogram[bucket].load(std::memory_order_relaxed);
+                }
+            }
+        }
+        return result;
+    }
+
+    instrumentation_stats get_instrumentation_stats() {
+        return instrument_counters::snapshot();
+    }
+#else
+    instrumentation_stats get_instrumentation_stats() {
+        return {};
+    }
+#endif
+} // memory_pool_v2
@@ -0,0 +1,120 @@
+//
+// Created by ghost-him on 25-5-7.
+//
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+namespace memory_pool_v2 {
+
+    // 各层边界上可以统计的事件
+    enum class instrument_event : size_t {
+        // 线程缓存的申请与回收，以及申请时直接从线程缓存中取到的次数
+        thread_cache_allocate,
+        thread_cache_fast_path,
+        thread_cache_deallocate,
+        // 线程缓存向中心缓存批量申请
+        thread_cache_refill,
+        central_cache_allocate,
+        central_cache_deallocate,
+        page_cache_allocate_page,
+        // 页缓存向系统申请页面
+        page_cache_system_allocate,
+        // 系统调用
+        system_mmap,
+        system_munmap,
+        system_madvise,
+        system_mremap,
+        COUNT,
+    };
+
+    /// 事件的名字，用于输出
+    const char* instrument_event_name(instrument_event event);
+
+    // 一种事件的统计：次数、字节数的总和，以及按字节数的 2 的幂分组的直方图
+    struct instrument_event_stats {
+        static constexpr size_t BUCKET_COUNT = 65;
+        size_t count = 0;
+        size_t bytes = 0;
+        // 第 i 组的字节数在 [2^(i - 1), 2^i) 之间，第 0 组是 0 字节
+        std::array<size_t, BUCKET_COUNT> size_histogram = {};
+    };
+
+    struct instrumentation_stats {
+        std::array<instrument_event_stats, static_cast<size_t>(instrument_event::COUNT)> events = {};
+
+        const instrument_event_stats& operator[](instrument_event event) const { return events[static_cast<size_t>(event)]; }
+    };
+
+    // 编译时使用 MEMORY_POOL_INSTRUMENTATION 开启，关闭时 MEMORY_POOL_INSTRUMENT 展开为空，不会生成任何代码
+#ifdef MEMORY_POOL_INSTRUMENTATION
+    inline constexpr bool instrumentation_enabled = true;
+
+    // 每个线程的计数器，只有所属的线程会修改，其他线程在汇总时读取
+    class instrument_counters {
+    public:
+        static instrument_counters& get_instance() {
+            static thread_local instrument_counters instance;
+            return instance;
+        }
+
+        /// 记录一次事件，统计宏展开为这个函数
+        /// 线程缓存可能在计数器析构之后才析构（例如线程退出时把缓存的内存块还给中心缓存），此时直接累计到已经退出的线程的结果中
+        static void record_event(instrument_event event, size_t bytes) {
+            if (t_destroyed) [[unlikely]] {
+                record_retired(event, bytes);
+                return;
+            }
+            get_instance().record(event, bytes);
+        }
+
+        void record(instrument_event event, size_t bytes) {
+            auto& counter = m_events[static_cast<size_t>(event)];
+            add(counter.count, 1);
+            add(counter.bytes, bytes);
+            add(counter.size_histogram[std::bit_width(bytes)], 1);
+        }
+
+        /// 把所有存活线程与已经退出的线程的计数器汇总起来
+        static instrumentation_stats snapshot();
+
+        instrument_counters(const instrument_counters&) = delete;
+        instrument_counters& operator=(const instrument_counters&) = delete;
+    private:
+        instrument_counters();
+        ~instrument_counters();
+
+        static void record_retired(instrument_event event, size_t bytes);
+
+        static void add(std::atomic<size_t>& counter, size_t value) {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+
+        struct event_counters {
+            std::atomic<size_t> count = 0;
+            std::atomic<size_t> bytes = 0;
+            std::array<std::atomic<size_t>, instrument_event_stats::BUCKET_COUNT> size_histogram = {};
+        };
+        std::array<event_counters, static_cast<size_t>(instrument_event::COUNT)> m_events;
+        // 这个线程的计数器是否已经析构，不需要析构，线程退出的整个过程中都可以读取
+        static inline constinit thread_local bool t_destroyed = false;
+    };
+
+#define MEMORY_POOL_INSTRUMENT(event, bytes) \
+    ::memory_pool_v2::instrument_counters::record_event(::memory_pool_v2::instrument_event::event, (bytes))
+#else
+    inline constexpr bool instrumentation_enabled = false;
+
+#define MEMORY_POOL_INSTRUMENT(event, bytes) ((void)0)
+#endif
+
+    /// 汇总所有线程的事件统计，没有开启时全部为 0
+    instrumentation_stats get_instrumentation_stats();
+
+} // memory_pool_v2
+
+#endif //INSTRUMENTATION_H
@@ -4,5 +4,176 @@
 
 #include "memory_pool.h"
 
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "central_cache.h"
+
 namespace memory_pool_v2 {
-} // memory_pool
\ No newline at end of file
+    namespace {
+        /// 访问一段内存中的每一页，使内核分配好物理页
+        void prefault_memory(void* memory, size_t memory_size) {
+            auto* bytes = static_cast<volatile std::byte*>(memory);
+            for (size_t offset = 0; offset < memory_size; offset += size_utils::PAGE_SIZE) {
+                bytes[offset] = std::byte {0};
+            }
+            bytes[memory_size - 1] = std::byte {0};
+        }
+    }
+
+    bool memory_pool::reserve(size_t memory_size, size_t count, bool prefault) {
+        if (memory_size == 0 || count == 0) {
+            return true;
+        }
+        // 先全部申请再全部归还，否则归还的内存块会被下一次申请直接取走
+        // 直接使用线程缓存，预热的内存不需要被记录或者采样
+        thread_cache& cache = thread_cache::get_instance();
+        // 归还时变空的页面留在中心缓存中，否则会立即还给页缓存，并且减少这个规格下一次向页缓存申请的组数
+        // 只对当前线程生效，多个线程同时预热时互不影响
+        const bool deferred = central_cache::set_thread_defer_span_release(true);
+        std::vector<void*> blocks;
+        blocks.reserve(count);
+        bool succeed = true;
+        for (size_t i = 0; i < count; i++) {
+            auto block = cache.allocate(memory_size);
+            if (!block.has_value()) {
+                succeed = false;
+                break;
+            }
+            if (prefault) {
+                prefault_memory(block.value(), memory_size);
+            }
+            blocks.push_back(block.value());
+        }
+        // 倒序归还，最先申请的内存块最后归还，之后会最先被取出来
+        for (auto it = blocks.rbegin(); it != blocks.rend(); ++it) {
+            cache.deallocate(*it, memory_size);
+        }
+        central_cache::set_thread_defer_span_release(deferred);
+        return succeed;
+    }
+
+    bool memory_pool::prewarm(const prewarm_profile& profile) {
+        bool succeed = true;
+        // 先预热每个大小，预热的页面留在中心缓存中，之后准备的空闲页才不会被它们用掉
+        for (const auto& entry : profile.entries) {
+            succeed &= reserve(entry.memory_size, entry.count, profile.prefault);
+        }
+        if (profile.page_bytes != 0) {
+            // 申请后直接归还，页面留在页缓存的空闲页中
+            page_cache& pages = page_cache::get_instance();
+            const size_t page_count = size_utils::align(profile.page_bytes, size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+            auto memory = pages.allocate_page(page_count);
+            if (memory.has_value()) {
+                if (profile.prefault) {
+                    prefault_memory(memory->data(), memory->size());
+                }
+                pages.deallocate_page(memory.value());
+            } else {
+                succeed = false;
+            }
+        }
+        return succeed;
+    }
+
+    bool memory_pool::save_allocation_profile(const std::string& path) {
+        const auto profile = central_cache::get_instance().get_allocation_profile();
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+        out << "# memory_pool_v2 allocation profile\n";
+        out << "# memory_size batch_count peak_count page_group_count\n";
+        for (const auto& entry : profile) {
+            out << entry.memory_size << ' ' << entry.batch_count << ' ' << entry.peak_count << ' ' << entry.page_group_count << '\n';
+        }
+        return static_cast<bool>(out.flush());
+    }
+
+    bool memory_pool::load_allocation_profile(const std::string& path, bool prewarm) {
+        std::ifstream in(path);
+        if (!in) {
+            return false;
+        }
+        // 先读取全部的内容，格式不正确时不做任何修改
+        std::vector<allocation_profile_entry> profile;
+        std::string line;
+        while (std::getline(in, line)) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::istringstream fields(line);
+            allocation_profile_entry entry;
+            if (!(fields >> entry.memory_size >> entry.batch_count >> entry.peak_count >> entry.page_group_count) ||
+                entry.memory_size == 0 || entry.memory_size > size_utils::MAX_CACHED_UNIT_SIZE || entry.memory_size % size_utils::ALIGNMENT != 0) {
+                return false;
+            }
+            profile.push_back(entry);
+        }
+
+        central_cache& central = central_cache::get_instance();
+        central.apply_allocation_profile(profile);
+        for (const auto& entry : profile) {
+            thread_cache::set_initial_allocate_count(entry.memory_size, entry.batch_count);
+        }
+        if (prewarm) {
+            prewarm_profile warm;
+            for (const auto& entry : profile) {
+                warm.entries.push_back({entry.memory_size, entry.peak_count});
+            }
+            memory_pool::prewarm(warm);
+            // 预热时的申请不代表真实的需求，否则保存的峰值只会越来越大
+            central.reset_allocation_peaks();
+            // 预热时向页缓存申请页面也会增加组数，重新设置为保存的值
+            central.apply_allocation_profile(profile);
+        }
+        return true;
+    }
+
+    bool memory_pool::enable_allocation_profile(const std::string& path, bool prewarm) {
+        static std::string saved_path;
+        const bool loaded = load_allocation_profile(path, prewarm);
+        // 先构造中心缓存，它在退出时的析构晚于下面注册的函数
+        central_cache::get_instance();
+        if (saved_path.empty()) {
+            std::atexit([] { save_allocation_profile(saved_path); });
+        }
+        saved_path = path;
+        return loaded;
+    }
+
+    memory_pool_stats memory_pool::stats() {
+        memory_pool_stats result;
+        // 先按下标收集，最后只保留有数据的规格
+        result.size_classes.resize(size_utils::CACHE_LINE_SIZE);
+        thread_cache::collect_stats(result);
+        central_cache::get_instance().collect_stats(result);
+        result.pages = page_cache::get_instance().get_stats();
+        result.large.page_bytes = page_cache::get_instance().large_page_bytes();
+        result.large.direct_mapped_count = page_cache::get_instance().direct_mapped_count();
+        result.large.direct_mapped_bytes = page_cache::get_instance().direct_mapped_bytes();
+
+        std::vector<size_class_stats> size_classes;
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            size_class_stats& size_class = result.size_classes[index];
+            size_class.memory_size = (index + 1) * size_utils::ALIGNMENT;
+            size_class.thread_cache_bytes = size_class.thread_cache_count * size_class.memory_size;
+            size_class.central_cache_bytes = size_class.central_cache_count * size_class.memory_size;
+            if (size_class.thread_cache_count == 0 && size_class.central_cache_count == 0 && size_class.span_count == 0 &&
+                size_class.refill_count == 0 && size_class.overflow_count == 0 && size_class.lock_contention_count == 0) {
+                continue;
+            }
+            result.thread_cache_bytes += size_class.thread_cache_bytes;
+            result.central_cache_bytes += size_class.central_cache_bytes;
+            result.span_count += size_class.span_count;
+            result.span_bytes += size_class.span_bytes;
+            result.refill_count += size_class.refill_count;
+            result.overflow_count += size_class.overflow_count;
+            result.lock_contention_count += size_class.lock_contention_count;
+            size_classes.push_back(size_class);
+        }
+        result.size_classes = std::move(size_classes);
+        return result;
+    }
+} // memory_pool
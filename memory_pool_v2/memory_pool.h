@@ -5,25 +5,174 @@
 #ifndef MEMORY_POOL_H
 #define MEMORY_POOL_H
 #include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
 
+#include "heap_profiler.h"
+#include "memory_pool_stats.h"
+#include "page_cache.h"
+#include "scavenger.h"
 #include "thread_cache.h"
+#include "trace_recorder.h"
 
 namespace memory_pool_v2 {
 
+// 启动时预热的内容，每一项为一个大小与需要准备的内存块个数
+struct prewarm_entry {
+    size_t memory_size = 0;
+    size_t count = 0;
+};
+
+struct prewarm_profile {
+    std::vector<prewarm_entry> entries;
+    // 额外在页缓存中准备好的空闲页的字节数，之后新的规格与大内存块也不需要再向系统申请
+    size_t page_bytes = 0;
+    // 是否访问每一页，使物理页在启动时就分配好，之后不会缺页
+    bool prefault = true;
+};
+
 class memory_pool {
 public:
     /// 向内存池申请一块空间
     /// 参数：要申请的大小
     /// 返回值：指向空间的指针，可能会申请失败
     static std::optional<void*> allocate(size_t memory_size) {
-        return thread_cache::get_instance().allocate(memory_size);
+        auto result = thread_cache::get_instance().allocate(memory_size);
+        if (trace_recorder::is_recording()) [[unlikely]] {
+            trace_recorder::get_instance().record(trace_operation::allocate, result.value_or(nullptr), memory_size);
+        }
+        return result;
     }
 
     /// 向内存池归还一片空间
     /// 参数： start_p:内存开始的地址, size_t：这片地址的大小
     static void deallocate(void* start_p, size_t memory_size) {
+        if (trace_recorder::is_recording()) [[unlikely]] {
+            // 先记录再回收，否则这个地址可能已经被其他线程重新申请了
+            trace_recorder::get_instance().record(trace_operation::deallocate, start_p, memory_size);
+        }
         thread_cache::get_instance().deallocate(start_p, memory_size);
     }
+
+    /// 调整一片空间的大小，保留原来的内容，超过 page_cache::direct_map_threshold 的空间使用 mremap 调整，不需要复制
+    /// 参数：start_p: 原来的地址，old_size: 原来的大小，new_size: 新的大小，为 0 时归还原来的空间
+    /// 返回值：新的地址，失败时返回 nullopt，原来的空间不变；new_size 为 0 时返回 nullptr，原来的地址已经失效
+    static std::optional<void*> reallocate(void* start_p, size_t old_size, size_t new_size) {
+        if (trace_recorder::is_recording()) [[unlikely]] {
+            return record_reallocate(start_p, old_size, new_size);
+        }
+        return thread_cache::get_instance().reallocate(start_p, old_size, new_size);
+    }
+
+    /// 开始把每一次申请、回收与调整大小记录到文件中，用于之后使用 memory_pool_replay 回放
+    /// 参数：path: 记录文件的路径
+    /// 返回值：文件是否打开成功
+    static bool start_trace(const std::string& path) {
+        return trace_recorder::get_instance().start(path);
+    }
+
+    /// 结束记录并关闭文件
+    static void stop_trace() {
+        trace_recorder::get_instance().stop();
+    }
+
+    /// 设置单独 mmap 的阈值，超过这个大小的空间单独向系统申请
+    static void set_direct_map_threshold(size_t threshold) {
+        page_cache::get_instance().set_direct_map_threshold(threshold);
+    }
+
+    /// 设置线程缓存的上限与各层的增长参数，没有调用时使用环境变量中的参数（见 memory_pool_config::from_environment）
+    /// 必须在第一次申请内存之前调用（包括 reserve、prewarm 与 load_allocation_profile），之后参数不再改变
+    /// 返回值：是否设置成功，参数不合法或者已经申请过内存时返回 false
+    static bool configure(const memory_pool_config& config) {
+        return runtime_config::configure(config);
+    }
+
+    /// 当前使用（或者将要使用）的参数
+    static memory_pool_config get_config() {
+        return runtime_config::get();
+    }
+
+    /// 预留一段连续的虚拟地址空间，之后的页面都从中按需提交，必须在第一次申请内存之前调用
+    /// 参数：size: 预留的字节数，默认为 64GB
+    /// 返回值：是否预留成功
+    static bool reserve_address_space(size_t size = 64ull * 1024 * 1024 * 1024) {
+        return page_cache::get_instance().reserve_address_space(size);
+    }
+
+    /// 预热一个大小的内存：申请 count 个内存块以后全部归还，使调用线程的线程缓存、中心缓存与页缓存中都准备好这个大小的内存
+    /// 线程缓存只保留不超过上限的部分，其余的以空页面的形式留在中心缓存中（开启回收线程时会在之后的整理中还给页缓存），其他线程第一次申请时也不需要再向系统申请
+    /// 应该在启动时、开始处理请求之前调用，每个工作线程都调用一次可以同时准备好各自的线程缓存
+    /// 参数：memory_size: 内存块的大小，count: 内存块的个数，prefault: 是否访问内存块的每一页
+    /// 返回值：是否全部申请成功，失败时已经申请的内存块同样会归还
+    static bool reserve(size_t memory_size, size_t count, bool prefault = true);
+
+    /// 按照预热的配置依次调用 reserve，并在页缓存中准备好额外的空闲页
+    /// 返回值：是否全部申请成功
+    static bool prewarm(const prewarm_profile& profile);
+
+    /// 把每个规格学习到的需求（线程缓存一次申请的个数、同时分配出去的峰值、向页缓存申请的组数）写入文件
+    /// 参数：path: 文件的路径，每行为 "大小 一次申请的个数 峰值 组数"，# 开头的行是注释
+    /// 返回值：文件是否写入成功
+    static bool save_allocation_profile(const std::string& path);
+
+    /// 读取之前保存的需求：新的线程缓存第一次就按学习到的个数申请，中心缓存按学习到的组数申请页面
+    /// 应该在启动时、第一次申请内存之前调用
+    /// 参数：path: 文件的路径，prewarm: 是否同时按峰值预热每个规格（见 reserve），预热本身不计入之后保存的需求
+    /// 返回值：文件是否读取成功，文件不存在或者格式不正确时不做任何修改
+    static bool load_allocation_profile(const std::string& path, bool prewarm = true);
+
+    /// 启动时读取 path 中保存的需求，并在程序正常退出（exit 或者 main 返回）时把这一次学习到的需求写回同一个文件
+    /// 用于频繁重启的服务，每次重启以后不需要重新学习
+    /// 返回值：是否读取到了之前保存的需求，第一次运行时文件不存在，返回 false，但退出时仍然会写入
+    static bool enable_allocation_profile(const std::string& path, bool prewarm = true);
+
+    /// 获取内存池各层的统计信息快照：线程缓存、中心缓存、页缓存中每个规格的空闲内存块与页面，以及大内存块
+    /// 统计时不会暂停分配，各个计数器分别读取，并发分配时彼此之间可能有少量的偏差
+    static memory_pool_stats stats();
+
+    /// 开始采样的堆分析，平均每申请 sample_interval 字节记录一次调用栈，直到这块内存被归还
+    /// 已经存在的线程最多在再申请 heap_profiler::DISABLED_CHECK_INTERVAL 字节以后开始采样
+    static void start_heap_profiler(size_t sample_interval = heap_profiler::DEFAULT_SAMPLE_INTERVAL) {
+        heap_profiler::get_instance().start(sample_interval);
+    }
+
+    /// 停止采样，已经记录的采样仍然可以输出
+    static void stop_heap_profiler() {
+        heap_profiler::get_instance().stop();
+    }
+
+    /// 输出当前存活的采样，按调用栈合并并放大为估算值
+    /// 参数：out: 输出的位置，format: pprof 或者折叠的调用栈
+    static void dump_heap_profile(std::ostream& out, heap_profile_format format = heap_profile_format::pprof) {
+        heap_profiler::get_instance().dump(out, format);
+    }
+
+    /// 启动后台回收线程，定期将长时间空闲的页面归还给操作系统
+    /// 参数：config: 回收的间隔、速率与驻留内存的目标值
+    static void start_scavenger(const scavenger_config& config = {}) {
+        scavenger::get_instance().start(config);
+    }
+
+    /// 停止后台回收线程
+    static void stop_scavenger() {
+        scavenger::get_instance().stop();
+    }
+
+private:
+    /// 记录时的调整大小，大小为 0 时等同于回收，调整失败时原来的空间不变
+    static std::optional<void*> record_reallocate(void* start_p, size_t old_size, size_t new_size) {
+        auto& recorder = trace_recorder::get_instance();
+        if (start_p != nullptr && old_size != 0 && new_size == 0) {
+            recorder.record(trace_operation::deallocate, start_p, old_size);
+        }
+        auto result = thread_cache::get_instance().reallocate(start_p, old_size, new_size);
+        if (result.has_value() && new_size != 0) {
+            recorder.record(trace_operation::reallocate, result.value(), new_size, start_p);
+        }
+        return result;
+    }
 };
 
 } // memory_pool
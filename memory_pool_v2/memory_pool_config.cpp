@@ -0,0 +1,176 @@
+//
+// Created by ghost-him on 25-5-13.
+//
+
+#include "memory_pool_config.h"
+
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+namespace memory_pool_v2 {
+    namespace {
+        // 解析一个数字，可以带 K / M / G 后缀
+        std::optional<size_t> parse_size(std::string_view text) {
+            size_t unit = 1;
+            if (!text.empty()) {
+                switch (text.back()) {
+                    case 'K': case 'k': unit = 1024; break;
+                    case 'M': case 'm': unit = 1024 * 1024; break;
+                    case 'G': case 'g': unit = 1024 * 1024 * 1024; break;
+                    default: break;
+                }
+                if (unit != 1) {
+                    text.remove_suffix(1);
+                }
+            }
+            size_t value = 0;
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            if (text.empty() || error != std::errc() || end != text.data() + text.size()) {
+                return std::nullopt;
+            }
+            // 乘上单位以后溢出的值不能回绕成另一个看起来合法的数字
+            if (value > std::numeric_limits<size_t>::max() / unit) {
+                return std::nullopt;
+            }
+            return value * unit;
+        }
+
+        // 参数的名称与对应的环境变量
+        constexpr std::pair<std::string_view, const char*> OPTION_NAMES[] = {
+            {"max_free_bytes_per_list", "MEMORY_POOL_MAX_FREE_BYTES_PER_LIST"},
+            {"page_allocate_count", "MEMORY_POOL_PAGE_ALLOCATE_COUNT"},
+            {"max_page_group_count", "MEMORY_POOL_MAX_PAGE_GROUP_COUNT"},
+            {"min_batch_count", "MEMORY_POOL_MIN_BATCH_COUNT"},
+            {"max_cached_unit_size", "MEMORY_POOL_MAX_CACHED_UNIT_SIZE"},
+            {"class_max_free_bytes", "MEMORY_POOL_CLASS_MAX_FREE_BYTES"},
+        };
+
+        // 将要使用的参数，以及保护它的锁
+        struct pending_config {
+            std::mutex mutex;
+            memory_pool_config config = memory_pool_config::from_environment();
+        };
+
+        pending_config& get_pending() {
+            static pending_config pending;
+            return pending;
+        }
+    }
+
+    bool memory_pool_config::set(std::string_view name, std::string_view value) {
+        if (name == "class_max_free_bytes") {
+            std::vector<std::pair<size_t, size_t>> result;
+            while (!value.empty()) {
+                const size_t comma = value.find(',');
+                const std::string_view item = value.substr(0, comma);
+                const size_t equal = item.find('=');
+                if (equal == std::string_view::npos) {
+                    return false;
+                }
+                auto memory_size = parse_size(item.substr(0, equal));
+                auto bytes = parse_size(item.substr(equal + 1));
+                if (!memory_size.has_value() || !bytes.has_value()) {
+                    return false;
+                }
+                result.emplace_back(*memory_size, *bytes);
+                value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+            }
+            class_max_free_bytes = std::move(result);
+            return true;
+        }
+        size_t* target = nullptr;
+        if (name == "max_free_bytes_per_list") {
+            target = &max_free_bytes_per_list;
+        } else if (name == "page_allocate_count") {
+            target = &page_allocate_count;
+        } else if (name == "max_page_group_count") {
+            target = &max_page_group_count;
+        } else if (name == "min_batch_count") {
+            target = &min_batch_count;
+        } else if (name == "max_cached_unit_size") {
+            target = &max_cached_unit_size;
+        }
+        auto parsed = parse_size(value);
+        if (target == nullptr || !parsed.has_value()) {
+            return false;
+        }
+        *target = *parsed;
+        return true;
+    }
+
+    memory_pool_config memory_pool_config::from_environment() {
+        memory_pool_config result;
+        for (auto [name, environment] : OPTION_NAMES) {
+            if (const char* value = std::getenv(environment); value != nullptr && !result.set(name, value)) {
+                return {};
+            }
+        }
+        // 参数不合法时全部使用默认值，避免只有一部分生效
+        if (!result.is_valid()) {
+            return {};
+        }
+        return result;
+    }
+
+    bool memory_pool_config::is_valid() const {
+        auto valid_size = [](size_t memory_size) {
+            return memory_size != 0 && memory_size % size_utils::ALIGNMENT == 0 && memory_size <= size_utils::MAX_CACHED_UNIT_SIZE;
+        };
+        if (!valid_size(max_cached_unit_size) || max_free_bytes_per_list < 2 * max_cached_unit_size || page_allocate_count == 0 ||
+            max_page_group_count == 0 || min_batch_count == 0) {
+            return false;
+        }
+#ifndef NDEBUG
+        // 调试模式下中心缓存一次最多分配 MAX_UNIT_COUNT 个内存块
+        if (min_batch_count > page_span::MAX_UNIT_COUNT) {
+            return false;
+        }
+#endif
+        for (auto [memory_size, bytes] : class_max_free_bytes) {
+            if (!valid_size(memory_size) || bytes < 2 * memory_size) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool runtime_config::configure(const memory_pool_config& config) {
+        if (!config.is_valid()) {
+            return false;
+        }
+        auto& pending = get_pending();
+        std::unique_lock<std::mutex> guard(pending.mutex);
+        if (s_applied.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        pending.config = config;
+        return true;
+    }
+
+    memory_pool_config runtime_config::get() {
+        auto& pending = get_pending();
+        std::unique_lock<std::mutex> guard(pending.mutex);
+        return pending.config;
+    }
+
+    void runtime_config::apply() {
+        auto& pending = get_pending();
+        std::unique_lock<std::mutex> guard(pending.mutex);
+        const memory_pool_config& config = pending.config;
+        s_values.max_cached_unit_size = config.max_cached_unit_size;
+        s_values.max_free_bytes_per_list = config.max_free_bytes_per_list;
+        s_values.page_allocate_count = config.page_allocate_count;
+        s_values.max_page_group_count = config.max_page_group_count;
+        s_values.min_batch_count = config.min_batch_count;
+        s_values.class_max_free_bytes.fill(config.max_free_bytes_per_list);
+        for (auto [memory_size, bytes] : config.class_max_free_bytes) {
+            s_values.class_max_free_bytes[size_utils::get_index(memory_size)] = bytes;
+        }
+        s_applied.store(true, std::memory_order_relaxed);
+    }
+
+} // memory_pool_v2
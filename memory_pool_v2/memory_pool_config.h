@@ -0,0 +1,105 @@
+//
+// Created by ghost-him on 25-5-13.
+//
+
+#ifndef MEMORY_POOL_CONFIG_H
+#define MEMORY_POOL_CONFIG_H
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "utils.h"
+
+namespace memory_pool_v2 {
+
+    // 运行时可以调整的参数，默认值与原来的常量相同
+    struct memory_pool_config {
+        static constexpr size_t DEFAULT_MAX_FREE_BYTES_PER_LIST = 256 * 1024;
+        static constexpr size_t DEFAULT_PAGE_ALLOCATE_COUNT = 2048;
+        static constexpr size_t DEFAULT_MAX_PAGE_GROUP_COUNT = 8;
+        static constexpr size_t DEFAULT_MIN_BATCH_COUNT = 4;
+
+        // 线程缓存中每个规格的空闲链表的字节数上限，超过时把一半还给中心缓存
+        size_t max_free_bytes_per_list = DEFAULT_MAX_FREE_BYTES_PER_LIST;
+        // 页缓存一次向系统申请的页数
+        size_t page_allocate_count = DEFAULT_PAGE_ALLOCATE_COUNT;
+        // 中心缓存一次向页缓存申请的组数上限，一组为这个规格的空闲链表上限
+        size_t max_page_group_count = DEFAULT_MAX_PAGE_GROUP_COUNT;
+        // 线程缓存一次向中心缓存申请的最少个数
+        size_t min_batch_count = DEFAULT_MIN_BATCH_COUNT;
+        // 不超过这个大小的内存块按规格缓存，超过的按页数作为大内存块处理，不能超过 size_utils::MAX_CACHED_UNIT_SIZE
+        size_t max_cached_unit_size = size_utils::MAX_CACHED_UNIT_SIZE;
+        // 单独设置某些规格的空闲链表上限：(内存块的大小, 字节数)
+        std::vector<std::pair<size_t, size_t>> class_max_free_bytes;
+
+        /// 按名称设置一个参数，名称与成员变量相同
+        /// 参数：name: 参数的名称，value: 单个数字，可以带 K / M / G 后缀；class_max_free_bytes 为逗号分隔的 大小=字节数，比如 "64=1M,4096=64K"
+        /// 返回值：名称与格式是否正确，不正确时不做任何修改
+        bool set(std::string_view name, std::string_view value);
+
+        /// 从环境变量中读取参数，环境变量的名称为 MEMORY_POOL_ 加上大写的参数名称，比如 MEMORY_POOL_MAX_FREE_BYTES_PER_LIST
+        /// 任何一个环境变量的格式不正确，或者组合起来的参数不合法时，全部使用默认值
+        static memory_pool_config from_environment();
+
+        /// 检查参数是否合法：大小是 8 的倍数并且不超过 MAX_CACHED_UNIT_SIZE，每个空闲链表至少能放下两个内存块
+        bool is_valid() const;
+    };
+
+    // 生效的参数，在第一次使用内存池时确定，之后不再改变
+    // 热路径上直接读取静态变量，与读取常量相比只多一次内存访问
+    class runtime_config {
+    public:
+        /// 设置参数，需要在使用内存池之前调用
+        /// 返回值：是否设置成功，参数不合法或者参数已经生效时返回 false
+        static bool configure(const memory_pool_config& config);
+
+        /// 当前的参数，生效之前是将要使用的参数（默认为环境变量中的参数）
+        static memory_pool_config get();
+
+        /// 使参数生效，只有第一次调用时有效，线程缓存创建时、中心缓存与页缓存第一次申请内存时以及读取之前保存的需求时调用
+        static void freeze() {
+            std::call_once(s_frozen, apply);
+        }
+
+        static size_t max_cached_unit_size() { return s_values.max_cached_unit_size; }
+        static size_t max_free_bytes_per_list() { return s_values.max_free_bytes_per_list; }
+        /// 一个规格的空闲链表上限，参数为规格的下标
+        static size_t max_free_bytes(size_t index) { return s_values.class_max_free_bytes[index]; }
+        static size_t page_allocate_count() { return s_values.page_allocate_count; }
+        static size_t max_page_group_count() { return s_values.max_page_group_count; }
+        static size_t min_batch_count() { return s_values.min_batch_count; }
+
+    private:
+        struct values {
+            size_t max_cached_unit_size = size_utils::MAX_CACHED_UNIT_SIZE;
+            size_t max_free_bytes_per_list = memory_pool_config::DEFAULT_MAX_FREE_BYTES_PER_LIST;
+            size_t page_allocate_count = memory_pool_config::DEFAULT_PAGE_ALLOCATE_COUNT;
+            size_t max_page_group_count = memory_pool_config::DEFAULT_MAX_PAGE_GROUP_COUNT;
+            size_t min_batch_count = memory_pool_config::DEFAULT_MIN_BATCH_COUNT;
+            std::array<size_t, size_utils::CACHE_LINE_SIZE> class_max_free_bytes = {};
+
+            static constexpr values defaults() {
+                values result;
+                result.class_max_free_bytes.fill(memory_pool_config::DEFAULT_MAX_FREE_BYTES_PER_LIST);
+                return result;
+            }
+        };
+
+        /// 把将要使用的参数写入 s_values
+        static void apply();
+
+        static values s_values;
+        static inline std::once_flag s_frozen;
+        static inline std::atomic<bool> s_applied = false;
+    };
+
+    // 在编译期初始化为默认值，参数生效之前读取到的也是默认值
+    inline constinit runtime_config::values runtime_config::s_values = runtime_config::values::defaults();
+
+} // memory_pool_v2
+
+#endif //MEMORY_POOL_CONFIG_H
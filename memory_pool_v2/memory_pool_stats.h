@@ -0,0 +1,87 @@
+//
+// Created by ghost-him on 25-5-6.
+//
+
+#ifndef MEMORY_POOL_STATS_H
+#define MEMORY_POOL_STATS_H
+#include <cstddef>
+#include <vector>
+
+namespace memory_pool_v2 {
+
+    // 一个规格在各层中的统计信息
+    struct size_class_stats {
+        size_t memory_size = 0;
+        // 所有线程缓存中空闲的内存块
+        size_t thread_cache_count = 0;
+        size_t thread_cache_bytes = 0;
+        // 中心缓存中空闲的内存块，包括页面中还没有切分的部分
+        size_t central_cache_count = 0;
+        size_t central_cache_bytes = 0;
+        // 中心缓存为这个规格管理的页面
+        size_t span_count = 0;
+        size_t span_bytes = 0;
+        // 线程缓存向中心缓存批量申请的次数，以及缓存超过上限后批量归还的次数，包括已经退出的线程
+        size_t refill_count = 0;
+        size_t overflow_count = 0;
+        // 中心缓存中这个规格的锁已经被其他线程持有、需要等待的次数
+        size_t lock_contention_count = 0;
+    };
+
+    // 超过 MAX_CACHED_UNIT_SIZE 的大内存块
+    struct large_object_stats {
+        // 缓存在线程缓存与中心缓存中的大内存块
+        size_t thread_cache_count = 0;
+        size_t thread_cache_bytes = 0;
+        size_t central_cache_count = 0;
+        size_t central_cache_bytes = 0;
+        // 从页面中分配的大内存块（包括缓存中的）的总字节数
+        size_t page_bytes = 0;
+        // 单独 mmap 的大内存块
+        size_t direct_mapped_count = 0;
+        size_t direct_mapped_bytes = 0;
+        // 中心缓存中大内存块的锁需要等待的次数
+        size_t lock_contention_count = 0;
+    };
+
+    struct page_cache_stats {
+        // 预留的地址空间，没有预留时为 0
+        size_t reserved_bytes = 0;
+        // 向系统申请的页面的总字节数，不包括单独 mmap 的大内存块
+        size_t mapped_bytes = 0;
+        // 仍然占用物理内存的字节数（申请的字节数 - 已经归还给操作系统的字节数）
+        size_t committed_bytes = 0;
+        // 页缓存中空闲的页面
+        size_t free_bytes = 0;
+        size_t free_span_count = 0;
+        // 空闲页面中已经归还给操作系统的字节数
+        size_t released_bytes = 0;
+        // 累计归还给操作系统以及重新缺页的字节数
+        size_t total_released_bytes = 0;
+        size_t total_refaulted_bytes = 0;
+        // 页面的锁需要等待其他线程的次数
+        size_t lock_contention_count = 0;
+    };
+
+    // 内存池的统计信息快照，各个计数器是分别读取的，并发分配时彼此之间可能有少量的偏差
+    struct memory_pool_stats {
+        // 只包含有数据的规格，按大小排序
+        std::vector<size_class_stats> size_classes;
+        // 当前存活的线程缓存的个数
+        size_t thread_count = 0;
+        // 所有规格的合计
+        size_t thread_cache_bytes = 0;
+        size_t central_cache_bytes = 0;
+        size_t span_count = 0;
+        size_t span_bytes = 0;
+        size_t refill_count = 0;
+        size_t overflow_count = 0;
+        size_t lock_contention_count = 0;
+
+        large_object_stats large;
+        page_cache_stats pages;
+    };
+
+} // memory_pool_v2
+
+#endif //MEMORY_POOL_STATS_H
@@ -4,37 +4,57 @@
 
 #include "page_cache.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <mutex>
 #include <bits/ostream.tcc>
 #include <sys/mman.h>
 
+#include "instrumentation.h"
+
 namespace memory_pool_v2 {
     std::optional<memory_span> page_cache::allocate_page(size_t page_count) {
         if (page_count == 0) {
             return std::nullopt;
         }
-        std::unique_lock<std::mutex> guard(m_mutex);
+        MEMORY_POOL_INSTRUMENT(page_cache_allocate_page, page_count * size_utils::PAGE_SIZE);
+        runtime_config::freeze();
+        std::unique_lock<std::mutex> guard = lock_pages();
 
         auto it = free_page_store.lower_bound(page_count);
         while (it != free_page_store.end()) {
             if (!it->second.empty()) {
                 // 如果存在一个页面，这个页面的大小是大于或等于要分配的页面的
-                auto mem_iter = it->second.begin();
-                memory_span free_memory = *mem_iter;
-                it->second.erase(mem_iter);
-                free_page_map.erase(free_memory.data());
+                auto map_iter = free_page_map.find(it->second.begin()->data());
+                assert(map_iter != free_page_map.end());
+                free_span_info free_info = map_iter->second;
+                erase_free_span(map_iter);
 
                 // 开始分割获取出来的空闲的空间
                 size_t memory_to_use = page_count * size_utils::PAGE_SIZE;
-                memory_span memory = free_memory.subspan(0, memory_to_use);
-                free_memory = free_memory.subspan(memory_to_use);
-                if (free_memory.size()) {
-                    // 如果还有空间，则插回到缓存中
-                    free_page_store[free_memory.size() / size_utils::PAGE_SIZE].emplace(free_memory);
-                    free_page_map.emplace(free_memory.data(), free_memory);
+                size_t offset = choose_split_offset(free_info.memory, memory_to_use);
+                memory_span memory = free_info.memory.subspan(offset, memory_to_use);
+                // 已经归还给系统的页面不知道具体在哪个位置，按比例估算这次分配出去的页面中有多少需要重新缺页
+                const size_t total_page_count = free_info.memory.size() / size_utils::PAGE_SIZE;
+                size_t released_page_count = free_info.released_size / size_utils::PAGE_SIZE;
+                const size_t refaulted_page_count = released_page_count * page_count / total_page_count;
+                m_total_refaulted_bytes.fetch_add(refaulted_page_count * size_utils::PAGE_SIZE, std::memory_order_relaxed);
+                released_page_count -= refaulted_page_count;
+
+                // 如果前后还有空间，则插回到缓存中，剩下的已归还的页面也按比例分给前后两段
+                memory_span before = free_info.memory.subspan(0, offset);
+                memory_span after = free_info.memory.subspan(offset + memory_to_use);
+                const size_t rest_page_count = total_page_count - page_count;
+                const size_t before_released_page_count = rest_page_count == 0 ? 0 :
+                    released_page_count * (before.size() / size_utils::PAGE_SIZE) / rest_page_count;
+                if (before.size()) {
+                    insert_free_span({before, free_info.free_time, before_released_page_count * size_utils::PAGE_SIZE});
+                }
+                if (after.size()) {
+                    insert_free_span({after, free_info.free_time, (released_page_count - before_released_page_count) * size_utils::PAGE_SIZE});
                 }
 
                 return memory;
@@ -43,17 +63,14 @@ namespace memory_pool_v2 {
         }
         // 如果已经没有足够大的页面了，则向系统申请
         // 一次性分配8MB的大小，为2048个页面，而批量申请的全都取最大是4mb，-> 16KB(缓存最大大小) * 512(一次性管理最大个数) = 4MB
-        size_t page_to_allocate = std::max(PAGE_ALLOCATE_COUNT, page_count);
+        size_t page_to_allocate = std::max(runtime_config::page_allocate_count(), page_count);
         return system_allocate_memory(page_to_allocate).transform([this, page_count](memory_span memory) {
-            // 存入总的内存，用于结尾回收内存
-            page_vector.push_back(memory);
+            m_mapped_bytes.fetch_add(memory.size(), std::memory_order_relaxed);
             size_t memory_to_use = page_count * size_utils::PAGE_SIZE;
             memory_span result = memory.subspan(0, memory_to_use);
             memory_span free_memory = memory.subspan(memory_to_use);
             if (free_memory.size()) {
-                size_t index = free_memory.size() / size_utils::PAGE_SIZE;
-                free_page_store[index].emplace(free_memory);
-                free_page_map.emplace(free_memory.data(), free_memory);
+                insert_free_span({free_memory, std::chrono::steady_clock::now(), 0});
             }
             return result;
         });
@@ -63,22 +80,28 @@ namespace memory_pool_v2 {
 
         // 应该是一页一页的回收的，所以大小一定是会被整除的
         assert(page.size() % size_utils::PAGE_SIZE == 0);
-        std::unique_lock<std::mutex> guard(m_mutex);
+        std::unique_lock<std::mutex> guard = lock_pages();
+        merge_free_span({page, std::chrono::steady_clock::now(), 0});
+    }
+
+    void page_cache::merge_free_span(free_span_info page_info) {
+        // 合并后的空闲页的空闲时间以最近的一次回收为准
         while (!free_page_map.empty()) {
             // 只有在集合不空的时候才会考虑合并
             // 这个空间不应该已经被包含了
-            assert(!free_page_map.contains(page.data()));
-            auto it = free_page_map.upper_bound(page.data());
+            assert(!free_page_map.contains(page_info.memory.data()));
+            auto it = free_page_map.upper_bound(page_info.memory.data());
             if (it != free_page_map.begin()) {
                 // 检查前一个span
                 -- it;
-                const memory_span& memory = it->second;
-                if (memory.data() + memory.size() == page.data()) {
+                const memory_span& memory = it->second.memory;
+                if (memory.data() + memory.size() == page_info.memory.data()) {
                     // 如果前面一段的空间与当前的相邻，则合并
-                    page = memory_span(memory.data(), memory.size() + page.size());
+                    page_info.memory = memory_span(memory.data(), memory.size() + page_info.memory.size());
+                    page_info.released_size += it->second.released_size;
+                    page_info.free_time = std::max(page_info.free_time, it->second.free_time);
                     // 在储存库中也删除
-                    free_page_store[memory.size() / size_utils::PAGE_SIZE].erase(memory);
-                    free_page_map.erase(it);
+                    erase_free_span(it);
                 } else {
                     break;
                 }
@@ -89,32 +112,311 @@ namespace memory_pool_v2 {
 
         // 检查后面相邻的span
         while (!free_page_map.empty()) {
-            assert(!free_page_map.contains(page.data()));
-            if (free_page_map.contains(page.data() + page.size())) {
-                auto it = free_page_map.find(page.data() + page.size());
-                memory_span next_memory = it->second;
-                free_page_store[next_memory.size() / size_utils::PAGE_SIZE].erase(next_memory);
-                free_page_map.erase(it);
-                page = memory_span(page.data(), page.size() + next_memory.size());
+            assert(!free_page_map.contains(page_info.memory.data()));
+            auto it = free_page_map.find(page_info.memory.data() + page_info.memory.size());
+            if (it != free_page_map.end()) {
+                page_info.memory = memory_span(page_info.memory.data(), page_info.memory.size() + it->second.memory.size());
+                page_info.released_size += it->second.released_size;
+                page_info.free_time = std::max(page_info.free_time, it->second.free_time);
+                erase_free_span(it);
             } else {
                 break;
             }
         }
-        size_t index = page.size() / size_utils::PAGE_SIZE;
-        free_page_store[index].emplace(page);
-        free_page_map.emplace(page.data(), page);
+        insert_free_span(page_info);
+    }
+
+    size_t page_cache::release_idle_pages(std::chrono::steady_clock::duration idle_threshold, size_t max_bytes) {
+        // 要归还的空闲页，以及这一次 madvise 的范围
+        struct release_task {
+            free_span_info info;
+            memory_span range;
+            size_t release_size;
+        };
+        std::vector<release_task> tasks;
+        // 大页模式下只归还完整的大页，避免把大页拆散
+        const size_t granularity = huge_page_mode() ? HUGE_PAGE_SIZE : size_utils::PAGE_SIZE;
+        {
+            // 加锁时只挑选要归还的空闲页并从缓存中取出，madvise 时不持有锁，申请与归还页面的线程不需要等待系统调用
+            std::unique_lock<std::mutex> guard(m_mutex);
+            if (m_stop) {
+                return 0;
+            }
+            const auto now = std::chrono::steady_clock::now();
+            size_t planned = 0;
+            for (auto it = free_page_map.begin(); it != free_page_map.end() && planned < max_bytes;) {
+                const free_span_info& info = it->second;
+                // 空闲的时间还不够长
+                if (now - info.free_time < idle_threshold) {
+                    ++ it;
+                    continue;
+                }
+                // 可以归还的部分已经全部归还了
+                const memory_span range = releasable_range(info.memory);
+                if (info.released_size >= range.size()) {
+                    ++ it;
+                    continue;
+                }
+                // 不知道之前归还的是哪一部分，所以从头开始归还，已经归还过的页面再次 madvise 不会有副作用
+                size_t release_size = std::min(range.size(), info.released_size + (max_bytes - planned));
+                release_size = release_size / granularity * granularity;
+                if (release_size <= info.released_size) {
+                    ++ it;
+                    continue;
+                }
+                planned += release_size - info.released_size;
+                tasks.push_back({info, range, release_size});
+                erase_free_span(it++);
+            }
+        }
+        if (tasks.empty()) {
+            return 0;
+        }
+
+        size_t released = 0;
+        for (auto& task : tasks) {
+            MEMORY_POOL_INSTRUMENT(system_madvise, task.release_size);
+            if (madvise(task.range.data(), task.release_size, MADV_DONTNEED) != 0) {
+                continue;
+            }
+            released += task.release_size - task.info.released_size;
+            task.info.released_size = task.release_size;
+        }
+
+        // 放回缓存中，取出期间相邻的页面可能已经被归还了，所以需要合并；已经归还的字节数随着插入一起更新
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            if (!m_stop) {
+                for (const auto& task : tasks) {
+                    merge_free_span(task.info);
+                }
+            }
+        }
+        m_total_released_bytes.fetch_add(released, std::memory_order_relaxed);
+        return released;
+    }
+
+    size_t page_cache::choose_split_offset(memory_span free_memory, size_t memory_to_use) const {
+        if (!huge_page_mode() || memory_to_use >= HUGE_PAGE_SIZE) {
+            return 0;
+        }
+        const auto begin = reinterpret_cast<uintptr_t>(free_memory.data());
+        const auto end = begin + free_memory.size();
+        // 开头所在的大页中空闲的部分
+        const size_t head_size = size_utils::align(begin, HUGE_PAGE_SIZE) - begin;
+        // 结尾所在的大页中空闲的部分
+        const size_t tail_size = end & (HUGE_PAGE_SIZE - 1);
+        if (memory_to_use <= head_size) {
+            return 0;
+        }
+        if (memory_to_use <= tail_size) {
+            return free_memory.size() - memory_to_use;
+        }
+        return 0;
+    }
+
+    memory_span page_cache::releasable_range(memory_span free_memory) const {
+        if (!huge_page_mode()) {
+            return free_memory;
+        }
+        const auto begin = size_utils::align(reinterpret_cast<uintptr_t>(free_memory.data()), HUGE_PAGE_SIZE);
+        const auto end = (reinterpret_cast<uintptr_t>(free_memory.data()) + free_memory.size()) & ~(HUGE_PAGE_SIZE - 1);
+        if (begin >= end) {
+            return memory_span {free_memory.data(), 0};
+        }
+        return memory_span {reinterpret_cast<std::byte*>(begin), end - begin};
+    }
+
+    void page_cache::insert_free_span(const free_span_info& info) {
+        size_t index = info.memory.size() / size_utils::PAGE_SIZE;
+        free_page_store[index].emplace(info.memory);
+        free_page_map.emplace(info.memory.data(), info);
+        m_released_bytes.fetch_add(info.released_size, std::memory_order_relaxed);
+        m_free_bytes.fetch_add(info.memory.size(), std::memory_order_relaxed);
+        m_free_span_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void page_cache::erase_free_span(std::map<std::byte*, free_span_info>::iterator it) {
+        const memory_span memory = it->second.memory;
+        auto store_it = free_page_store.find(memory.size() / size_utils::PAGE_SIZE);
+        store_it->second.erase(memory);
+        // 不保留空的集合，否则分配时要跳过大量空的集合
+        if (store_it->second.empty()) {
+            free_page_store.erase(store_it);
+        }
+        m_released_bytes.fetch_sub(it->second.released_size, std::memory_order_relaxed);
+        m_free_bytes.fetch_sub(memory.size(), std::memory_order_relaxed);
+        m_free_span_count.fetch_sub(1, std::memory_order_relaxed);
+        free_page_map.erase(it);
     }
 
     std::optional<memory_span> page_cache::allocate_unit(size_t memory_size) {
-        auto ret = malloc(memory_size);
-        if (ret != nullptr) {
-            return memory_span { static_cast<std::byte*>(ret), memory_size};
+        const size_t size = size_utils::align(memory_size, size_utils::PAGE_SIZE);
+        if (size <= direct_map_threshold()) {
+            auto result = allocate_page(size / size_utils::PAGE_SIZE);
+            if (result.has_value()) {
+                m_large_page_bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+            return result;
         }
-        return std::nullopt;
+        // 超大内存块单独向系统申请，回收时直接归还，不会在页缓存中留下碎片
+        MEMORY_POOL_INSTRUMENT(system_mmap, size);
+        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return std::nullopt;
+        }
+        {
+            std::unique_lock<std::mutex> guard(m_direct_map_mutex);
+            m_direct_map_regions.emplace(static_cast<std::byte*>(ptr), size);
+        }
+        m_direct_mapped_bytes.fetch_add(size, std::memory_order_relaxed);
+        m_direct_mapped_count.fetch_add(1, std::memory_order_relaxed);
+        return memory_span { static_cast<std::byte*>(ptr), size};
     }
 
     void page_cache::deallocate_unit(memory_span memories) {
-        free(memories.data());
+        const size_t size = size_utils::align(memories.size(), size_utils::PAGE_SIZE);
+        // 阈值可能已经被修改过了，所以以记录为准
+        if (m_direct_mapped_bytes.load(std::memory_order_relaxed) > 0) {
+            std::unique_lock<std::mutex> guard(m_direct_map_mutex);
+            auto it = m_direct_map_regions.find(memories.data());
+            if (it != m_direct_map_regions.end()) {
+                assert(it->second == size);
+                m_direct_map_regions.erase(it);
+                guard.unlock();
+                MEMORY_POOL_INSTRUMENT(system_munmap, size);
+                munmap(memories.data(), size);
+                m_direct_mapped_bytes.fetch_sub(size, std::memory_order_relaxed);
+                m_direct_mapped_count.fetch_sub(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        m_large_page_bytes.fetch_sub(size, std::memory_order_relaxed);
+        deallocate_page(memory_span {memories.data(), size});
+    }
+
+    std::optional<memory_span> page_cache::reallocate_unit(memory_span memories, size_t new_size) {
+        new_size = size_utils::align(new_size, size_utils::PAGE_SIZE);
+        if (new_size <= direct_map_threshold()) {
+            return std::nullopt;
+        }
+        std::unique_lock<std::mutex> guard(m_direct_map_mutex);
+        auto it = m_direct_map_regions.find(memories.data());
+        if (it == m_direct_map_regions.end()) {
+            return std::nullopt;
+        }
+        const size_t old_size = it->second;
+        if (old_size == new_size) {
+            return memory_span {memories.data(), old_size};
+        }
+        // 内核直接移动页表，不复制数据
+        MEMORY_POOL_INSTRUMENT(system_mremap, new_size);
+        void* ptr = mremap(memories.data(), old_size, new_size, MREMAP_MAYMOVE);
+        if (ptr == MAP_FAILED) {
+            return std::nullopt;
+        }
+        m_direct_map_regions.erase(it);
+        m_direct_map_regions.emplace(static_cast<std::byte*>(ptr), new_size);
+        if (new_size > old_size) {
+            m_direct_mapped_bytes.fetch_add(new_size - old_size, std::memory_order_relaxed);
+        } else {
+            m_direct_mapped_bytes.fetch_sub(old_size - new_size, std::memory_order_relaxed);
+        }
+        return memory_span {static_cast<std::byte*>(ptr), new_size};
+    }
+
+    std::unique_lock<std::mutex> page_cache::lock_pages() {
+        std::unique_lock<std::mutex> guard(m_mutex, std::try_to_lock);
+        if (!guard.owns_lock()) {
+            m_lock_contention_count.fetch_add(1, std::memory_order_relaxed);
+            guard.lock();
+        }
+        return guard;
+    }
+
+    page_cache_stats page_cache::get_stats() const {
+        page_cache_stats result;
+        result.reserved_bytes = m_reserved_end.load(std::memory_order_relaxed) - m_reserved_begin.load(std::memory_order_relaxed);
+        result.mapped_bytes = mapped_bytes();
+        result.released_bytes = released_bytes();
+        // 两个计数器是分别读取的，并发时可能短暂地不一致
+        result.committed_bytes = result.mapped_bytes - std::min(result.mapped_bytes, result.released_bytes);
+        result.free_bytes = m_free_bytes.load(std::memory_order_relaxed);
+        result.free_span_count = m_free_span_count.load(std::memory_order_relaxed);
+        result.total_released_bytes = total_released_bytes();
+        result.total_refaulted_bytes = total_refaulted_bytes();
+        result.lock_contention_count = lock_contention_count();
+        return result;
+    }
+
+    bool page_cache::reserve_address_space(size_t size) {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        // 已经申请过页面时，之前的页面不在预留的范围内，无法再保证所有的页面都是连续的
+        if (m_stop || m_reserved_begin.load(std::memory_order_relaxed) != nullptr || !page_vector.empty()) {
+            return false;
+        }
+        size = size_utils::align(size, HUGE_PAGE_SIZE);
+        if (size == 0) {
+            return false;
+        }
+        // 多预留一个大页的空间，使起始地址按大页对齐，这样大页模式下提交的每一段都是对齐的
+        const size_t map_size = size + HUGE_PAGE_SIZE;
+        void* ptr = mmap(nullptr, map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (ptr == MAP_FAILED) {
+            return false;
+        }
+        auto map_begin = static_cast<std::byte*>(ptr);
+        auto aligned_begin = reinterpret_cast<std::byte*>(size_utils::align(reinterpret_cast<uintptr_t>(ptr), HUGE_PAGE_SIZE));
+        const size_t head_size = aligned_begin - map_begin;
+        const size_t tail_size = map_size - head_size - size;
+        if (head_size) {
+            munmap(map_begin, head_size);
+        }
+        if (tail_size) {
+            munmap(aligned_begin + size, tail_size);
+        }
+
+        // 页面映射同样只预留，只有被写入的部分才会占用物理内存
+        const size_t page_map_size = size / size_utils::PAGE_SIZE * sizeof(void*);
+        void* page_map = mmap(nullptr, page_map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (page_map == MAP_FAILED) {
+            munmap(aligned_begin, size);
+            return false;
+        }
+
+        m_committed_end = aligned_begin;
+        m_reserved_end.store(aligned_begin + size, std::memory_order_relaxed);
+        m_reserved_begin.store(aligned_begin, std::memory_order_relaxed);
+        m_page_map.store(static_cast<void**>(page_map), std::memory_order_release);
+        return true;
+    }
+
+    bool page_cache::owns(const void* ptr) {
+        const auto address = static_cast<const std::byte*>(ptr);
+        if (address >= m_reserved_begin.load(std::memory_order_relaxed) && address < m_reserved_end.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        std::unique_lock<std::mutex> guard(m_mutex);
+        for (auto& memory : page_vector) {
+            if (address >= memory.data() && address < memory.data() + memory.size()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void page_cache::set_page_owner(memory_span pages, void* owner) {
+        void** page_map = m_page_map.load(std::memory_order_relaxed);
+        if (page_map == nullptr) {
+            return;
+        }
+        const std::byte* begin = m_reserved_begin.load(std::memory_order_relaxed);
+        if (pages.data() < begin || pages.data() >= m_reserved_end.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const size_t first = (pages.data() - begin) / size_utils::PAGE_SIZE;
+        const size_t count = size_utils::align(pages.size(), size_utils::PAGE_SIZE) / size_utils::PAGE_SIZE;
+        std::fill_n(page_map + first, count, owner);
     }
 
     void page_cache::stop() {
@@ -124,6 +426,15 @@ namespace memory_pool_v2 {
             for (auto& i : page_vector) {
                 system_deallocate_memory(i);
             }
+            std::byte* reserved_begin = m_reserved_begin.load(std::memory_order_relaxed);
+            if (reserved_begin != nullptr) {
+                const size_t reserved_size = m_reserved_end.load(std::memory_order_relaxed) - reserved_begin;
+                void** page_map = m_page_map.exchange(nullptr, std::memory_order_relaxed);
+                m_reserved_begin.store(nullptr, std::memory_order_relaxed);
+                m_reserved_end.store(nullptr, std::memory_order_relaxed);
+                munmap(reserved_begin, reserved_size);
+                munmap(page_map, reserved_size / size_utils::PAGE_SIZE * sizeof(void*));
+            }
         }
     }
 
@@ -132,19 +443,95 @@ namespace memory_pool_v2 {
     }
 
     std::optional<memory_span> page_cache::system_allocate_memory(size_t page_count) {
-        const size_t size = page_count * size_utils::PAGE_SIZE;
+        MEMORY_POOL_INSTRUMENT(page_cache_system_allocate, page_count * size_utils::PAGE_SIZE);
+        const page_provision_policy policy = m_provision_policy.load(std::memory_order_relaxed);
+        const bool huge_page = huge_page_mode();
+        size_t size = page_count * size_utils::PAGE_SIZE;
+        // 大页模式下按大页对齐，多映射一个大页的空间用于对齐起始地址
+        size_t map_size = size;
+        if (huge_page) {
+            size = size_utils::align(size, HUGE_PAGE_SIZE);
+            map_size = size + HUGE_PAGE_SIZE;
+        }
 
-        // 使用mmap分配内存
-        void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
-                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-        if (ptr == MAP_FAILED) return std::nullopt;
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        // 大页模式下要先标记 MADV_HUGEPAGE 再缺页，否则预先分配的都是普通页面
+        if (!huge_page && (policy == page_provision_policy::populate || policy == page_provision_policy::locked)) {
+            flags |= MAP_POPULATE;
+        } else if (policy == page_provision_policy::no_reserve) {
+            flags |= MAP_NORESERVE;
+        }
 
-        // 清零内存
-        memset(ptr, 0, size);
+        // 优先从预留的地址空间中提交，使用 MAP_FIXED 覆盖预留的部分，这样提交的页面仍然可以使用各种准备策略
+        void* ptr = MAP_FAILED;
+        if (std::byte* reserved = commit_reserved_memory(size); reserved != nullptr) {
+            MEMORY_POOL_INSTRUMENT(system_mmap, size);
+            ptr = mmap(reserved, size, PROT_READ | PROT_WRITE, flags | MAP_FIXED, -1, 0);
+        }
+
+        if (ptr == MAP_FAILED) {
+            // 预留的空间用完了，单独向系统申请
+            MEMORY_POOL_INSTRUMENT(system_mmap, map_size);
+            ptr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+            if (ptr == MAP_FAILED) return std::nullopt;
+
+            if (huge_page) {
+                // 裁掉对齐后前后多余的部分
+                auto map_begin = static_cast<std::byte*>(ptr);
+                auto aligned_begin = reinterpret_cast<std::byte*>(size_utils::align(reinterpret_cast<uintptr_t>(ptr), HUGE_PAGE_SIZE));
+                const size_t head_size = aligned_begin - map_begin;
+                const size_t tail_size = map_size - head_size - size;
+                if (head_size) {
+                    MEMORY_POOL_INSTRUMENT(system_munmap, head_size);
+                    munmap(map_begin, head_size);
+                }
+                if (tail_size) {
+                    MEMORY_POOL_INSTRUMENT(system_munmap, tail_size);
+                    munmap(aligned_begin + size, tail_size);
+                }
+                ptr = aligned_begin;
+            }
+            // 存入总的内存，用于结尾回收内存，预留空间中的页面在结尾时整体回收
+            page_vector.push_back(memory_span{static_cast<std::byte*>(ptr), size});
+        }
+
+        if (huge_page) {
+            MEMORY_POOL_INSTRUMENT(system_madvise, size);
+            madvise(ptr, size, MADV_HUGEPAGE);
+        }
+
+        if (policy == page_provision_policy::zero_fill || (huge_page && (policy == page_provision_policy::populate || policy == page_provision_policy::locked))) {
+            // 匿名映射的页面本身就是全零的，这里清零只是为了提前触发缺页
+            memset(ptr, 0, size);
+        }
+        if (policy == page_provision_policy::locked) {
+            // 锁定失败时页面已经准备好了，仍然可以使用
+            if (mlock(ptr, size) != 0) {
+                m_mlock_failed_bytes.fetch_add(size, std::memory_order_relaxed);
+            }
+        }
         return memory_span{static_cast<std::byte*>(ptr), size};
     }
 
     void page_cache::system_deallocate_memory(memory_span page) {
+        MEMORY_POOL_INSTRUMENT(system_munmap, page.size());
         munmap(page.data(), page.size());
     }
+
+    std::byte* page_cache::commit_reserved_memory(size_t size) {
+        std::byte* begin = m_reserved_begin.load(std::memory_order_relaxed);
+        if (begin == nullptr) {
+            return nullptr;
+        }
+        std::byte* commit_begin = m_committed_end;
+        if (huge_page_mode()) {
+            // 中途开启大页模式时，跳过前面不完整的大页
+            commit_begin = reinterpret_cast<std::byte*>(size_utils::align(reinterpret_cast<uintptr_t>(commit_begin), HUGE_PAGE_SIZE));
+        }
+        if (static_cast<size_t>(m_reserved_end.load(std::memory_order_relaxed) - commit_begin) < size) {
+            return nullptr;
+        }
+        m_committed_end = commit_begin + size;
+        return commit_begin;
+    }
 } // memory_pool
\ No newline at end of file
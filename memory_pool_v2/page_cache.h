@@ -5,20 +5,43 @@
 #ifndef PAGE_CACHE_H
 #define PAGE_CACHE_H
 #include <atomic>
+#include <chrono>
 #include <cstddef>
 #include <map>
+#include <mutex>
 #include <span>
 #include <optional>
 #include <set>
 #include <vector>
 
+#include "memory_pool_config.h"
+#include "memory_pool_stats.h"
 #include "utils.h"
 
 namespace memory_pool_v2 {
 
+// 向系统申请页面时的准备策略
+enum class page_provision_policy {
+    // 不做任何处理，依赖匿名映射的页面本身就是全零的，第一次访问时才会缺页
+    lazy,
+    // 申请后用 memset 清零，相当于逐页触发缺页
+    zero_fill,
+    // 使用 MAP_POPULATE 让内核在 mmap 时就预先分配好物理页
+    populate,
+    // 预先分配物理页并使用 mlock 锁定，避免被换出，适合对延迟敏感的线程
+    locked,
+    // 使用 MAP_NORESERVE，不预留交换空间
+    no_reserve,
+};
+
 class page_cache {
 public:
-    static constexpr size_t PAGE_ALLOCATE_COUNT = 2048;
+    // 一次向系统申请的页数的默认值，实际使用的值见 runtime_config::page_allocate_count()
+    static constexpr size_t PAGE_ALLOCATE_COUNT = memory_pool_config::DEFAULT_PAGE_ALLOCATE_COUNT;
+    // 透明大页的大小
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+    // 默认超过这个大小的大内存块单独 mmap，不从页面中分配
+    static constexpr size_t DEFAULT_DIRECT_MAP_THRESHOLD = 4 * 1024 * 1024;
     static page_cache& get_instance() {
         static page_cache instance;
         return instance;
@@ -31,11 +54,86 @@ public:
     /// 回收指定页数的内存
     void deallocate_page(memory_span page);
 
-    /// 分配一个单元的内存，用于处理超大块内存
+    /// 分配一个单元的内存，用于处理超过 MAX_CACHED_UNIT_SIZE 的大内存块
+    /// 大小按页对齐，不超过 direct_map_threshold 的从页面中分配，超过的单独 mmap 并记录下来
     std::optional<memory_span> allocate_unit(size_t memory_size);
-    /// 回收一个单元的内存，用于回收超大块内存
+    /// 回收一个单元的内存，大小需要与申请时相同，单独 mmap 的内存块直接 munmap
     void deallocate_unit(memory_span memories);
 
+    /// 调整一个单独 mmap 的内存块的大小，使用 mremap，不需要复制数据，地址可能会改变
+    /// 参数：memories: 原来的内存块，new_size: 新的大小，需要超过 direct_map_threshold
+    /// 返回值：调整后的内存块，原来的内存块不是单独 mmap 的、新的大小没有超过阈值或者 mremap 失败时返回 nullopt，此时原来的内存块不变
+    std::optional<memory_span> reallocate_unit(memory_span memories, size_t new_size);
+
+    /// 设置单独 mmap 的阈值，只影响之后的分配，已经分配出去的内存块在回收时仍然能被正确处理
+    void set_direct_map_threshold(size_t threshold) { m_direct_map_threshold.store(threshold, std::memory_order_relaxed); }
+    size_t direct_map_threshold() const { return m_direct_map_threshold.load(std::memory_order_relaxed); }
+
+    /// 将空闲时间超过阈值的空闲页归还给操作系统（madvise），页面本身仍然由页缓存管理，再次使用时由内核重新分配物理页
+    /// 参数：idle_threshold: 空闲页最少需要空闲多久才会被归还，max_bytes: 本次最多归还的字节数
+    /// 返回值：本次实际归还的字节数
+    size_t release_idle_pages(std::chrono::steady_clock::duration idle_threshold, size_t max_bytes);
+
+    /// 向系统申请的总字节数
+    size_t mapped_bytes() const { return m_mapped_bytes.load(std::memory_order_relaxed); }
+    /// 当前单独 mmap 的内存块的总字节数
+    size_t direct_mapped_bytes() const { return m_direct_mapped_bytes.load(std::memory_order_relaxed); }
+    /// 当前空闲页中已经归还给操作系统的字节数
+    size_t released_bytes() const { return m_released_bytes.load(std::memory_order_relaxed); }
+    /// 累计归还给操作系统的字节数
+    size_t total_released_bytes() const { return m_total_released_bytes.load(std::memory_order_relaxed); }
+    /// 累计重新缺页的字节数（已归还的页面被再次分配出去，估算值）
+    size_t total_refaulted_bytes() const { return m_total_refaulted_bytes.load(std::memory_order_relaxed); }
+
+    /// 页缓存的统计信息，只读取计数器，不需要加锁
+    page_cache_stats get_stats() const;
+    /// 页面的锁已经被其他线程持有、需要等待的次数
+    size_t lock_contention_count() const { return m_lock_contention_count.load(std::memory_order_relaxed); }
+    /// 从页面中分配出去的大内存块的总字节数
+    size_t large_page_bytes() const { return m_large_page_bytes.load(std::memory_order_relaxed); }
+    /// 当前单独 mmap 的内存块的个数
+    size_t direct_mapped_count() const { return m_direct_mapped_count.load(std::memory_order_relaxed); }
+
+    /// 设置向系统申请页面时的准备策略，只对之后新申请的页面生效，应该在程序启动时设置
+    void set_provision_policy(page_provision_policy policy) { m_provision_policy.store(policy, std::memory_order_relaxed); }
+    page_provision_policy provision_policy() const { return m_provision_policy.load(std::memory_order_relaxed); }
+
+    /// 设置是否开启大页感知模式，只对之后新申请的页面生效，应该在程序启动时设置
+    /// 开启后向系统申请的内存按 2MB 对齐并标记 MADV_HUGEPAGE，切分时优先使用不完整的大页，归还时只归还完整的大页
+    void set_huge_page_mode(bool enable) { m_huge_page_mode.store(enable, std::memory_order_relaxed); }
+    bool huge_page_mode() const { return m_huge_page_mode.load(std::memory_order_relaxed); }
+
+    /// 预留一段连续的虚拟地址空间（PROT_NONE + MAP_NORESERVE，不占用物理内存），之后的页面都从这段空间中按需提交
+    /// 必须在第一次申请页面之前调用，预留的空间用完以后会退回到单独 mmap 的方式
+    /// 参数：size: 预留的字节数，比如 64GB
+    /// 返回值：是否预留成功，已经申请过页面或者已经预留过时返回 false
+    bool reserve_address_space(size_t size);
+
+    /// 判断一个指针是不是由页缓存管理的页面中的
+    /// 预留地址空间时只需要判断是否在预留的范围内，否则需要查找所有向系统申请的内存
+    bool owns(const void* ptr);
+
+    /// 记录一段页面的所有者，只在预留地址空间时有效，这时页面映射是一个以页号为下标的数组
+    /// 参数：pages: 页面，owner: 所有者，传入 nullptr 表示清除
+    void set_page_owner(memory_span pages, void* owner);
+
+    /// 查找一个指针所在页面的所有者，没有预留地址空间或者没有记录时返回 nullptr
+    void* page_owner(const void* ptr) const {
+        void** page_map = m_page_map.load(std::memory_order_relaxed);
+        if (page_map == nullptr) {
+            return nullptr;
+        }
+        const auto address = static_cast<const std::byte*>(ptr);
+        const std::byte* begin = m_reserved_begin.load(std::memory_order_relaxed);
+        if (address < begin || address >= m_reserved_end.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return page_map[(address - begin) / size_utils::PAGE_SIZE];
+    }
+
+    /// mlock 失败的字节数（通常是超过了 RLIMIT_MEMLOCK），失败时页面仍然可以正常使用，只是没有被锁定
+    size_t mlock_failed_bytes() const { return m_mlock_failed_bytes.load(std::memory_order_relaxed); }
+
     /// 关闭内存池
     void stop();
 
@@ -48,15 +146,74 @@ private:
     /// 回收内存，只有在析构函数中调用
     void system_deallocate_memory(memory_span page);
 
+    /// 从预留的地址空间中提交一段内存，预留的空间不够时返回 nullptr
+    std::byte* commit_reserved_memory(size_t size);
+
+    // 空闲页的信息
+    struct free_span_info {
+        memory_span memory;
+        // 变为空闲的时间，合并时取最近的时间
+        std::chrono::steady_clock::time_point free_time;
+        // 这一段空间中已经归还给操作系统的字节数
+        size_t released_size = 0;
+    };
+
+    /// 将一段空闲页插入到缓存中
+    void insert_free_span(const free_span_info& info);
+
+    /// 将一段空闲页与前后相邻的空闲页合并以后插入到缓存中，需要持有锁
+    void merge_free_span(free_span_info info);
+
+    /// 将一段空闲页从缓存中移除
+    void erase_free_span(std::map<std::byte*, free_span_info>::iterator it);
+
+    /// 加页面的锁，锁已经被其他线程持有时计数一次
+    std::unique_lock<std::mutex> lock_pages();
+
+    /// 计算从空闲页中切分出指定大小的空间时的起始偏移
+    /// 大页模式下优先从两端不完整的大页中切分，尽量保留中间完整的大页
+    size_t choose_split_offset(memory_span free_memory, size_t memory_to_use) const;
+
+    /// 计算一段空闲页中可以归还给操作系统的范围，大页模式下只包含完整的大页
+    memory_span releasable_range(memory_span free_memory) const;
+
     page_cache() = default;
     std::map<size_t, std::set<memory_span>> free_page_store = {};
-    std::map<std::byte*, memory_span> free_page_map = {};
+    std::map<std::byte*, free_span_info> free_page_map = {};
     // 用于回收时 munmap
     std::vector<memory_span> page_vector = {};
     // 表示当前的内存池是不是已经关闭了
     bool m_stop = false;
+    // 预留的地址空间，以及已经提交到的位置
+    std::atomic<std::byte*> m_reserved_begin = nullptr;
+    std::atomic<std::byte*> m_reserved_end = nullptr;
+    std::byte* m_committed_end = nullptr;
+    // 页面映射，预留地址空间时每一页对应一个元素
+    std::atomic<void**> m_page_map = nullptr;
+    // 页面的准备策略
+    std::atomic<page_provision_policy> m_provision_policy = page_provision_policy::lazy;
+    // 是否开启大页感知模式
+    std::atomic<bool> m_huge_page_mode = false;
     // 并发控制
     std::mutex m_mutex;
+    std::atomic<size_t> m_lock_contention_count = 0;
+
+    // 单独 mmap 的内存块，起始地址 -> 大小，使用单独的锁，不影响页面的分配
+    std::map<std::byte*, size_t> m_direct_map_regions = {};
+    std::mutex m_direct_map_mutex;
+    std::atomic<size_t> m_direct_map_threshold = DEFAULT_DIRECT_MAP_THRESHOLD;
+
+    // 统计信息，只在持有锁的时候修改，可以不加锁读取
+    std::atomic<size_t> m_mapped_bytes = 0;
+    std::atomic<size_t> m_released_bytes = 0;
+    std::atomic<size_t> m_total_released_bytes = 0;
+    std::atomic<size_t> m_total_refaulted_bytes = 0;
+    std::atomic<size_t> m_mlock_failed_bytes = 0;
+    std::atomic<size_t> m_direct_mapped_bytes = 0;
+    std::atomic<size_t> m_direct_mapped_count = 0;
+    std::atomic<size_t> m_large_page_bytes = 0;
+    std::atomic<size_t> m_free_bytes = 0;
+    std::atomic<size_t> m_free_span_count = 0;
 };
 
 } // memory_pool
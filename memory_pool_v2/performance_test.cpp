@@ -10,26 +10,110 @@
 #include <mutex>             // 用于互斥锁 (std::mutex)
 #include <algorithm>         // 用于 std::sort, std::min 等算法
 #include <iomanip>           // 用于格式化输出 (setw, setprecision, fixed)
-#include <list>              // 使用 std::list 方便随机移除元素
 #include <stdexcept>         // 用于 std::bad_alloc 异常
 #include <memory_resource>   // C++17/20/23 PMR 特性
+#include <fstream>           // 用于读取 /proc/self/smaps_rollup
+#include <latch>             // 用于在清理阶段之前同步所有工作线程
+#include <string_view>       // 用于解析命令行参数
+#include <sys/resource.h>    // 用于 getrusage 统计缺页次数
+#include <sys/wait.h>        // 用于 waitpid
+#include <unistd.h>          // 用于 fork
+#include <sys/mman.h>        // 用于在父子进程之间共享结果
 
 // --- 依赖外部文件 ---
 // 确保 "memory_pool.h" 在正确的包含路径下，并提供了正确的接口
 // 编译命令示例: g++ -std=c++23 -pthread -O3 your_file_name.cpp -o benchmark
 // 如果 memory_pool.h 依赖其他库，也需要链接它们
 #include "memory_pool.h"
+#include "page_cache.h"
+#include "benchmarks/latency_histogram.h"
+#include "benchmarks/perf_counters.h"
+#include "benchmarks/workload.h"
 
 // --- 配置参数 ---
-const unsigned int NUM_THREADS = std::thread::hardware_concurrency(); // 线程数，使用硬件支持的最大并发数
-const size_t NUM_OPERATIONS_PER_THREAD = 100000; // 每个线程执行的操作总数
-const size_t MIN_ALLOC_SIZE = 8;                  // 最小分配内存块大小 (字节)
-const size_t MAX_ALLOC_SIZE = 4 * 1024;                // 最大分配内存块大小 (字节)，覆盖常见的小对象大小
-const int ALLOC_PERCENTAGE = 60;                  // 分配操作所占的百分比
-const unsigned int RANDOM_SEED = 54321;           // 固定的随机种子，确保每次运行结果可复现
+// 线程数、操作数、大小分布、申请比例、归还顺序与生命周期都由命令行参数决定，默认值与原来的固定配置相同
+workload::workload_config workload_config;
 // std::pmr::memory_resource 要求的默认对齐方式
 const size_t DEFAULT_ALIGNMENT = alignof(std::max_align_t);
 
+// 可以通过 --provision=<名称> 选择的内存池页面准备策略，--provision=all 会在子进程中依次测试每一种策略
+const std::pair<std::string_view, memory_pool_v2::page_provision_policy> PROVISION_POLICIES[] = {
+    {"lazy", memory_pool_v2::page_provision_policy::lazy},
+    {"zero_fill", memory_pool_v2::page_provision_policy::zero_fill},
+    {"populate", memory_pool_v2::page_provision_policy::populate},
+    {"mlock", memory_pool_v2::page_provision_policy::locked},
+    {"noreserve", memory_pool_v2::page_provision_policy::no_reserve},
+};
+
+// 内存占用的采样间隔 (毫秒)，可以通过 --sample-ms=<毫秒> 修改
+size_t memory_sample_interval_ms = 10;
+
+// --- 内存占用的读取 ---
+// 当前进程的 RSS (字节)，来自 /proc/self/statm 的第二列 (页数)
+size_t read_rss_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// 当前进程的 PSS (字节)，来自 /proc/self/smaps_rollup，共享的页面按共享的进程数平摊
+// 读取需要遍历所有的映射，比读取 RSS 慢，不可用时返回 0
+size_t read_pss_bytes() {
+    // 第一行是地址范围，之后每行是 "名称: 数值 kB"
+    std::ifstream rollup("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(rollup, line)) {
+        if (line.starts_with("Pss:")) {
+            return std::stoull(line.substr(std::string_view("Pss:").size())) * 1024;
+        }
+    }
+    return 0;
+}
+
+// 每个线程当前存活的申请字节数，只有所属线程写入，采样线程读取；每个计数器独占一个缓存行，避免伪共享
+struct alignas(64) LiveBytesCounter {
+    std::atomic<size_t> value{0};
+};
+
+// --- 内存占用统计 ---
+// 所有的 RSS/PSS 都是相对于本次运行开始前的进程占用计算的增量，前一个分配器保留的内存不计入
+struct MemoryFootprint {
+    size_t baseline_rss = 0;             // 运行开始前的 RSS
+    size_t baseline_pss = 0;             // 运行开始前的 PSS
+    size_t peak_rss = 0;                 // 运行期间采样到的最大 RSS 增量
+    size_t peak_pss = 0;                 // 运行期间采样到的最大 PSS 增量
+    size_t peak_live = 0;                // 运行期间采样到的最大存活申请字节数 (所有线程同一时刻之和)
+    size_t rss_at_peak_live = 0;         // 存活字节数最大时的 RSS 增量
+    size_t end_rss = 0;                  // 所有操作执行完、清理之前的 RSS 增量
+    size_t end_live = 0;                 // 所有操作执行完、清理之前的存活申请字节数
+    size_t retained_rss = 0;             // 全部归还、线程退出以后仍然占用的 RSS 增量
+    size_t retained_pss = 0;             // 全部归还、线程退出以后仍然占用的 PSS 增量
+    size_t samples = 0;                  // 采样次数
+
+    // 存活字节数最大时，实际占用相对于申请字节数的额外开销 (0.25 表示多占用 25%)
+    double overhead_at_peak() const {
+        return peak_live == 0 ? 0.0 : static_cast<double>(rss_at_peak_live) / static_cast<double>(peak_live) - 1.0;
+    }
+
+    // 清理之前的碎片率：占用的内存中没有被存活对象使用的比例
+    double end_fragmentation() const {
+        return end_rss == 0 || end_live >= end_rss ? 0.0 : 1.0 - static_cast<double>(end_live) / static_cast<double>(end_rss);
+    }
+};
+
+// --- 工作线程与主线程之间的同步点 ---
+struct RunPhases {
+    std::latch ready;            // 工作线程准备好了记录用的缓冲区
+    std::latch start{1};         // 主线程记录完运行前的内存占用以后开始执行操作
+    std::latch operations_done;  // 工作线程执行完所有操作
+    std::latch start_cleanup{1}; // 主线程记录完清理前的内存占用以后开始清理
+    explicit RunPhases(std::ptrdiff_t threads) : ready(threads), operations_done(threads) {}
+};
+
 // --- 统计数据结构 ---
 struct Stats {
     std::atomic<size_t> total_allocs{0};         // 总尝试分配次数
@@ -41,16 +125,25 @@ struct Stats {
     std::atomic<size_t> peak_memory_usage{0};    // 峰值内存使用量 (各线程峰值之和，近似值)
     // std::atomic<size_t> current_memory_usage{0}; // (可选) 追踪瞬时内存使用量，无锁情况下全局不精确
 
-    // 用于计算 P99 延迟
-    std::vector<long long> alloc_latencies;       // 存储所有单次分配延迟
-    std::vector<long long> dealloc_latencies;     // 存储所有单次释放延迟
-    std::mutex latency_mutex;                     // 保护延迟向量在合并时线程安全
+    // 用于计算延迟的百分位数，每个线程记录在自己的直方图中，结束时合并到这里
+    latency::histogram alloc_histogram;           // 所有单次分配延迟的分布 (纳秒)
+    latency::histogram dealloc_histogram;         // 所有单次释放延迟的分布 (纳秒)
+    std::mutex latency_mutex;                     // 保护直方图在合并时线程安全
 
     // 存储最终计算结果，避免重复计算和数据丢失
     long long total_duration_ms = 0;              // 基准测试总运行时间 (毫秒)
     double ops_per_sec = 0.0;                     // 每秒操作数 (成功分配 + 成功释放)
-    long long p99_alloc_latency_ns = 0;           // P99 分配延迟 (纳秒)
-    long long p99_dealloc_latency_ns = 0;         // P99 释放延迟 (纳秒)
+    latency::percentiles alloc_latency;           // 分配延迟的百分位数 (纳秒)
+    latency::percentiles dealloc_latency;         // 释放延迟的百分位数 (纳秒)
+    long minor_faults = 0;                        // 运行期间的次缺页次数 (不需要读磁盘)
+    long major_faults = 0;                        // 运行期间的主缺页次数 (需要读磁盘)
+    // 所有线程执行操作期间的硬件计数器之和，由 latency_mutex 保护
+    perf_counters::values counters;
+    size_t counter_threads = 0;                   // 已经合并了计数器的线程数
+
+    // 实际的内存占用，由采样线程读取 /proc 得到
+    MemoryFootprint footprint;
+    std::unique_ptr<LiveBytesCounter[]> live_bytes; // 每个线程当前存活的申请字节数
 
     // 清理统计数据，用于开始新的基准测试运行
     void clear() {
@@ -62,36 +155,33 @@ struct Stats {
         total_dealloc_latency_ns = 0;
         peak_memory_usage = 0;
         // current_memory_usage = 0; // 如果使用瞬时追踪，也需重置
-        alloc_latencies.clear();
-        dealloc_latencies.clear();
+        alloc_histogram.clear();
+        dealloc_histogram.clear();
         total_duration_ms = 0;
         ops_per_sec = 0.0;
-        p99_alloc_latency_ns = 0;
-        p99_dealloc_latency_ns = 0;
+        alloc_latency = {};
+        dealloc_latency = {};
+        minor_faults = 0;
+        major_faults = 0;
+        counters = {};
+        counter_threads = 0;
+        footprint = {};
+        live_bytes.reset();
         // 注意: 互斥锁不需要重置
     }
 };
 
-// --- 操作类型枚举 ---
-enum class OpType { ALLOCATE, DEALLOCATE };
-
-// --- 预生成的操作序列结构 ---
-struct Operation {
-    OpType type; // 操作类型 (分配或释放)
-    size_t size; // 操作大小 (分配时使用)
-    // 如果需要更复杂的场景，可以在这里添加对齐要求等信息
-};
-
 // --- 工作线程函数模板 ---
 // AllocFunc: 分配函数签名 void*(size_t) 或能抛出 std::bad_alloc
 // DeallocFunc: 释放函数签名 void(void*, size_t)
 template <typename AllocFunc, typename DeallocFunc>
 void worker_thread(
     int thread_id,                           // 线程ID
-    const std::vector<Operation>& operations,// 该线程要执行的固定操作序列 (常量引用)
+    const std::vector<workload::operation>& operations,// 该线程要执行的固定操作序列 (常量引用)
     AllocFunc allocate_func,                 // 分配函数 (或函数对象)
     DeallocFunc deallocate_func,             // 释放函数 (或函数对象)
-    Stats& global_stats)                     // 全局统计数据 (引用传递，用于更新)
+    Stats& global_stats,                     // 全局统计数据 (引用传递，用于更新)
+    RunPhases& phases)                       // 与主线程的同步点
 {
     // --- 线程本地状态和统计 ---
     size_t local_allocs = 0;
@@ -102,26 +192,34 @@ void worker_thread(
     long long local_dealloc_latency_ns = 0;
     size_t local_current_memory = 0; // 本线程当前分配的总内存
     size_t local_peak_memory = 0;    // 本线程运行期间的峰值内存
-    std::vector<long long> local_alloc_latencies_vec; // 本线程的分配延迟记录
-    std::vector<long long> local_dealloc_latencies_vec; // 本线程的释放延迟记录
-    // 预分配空间以减少重分配开销
-    local_alloc_latencies_vec.reserve(operations.size() * ALLOC_PERCENTAGE / 100 + 1); // +1 避免除零或完全没有分配
-    local_dealloc_latencies_vec.reserve(operations.size() * (100 - ALLOC_PERCENTAGE) / 100 + 1); // +1
-
-    // 存储本线程当前持有的分配信息 (指针, 大小)
-    // 使用 std::list 便于高效地随机移除元素 (模拟真实场景中的任意释放)
-    std::list<std::pair<void*, size_t>> allocations;
-
-    // 本地随机数生成器，用于选择要释放的内存块
-    std::mt19937 local_rng(RANDOM_SEED + thread_id); // 基于全局种子和线程ID，确保每个线程有不同的但确定的随机序列
+    // 本线程的延迟分布，大小固定，不随操作数增长，也不会在计时期间申请内存
+    latency::histogram local_alloc_histogram;
+    latency::histogram local_dealloc_histogram;
+    const latency::timer& timer = latency::timer::get_instance();
+    const size_t allocate_count = std::count_if(operations.begin(), operations.end(),
+                                                [](const workload::operation& op) { return op.type == workload::op_type::allocate; });
+
+    // 按申请的序号存储本线程的分配信息 (指针, 大小)，归还的操作在生成时已经确定了要归还第几次申请的内存块
+    // 申请失败或者已经归还的位置为空指针
+    std::vector<std::pair<void*, size_t>> allocations;
+    allocations.reserve(allocate_count);
+
+    // 先写一遍记录用的缓冲区，使它们在记录运行前的内存占用时已经计入 RSS，不会被算作分配器的开销
+    allocations.resize(allocations.capacity());
+    allocations.clear();
+    // 只统计本线程执行操作的期间，包括计时与写入内存块，这部分开销对每个分配器都相同
+    perf_counters::thread_counters counters;
+    phases.ready.count_down();
+    phases.start.wait();
+    counters.start();
 
     // --- 按预定顺序执行操作 ---
     for (const auto& op : operations) {
-        if (op.type == OpType::ALLOCATE) {
+        if (op.type == workload::op_type::allocate) {
             local_allocs++;
             void* ptr = nullptr;
             bool success = false;
-            auto alloc_start = std::chrono::high_resolution_clock::now(); // 记录开始时间
+            const uint64_t alloc_start = timer.now(); // 记录开始时间
             try {
                 // 调用传入的分配函数
                 ptr = allocate_func(op.size);
@@ -144,16 +242,22 @@ void worker_thread(
                  ptr = nullptr;
                 // std::cerr << "线程 " << thread_id << ": 分配期间捕获到未知异常！" << std::endl;
             }
-            auto alloc_end = std::chrono::high_resolution_clock::now(); // 记录结束时间
-            auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(alloc_end - alloc_start).count();
+            const uint64_t alloc_end = timer.now(); // 记录结束时间
+            const uint64_t latency = timer.elapsed_ns(alloc_start, alloc_end); // 已经减去计时本身的开销
             local_alloc_latency_ns += latency;        // 累加总延迟
-            local_alloc_latencies_vec.push_back(latency); // 记录单次延迟
+            local_alloc_histogram.record(latency);    // 记录单次延迟
 
 
+            allocations.push_back({success ? ptr : nullptr, op.size}); // 记录分配信息，失败时之后对应的归还会被跳过
             if (success && ptr) { // 检查成功标志和指针非空
+                // 写入每一页 (以及最后一个字节)，真实的程序会使用申请到的内存，否则没有写过的页面不会计入 RSS
+                for (size_t offset = 0; offset < op.size; offset += 4096) {
+                    static_cast<volatile char*>(ptr)[offset] = 1;
+                }
+                static_cast<volatile char*>(ptr)[op.size - 1] = 1;
                 local_successful_allocs++;
-                allocations.push_back({ptr, op.size}); // 记录分配信息
                 local_current_memory += op.size;       // 更新本地内存使用量
+                global_stats.live_bytes[thread_id].value.store(local_current_memory, std::memory_order_relaxed); // 供采样线程读取
                 // 更新本地峰值内存
                 if (local_current_memory > local_peak_memory) {
                      local_peak_memory = local_current_memory;
@@ -170,17 +274,13 @@ void worker_thread(
                 local_failed_allocs++;
             }
         } else { // DEALLOCATE (释放操作)
-            if (!allocations.empty()) { // 确保有东西可释放
-                // 随机选择一个已分配的内存块进行释放
-                std::uniform_int_distribution<size_t> dist(0, allocations.size() - 1);
-                size_t index_to_remove = dist(local_rng);
-                auto it = allocations.begin();
-                std::advance(it, index_to_remove); // 移动迭代器到随机选择的位置
-                void* ptr_to_free = it->first;     // 获取待释放指针
-                size_t size_to_free = it->second;  // 获取待释放大小 (某些释放函数需要)
+            auto& allocation = allocations[op.target]; // 生成时按归还顺序选好的内存块
+            if (allocation.first != nullptr) { // 对应的申请失败时跳过
+                void* ptr_to_free = allocation.first;     // 获取待释放指针
+                size_t size_to_free = allocation.second;  // 获取待释放大小 (某些释放函数需要)
 
                 local_deallocs++;
-                auto dealloc_start = std::chrono::high_resolution_clock::now();
+                const uint64_t dealloc_start = timer.now();
                 try {
                     deallocate_func(ptr_to_free, size_to_free); // 调用传入的释放函数
                 } catch(const std::exception& e) {
@@ -189,23 +289,31 @@ void worker_thread(
                 } catch(...) {
                     // std::cerr << "线程 " << thread_id << ": 释放期间捕获到未知异常！" << std::endl;
                 }
-                auto dealloc_end = std::chrono::high_resolution_clock::now();
-                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(dealloc_end - dealloc_start).count();
+                const uint64_t dealloc_end = timer.now();
+                const uint64_t latency = timer.elapsed_ns(dealloc_start, dealloc_end);
                 local_dealloc_latency_ns += latency;        // 累加总延迟
-                local_dealloc_latencies_vec.push_back(latency); // 记录单次延迟
+                local_dealloc_histogram.record(latency);    // 记录单次延迟
 
                 local_current_memory -= size_to_free; // 更新本地内存使用量
+                global_stats.live_bytes[thread_id].value.store(local_current_memory, std::memory_order_relaxed);
                 // global_stats.current_memory_usage.fetch_sub(size_to_free, std::memory_order_relaxed); // 配合可选的全局追踪
-                allocations.erase(it); // 从列表中移除已释放的块
+                allocation.first = nullptr; // 标记为已释放
             }
-            // else: 如果列表为空，尝试释放则忽略 (本次基准测试设计如此)
         }
     } // 操作循环结束
+    const perf_counters::values counter_values = counters.stop();
+
+    // 等待所有线程执行完，由主线程记录清理之前的内存占用
+    phases.operations_done.count_down();
+    phases.start_cleanup.wait();
 
     // --- 清理阶段：释放所有剩余的内存块 ---
     // 注意：此阶段的操作不计入基准测试的计时和延迟统计
     size_t remaining_deallocs_cleanup = 0;
     for (const auto& alloc_info : allocations) {
+        if (alloc_info.first == nullptr) {
+            continue; // 已经释放或者申请失败
+        }
         try {
              deallocate_func(alloc_info.first, alloc_info.second);
              // global_stats.current_memory_usage.fetch_sub(alloc_info.second, std::memory_order_relaxed); // 配合可选的全局追踪
@@ -242,72 +350,116 @@ void worker_thread(
     // 而不是所有线程在某一时刻同时达到的最大内存总和。
     global_stats.peak_memory_usage.fetch_add(local_peak_memory, std::memory_order_relaxed);
 
-    // --- 合并延迟数据到全局向量 (需要加锁保护) ---
+    // --- 合并延迟直方图到全局 (需要加锁保护) ---
     {
         std::lock_guard<std::mutex> lock(global_stats.latency_mutex); // RAII 锁
-        // 将本地延迟向量的数据追加到全局向量
-        global_stats.alloc_latencies.insert(global_stats.alloc_latencies.end(),
-                                            local_alloc_latencies_vec.begin(), local_alloc_latencies_vec.end());
-        global_stats.dealloc_latencies.insert(global_stats.dealloc_latencies.end(),
-                                              local_dealloc_latencies_vec.begin(), local_dealloc_latencies_vec.end());
+        global_stats.alloc_histogram.merge(local_alloc_histogram);
+        global_stats.dealloc_histogram.merge(local_dealloc_histogram);
+        global_stats.counters.merge(counter_values, global_stats.counter_threads++ == 0);
     } // 锁在此处自动释放
 }
 
-// --- 辅助函数：计算 P99 延迟 ---
-// 输入的向量会被修改 (排序)
-long long calculate_p99_latency(std::vector<long long>& latencies) {
-    if (latencies.empty()) {
-        return 0; // 没有数据则返回 0
+// --- 辅助函数：采样一次内存占用，更新峰值 ---
+void sample_memory_footprint(Stats& stats, unsigned int thread_count) {
+    MemoryFootprint& footprint = stats.footprint;
+    const size_t rss = read_rss_bytes();
+    const size_t pss = read_pss_bytes();
+    size_t live = 0;
+    for (unsigned int i = 0; i < thread_count; ++i) {
+        live += stats.live_bytes[i].value.load(std::memory_order_relaxed);
     }
-    // 直接对传入的向量进行排序 (如果后续不需要原始顺序)
-    // 如果需要保留原始顺序，应该先复制向量再排序
-    std::sort(latencies.begin(), latencies.end());
-    // 计算 P99 位置的索引
-    size_t index = static_cast<size_t>(latencies.size() * 0.99);
-    // 确保索引有效，特别是在样本量很小的情况下 (至少为0，不超过 size()-1)
-    index = std::min(index, latencies.size() - 1);
-    return latencies[index];
+    const size_t rss_delta = rss > footprint.baseline_rss ? rss - footprint.baseline_rss : 0;
+    const size_t pss_delta = pss > footprint.baseline_pss ? pss - footprint.baseline_pss : 0;
+    footprint.peak_rss = std::max(footprint.peak_rss, rss_delta);
+    footprint.peak_pss = std::max(footprint.peak_pss, pss_delta);
+    if (live >= footprint.peak_live) {
+        footprint.peak_live = live;
+        footprint.rss_at_peak_live = rss_delta;
+    }
+    footprint.samples++;
 }
 
 // --- 运行基准测试函数模板 ---
 template <typename AllocFunc, typename DeallocFunc>
 void run_benchmark(const std::string& name,                           // 基准测试名称
-                   const std::vector<std::vector<Operation>>& ops_per_thread, // 每个线程的操作序列
+                   const std::vector<std::vector<workload::operation>>& ops_per_thread, // 每个线程的操作序列
                    AllocFunc allocate_func,                            // 分配函数
                    DeallocFunc deallocate_func,                        // 释放函数
                    Stats& stats)                                       // 统计结果对象 (引用传递)
 {
     std::cout << "\n--- 开始运行基准测试: " << name << " ---" << std::endl;
-    std::cout << "线程数: " << NUM_THREADS
-              << ", 每个线程的操作数: " << NUM_OPERATIONS_PER_THREAD << std::endl;
+    std::cout << "线程数: " << workload_config.threads
+              << ", 每个线程的操作数: " << workload_config.ops_per_thread << std::endl;
 
     stats.clear(); // 确保每次运行前清空统计数据
     std::vector<std::thread> threads; // 存储线程对象
-    threads.reserve(NUM_THREADS);     // 预分配空间
-
-    auto benchmark_start_time = std::chrono::high_resolution_clock::now(); // 记录基准测试开始时间
+    threads.reserve(workload_config.threads); // 预分配空间
+    stats.live_bytes = std::make_unique<LiveBytesCounter[]>(workload_config.threads);
+    RunPhases phases(workload_config.threads);
 
     // --- 创建并启动工作线程 ---
-    for (unsigned int i = 0; i < NUM_THREADS; ++i) {
+    for (unsigned int i = 0; i < workload_config.threads; ++i) {
         // 使用 emplace_back 直接在 vector 中构造线程对象，避免拷贝
         threads.emplace_back(worker_thread<AllocFunc, DeallocFunc>, // 线程函数模板实例
                              i,                                  // 线程 ID
                              std::cref(ops_per_thread[i]),       // 操作序列 (常量引用)
                              allocate_func,                      // 分配函数
                              deallocate_func,                    // 释放函数
-                             std::ref(stats));                   // 全局统计对象 (引用包装器)
+                             std::ref(stats),                    // 全局统计对象 (引用包装器)
+                             std::ref(phases));                  // 同步点
     }
 
-    // --- 等待所有线程完成 ---
+    // --- 所有线程准备好以后记录运行前的内存占用，然后同时开始 ---
+    phases.ready.wait();
+    stats.footprint.baseline_rss = read_rss_bytes();
+    stats.footprint.baseline_pss = read_pss_bytes();
+    rusage usage_before{};
+    getrusage(RUSAGE_SELF, &usage_before); // 记录开始时的缺页次数
+    auto benchmark_start_time = std::chrono::high_resolution_clock::now(); // 记录基准测试开始时间 (不包括创建线程)
+    phases.start.count_down();
+
+    // --- 运行期间定期采样内存占用 ---
+    std::atomic<bool> sampling{true};
+    std::thread sampler([&stats, &sampling] {
+        while (sampling.load(std::memory_order_relaxed)) {
+            sample_memory_footprint(stats, workload_config.threads);
+            std::this_thread::sleep_for(std::chrono::milliseconds(memory_sample_interval_ms));
+        }
+    });
+
+    // --- 等待所有线程执行完操作 (不包括清理阶段) ---
+    phases.operations_done.wait();
+    auto benchmark_end_time = std::chrono::high_resolution_clock::now(); // 记录基准测试结束时间
+    sampling.store(false, std::memory_order_relaxed);
+    sampler.join();
+
+    // 清理之前的内存占用，此时存活的对象仍然持有
+    sample_memory_footprint(stats, workload_config.threads);
+    const size_t rss_end = read_rss_bytes();
+    stats.footprint.end_rss = rss_end > stats.footprint.baseline_rss ? rss_end - stats.footprint.baseline_rss : 0;
+    for (unsigned int i = 0; i < workload_config.threads; ++i) {
+        stats.footprint.end_live += stats.live_bytes[i].value.load(std::memory_order_relaxed);
+    }
+
+    // --- 开始清理并等待所有线程退出 ---
+    phases.start_cleanup.count_down();
     for (auto& t : threads) {
         if (t.joinable()) { // 确保线程是可加入的
             t.join();       // 等待线程结束
         }
     }
+    // 全部归还、线程退出以后仍然占用的内存，包括分配器缓存的空闲内存与无法归还给系统的碎片
+    const size_t rss_after = read_rss_bytes();
+    const size_t pss_after = read_pss_bytes();
+    stats.footprint.retained_rss = rss_after > stats.footprint.baseline_rss ? rss_after - stats.footprint.baseline_rss : 0;
+    stats.footprint.retained_pss = pss_after > stats.footprint.baseline_pss ? pss_after - stats.footprint.baseline_pss : 0;
 
-    auto benchmark_end_time = std::chrono::high_resolution_clock::now(); // 记录基准测试结束时间
     auto total_duration = std::chrono::duration_cast<std::chrono::milliseconds>(benchmark_end_time - benchmark_start_time);
     stats.total_duration_ms = total_duration.count(); // 存储总时长
+    rusage usage_after{};
+    getrusage(RUSAGE_SELF, &usage_after);
+    stats.minor_faults = usage_after.ru_minflt - usage_before.ru_minflt;
+    stats.major_faults = usage_after.ru_majflt - usage_before.ru_majflt;
 
     // --- 计算并打印统计结果 ---
     size_t successful_allocs_count = stats.successful_allocs.load();
@@ -319,18 +471,13 @@ void run_benchmark(const std::string& name,                           // 基准
     stats.ops_per_sec = (total_ops_executed == 0 || stats.total_duration_ms == 0) ? 0.0 :
                       (static_cast<double>(total_ops_executed) * 1000.0 / stats.total_duration_ms);
 
-    // 计算平均延迟 (微秒)
-    double avg_alloc_latency_us = (successful_allocs_count == 0) ? 0.0 :
-        (static_cast<double>(stats.total_alloc_latency_ns.load()) / successful_allocs_count / 1000.0);
-    double avg_dealloc_latency_us = (total_deallocs_count == 0) ? 0.0 :
-        (static_cast<double>(stats.total_dealloc_latency_ns.load()) / total_deallocs_count / 1000.0);
-
-    // 计算 P99 延迟 (会修改 stats 中的延迟向量)
-    stats.p99_alloc_latency_ns = calculate_p99_latency(stats.alloc_latencies);
-    stats.p99_dealloc_latency_ns = calculate_p99_latency(stats.dealloc_latencies);
-    // 转换为微秒
-    double p99_alloc_latency_us = static_cast<double>(stats.p99_alloc_latency_ns) / 1000.0;
-    double p99_dealloc_latency_us = static_cast<double>(stats.p99_dealloc_latency_ns) / 1000.0;
+    // 从合并后的直方图计算延迟的百分位数 (纳秒)，失败的分配也计入分配延迟
+    stats.alloc_latency = latency::summarize(stats.alloc_histogram);
+    stats.dealloc_latency = latency::summarize(stats.dealloc_histogram);
+    auto print_latency = [](const char* label, const latency::percentiles& latency) {
+        std::cout << label << "平均 " << latency.mean << ", p50 " << latency.p50 << ", p90 " << latency.p90 << ", p99 " << latency.p99
+                  << ", p99.9 " << latency.p999 << ", 最大 " << latency.max << " (ns)" << std::endl;
+    };
 
     // 设置输出格式
     std::cout << std::fixed << std::setprecision(2);
@@ -341,55 +488,230 @@ void run_benchmark(const std::string& name,                           // 基准
     std::cout << "成功分配次数:         " << successful_allocs_count << std::endl;
     std::cout << "失败分配次数:         " << stats.failed_allocs.load() << std::endl;
     std::cout << "成功释放次数:         " << total_deallocs_count << std::endl;
-    std::cout << "平均分配延迟:         " << avg_alloc_latency_us << " us" << std::endl;
-    std::cout << "P99 分配延迟:         " << p99_alloc_latency_us << " us" << std::endl;
-    std::cout << "平均释放延迟:         " << avg_dealloc_latency_us << " us" << std::endl;
-    std::cout << "P99 释放延迟:         " << p99_dealloc_latency_us << " us" << std::endl;
+    print_latency("分配延迟:             ", stats.alloc_latency);
+    print_latency("释放延迟:             ", stats.dealloc_latency);
     // 注意: 峰值内存使用量是各线程内部峰值的累加，是总内存压力的近似估计，
     //       可能高于系统在任一时刻的实际峰值内存占用。
     std::cout << "峰值内存 (线程峰值和):" << (static_cast<double>(stats.peak_memory_usage.load()) / 1024.0 / 1024.0) << " MB" << std::endl;
+    std::cout << "缺页次数 (minor/major): " << stats.minor_faults << " / " << stats.major_faults << std::endl;
+    std::cout << "硬件计数器 (每次操作): ";
+    bool any_counter = false;
+    for (size_t i = 0; i < perf_counters::EVENT_COUNT; ++i) {
+        const auto event = static_cast<perf_counters::event>(i);
+        if (stats.counters.has(event) && total_ops_executed > 0) {
+            std::cout << (any_counter ? ", " : "") << perf_counters::event_name(event) << " "
+                      << static_cast<double>(stats.counters[event]) / static_cast<double>(total_ops_executed);
+            any_counter = true;
+        }
+    }
+    std::cout << (any_counter ? "" : "不可用") << std::endl;
+    const MemoryFootprint& footprint = stats.footprint;
+    const double mb = 1024.0 * 1024.0;
+    std::cout << "运行前 RSS / PSS:     " << footprint.baseline_rss / mb << " / " << footprint.baseline_pss / mb << " MB" << std::endl;
+    std::cout << "峰值 RSS / PSS 增量:  " << footprint.peak_rss / mb << " / " << footprint.peak_pss / mb << " MB (采样 "
+              << footprint.samples << " 次, 间隔 " << memory_sample_interval_ms << " ms)" << std::endl;
+    std::cout << "峰值存活申请字节:     " << footprint.peak_live / mb << " MB, 此时 RSS 增量 " << footprint.rss_at_peak_live / mb
+              << " MB, 额外开销 " << footprint.overhead_at_peak() * 100.0 << "%" << std::endl;
+    std::cout << "清理前碎片率:         " << footprint.end_fragmentation() * 100.0 << "% (存活 " << footprint.end_live / mb
+              << " MB / RSS 增量 " << footprint.end_rss / mb << " MB)" << std::endl;
+    std::cout << "全部归还后保留:       RSS " << footprint.retained_rss / mb << " MB, PSS " << footprint.retained_pss / mb << " MB" << std::endl;
     std::cout << "--- 基准测试结束: " << name << " ---" << std::endl;
 }
 
+// --- 在子进程中运行的基准测试需要传回父进程的结果 ---
+struct RunResult {
+    size_t total_allocs;
+    size_t successful_allocs;
+    size_t failed_allocs;
+    size_t total_deallocs;
+    long long total_alloc_latency_ns;
+    long long total_dealloc_latency_ns;
+    size_t peak_memory_usage;
+    long long total_duration_ms;
+    double ops_per_sec;
+    latency::percentiles alloc_latency;
+    latency::percentiles dealloc_latency;
+    long minor_faults;
+    long major_faults;
+    perf_counters::values counters;
+    MemoryFootprint footprint;
+};
+
+// --- 辅助函数：在子进程中运行一个基准测试 ---
+// 每个分配器都从还没有申请过内存的进程开始，前一个分配器保留的内存不会被后一个分配器复用，内存占用才能互相比较
+// fork 失败时在当前进程中运行
+template <typename Body>
+void run_in_child(Stats& stats, Body&& body) {
+    void* shared = mmap(nullptr, sizeof(RunResult), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    std::cout.flush();
+    pid_t pid = shared == MAP_FAILED ? -1 : fork();
+    if (pid < 0) {
+        std::cerr << "fork 失败，在当前进程中运行" << std::endl;
+        if (shared != MAP_FAILED) {
+            munmap(shared, sizeof(RunResult));
+        }
+        body(stats);
+        return;
+    }
+    auto* result = static_cast<RunResult*>(shared);
+    if (pid == 0) {
+        Stats child_stats;
+        body(child_stats);
+        *result = {child_stats.total_allocs.load(), child_stats.successful_allocs.load(), child_stats.failed_allocs.load(),
+                   child_stats.total_deallocs.load(), child_stats.total_alloc_latency_ns.load(), child_stats.total_dealloc_latency_ns.load(),
+                   child_stats.peak_memory_usage.load(), child_stats.total_duration_ms, child_stats.ops_per_sec,
+                   child_stats.alloc_latency, child_stats.dealloc_latency, child_stats.minor_faults,
+                   child_stats.major_faults, child_stats.counters, child_stats.footprint};
+        std::cout.flush();
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    stats.total_allocs = result->total_allocs;
+    stats.successful_allocs = result->successful_allocs;
+    stats.failed_allocs = result->failed_allocs;
+    stats.total_deallocs = result->total_deallocs;
+    stats.total_alloc_latency_ns = result->total_alloc_latency_ns;
+    stats.total_dealloc_latency_ns = result->total_dealloc_latency_ns;
+    stats.peak_memory_usage = result->peak_memory_usage;
+    stats.total_duration_ms = result->total_duration_ms;
+    stats.ops_per_sec = result->ops_per_sec;
+    stats.alloc_latency = result->alloc_latency;
+    stats.dealloc_latency = result->dealloc_latency;
+    stats.minor_faults = result->minor_faults;
+    stats.major_faults = result->major_faults;
+    stats.counters = result->counters;
+    stats.footprint = result->footprint;
+    munmap(shared, sizeof(RunResult));
+}
+
+// --- 辅助函数：根据名称查找页面准备策略 ---
+std::optional<memory_pool_v2::page_provision_policy> parse_provision_policy(std::string_view name) {
+    for (const auto& [policy_name, policy] : PROVISION_POLICIES) {
+        if (policy_name == name) {
+            return policy;
+        }
+    }
+    return std::nullopt;
+}
+
 // --- 主函数 ---
-int main() {
+int main(int argc, char* argv[]) {
+    // --- 0. 解析命令行参数 ---
+    std::string_view provision_arg;
+    size_t reserve_gb = 0;
+    std::string trace_path;
+    // 内存池的参数，默认来自环境变量，可以通过 --pool-<参数名>=<值> 覆盖，参数名中的 _ 写成 -
+    memory_pool_v2::memory_pool_config pool_config = memory_pool_v2::memory_pool::get_config();
+    // 预设要在其他负载参数之前应用，之后的参数可以覆盖预设中的值
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--preset=") && workload::parse_argument(workload_config, arg) == workload::parse_result::invalid) {
+            std::cerr << "未知的预设: " << arg << std::endl;
+            return 1;
+        }
+    }
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--preset=")) {
+            continue;
+        }
+        auto workload_result = workload::parse_argument(workload_config, arg);
+        if (workload_result == workload::parse_result::ok) {
+            continue;
+        }
+        if (workload_result == workload::parse_result::invalid) {
+            std::cerr << "参数不合法: " << arg << std::endl;
+            return 1;
+        }
+        if (arg.starts_with("--provision=")) {
+            provision_arg = arg.substr(std::string_view("--provision=").size());
+        } else if (arg.starts_with("--reserve-gb=")) {
+            reserve_gb = std::stoull(std::string(arg.substr(std::string_view("--reserve-gb=").size())));
+        } else if (arg.starts_with("--sample-ms=")) {
+            memory_sample_interval_ms = std::max<size_t>(1, std::stoull(std::string(arg.substr(std::string_view("--sample-ms=").size()))));
+        } else if (arg.starts_with("--trace=")) {
+            trace_path = arg.substr(std::string_view("--trace=").size());
+        } else if (arg.starts_with("--pool-") && arg.find('=') != std::string_view::npos) {
+            std::string name(arg.substr(std::string_view("--pool-").size(), arg.find('=') - std::string_view("--pool-").size()));
+            std::ranges::replace(name, '-', '_');
+            if (!pool_config.set(name, arg.substr(arg.find('=') + 1))) {
+                std::cerr << "内存池参数不合法: " << arg << std::endl;
+                return 1;
+            }
+        } else {
+            std::cerr << "未知参数: " << arg << std::endl;
+            std::cerr << "用法: " << argv[0] << " [--provision=lazy|zero_fill|populate|mlock|noreserve|all] [--reserve-gb=64] [--trace=FILE] [--sample-ms=10]\n    "
+                      << "[--pool-max-free-bytes-per-list=256K] [--pool-page-allocate-count=2048] [--pool-max-page-group-count=8]\n    "
+                      << "[--pool-min-batch-count=4] [--pool-max-cached-unit-size=16K] [--pool-class-max-free-bytes=64=1M,4096=64K]\n    "
+                      << workload::usage() << std::endl;
+            std::cerr << "预设:" << std::endl;
+            for (const auto& preset : workload::PRESETS) {
+                std::cerr << "    " << std::left << std::setw(10) << preset.name << preset.description << std::endl;
+            }
+            return 1;
+        }
+    }
+    // 参数在第一次申请内存时生效，之后的 --provision=all 子进程与每个分配器的子进程都使用同样的参数
+    if (!memory_pool_v2::memory_pool::configure(pool_config)) {
+        std::cerr << "内存池参数的组合不合法，每个空闲链表至少要能放下两个内存块" << std::endl;
+        return 1;
+    }
+    if (!provision_arg.empty() && provision_arg != "all") {
+        auto policy = parse_provision_policy(provision_arg);
+        if (!policy.has_value()) {
+            std::cerr << "未知的页面准备策略: " << provision_arg << std::endl;
+            return 1;
+        }
+        memory_pool_v2::page_cache::get_instance().set_provision_policy(policy.value());
+    }
+    // 预留的地址空间是全局的，--provision=all 的子进程也会使用这一段空间
+    if (reserve_gb > 0 && !memory_pool_v2::memory_pool::reserve_address_space(reserve_gb * 1024 * 1024 * 1024)) {
+        std::cerr << "预留地址空间失败: " << reserve_gb << " GB" << std::endl;
+        return 1;
+    }
+
     std::cout << "启动高并发内存分配器基准测试..." << std::endl;
     std::cout << "使用 C++23 标准特性。" << std::endl;
     std::cout << "======================================================" << std::endl;
     std::cout << "当前基准测试配置:" << std::endl;
-    std::cout << "  线程数 (NUM_THREADS):              " << NUM_THREADS << std::endl;
-    std::cout << "  每线程操作数 (NUM_OPERATIONS):   " << NUM_OPERATIONS_PER_THREAD << std::endl;
-    std::cout << "  分配操作比例 (ALLOC_PERCENTAGE): " << ALLOC_PERCENTAGE << "%" << std::endl;
-    std::cout << "  最小分配大小 (MIN_ALLOC_SIZE):     " << MIN_ALLOC_SIZE << " B" << std::endl;
-    std::cout << "  最大分配大小 (MAX_ALLOC_SIZE):     " << MAX_ALLOC_SIZE << " B" << std::endl;
-    std::cout << "  随机种子 (RANDOM_SEED):            " << RANDOM_SEED << std::endl;
+    std::cout << "  负载预设 (--preset):             " << workload_config.preset << std::endl;
+    std::cout << "  线程数 (--threads):              " << workload_config.threads << std::endl;
+    std::cout << "  每线程操作数 (--ops):            " << workload_config.ops_per_thread << std::endl;
+    std::cout << "  大小分布 (--sizes):              " << workload_config.sizes.describe() << std::endl;
+    if (workload_config.lifetime.type == workload::lifetime_distribution::kind::none) {
+        std::cout << "  分配操作比例 (--alloc-percent):  " << workload_config.alloc_percent << "%" << std::endl;
+        std::cout << "  归还顺序 (--free-order):         " << workload::free_order_name(workload_config.order) << std::endl;
+    } else {
+        std::cout << "  生命周期 (--lifetime):           " << workload_config.lifetime.describe() << std::endl;
+    }
+    std::cout << "  随机种子 (--seed):               " << workload_config.seed << std::endl;
     std::cout << "  PMR对齐要求 (DEFAULT_ALIGNMENT): " << DEFAULT_ALIGNMENT << " B" << std::endl;
+    std::cout << "  页面准备策略 (--provision):      " << (provision_arg.empty() ? "lazy" : provision_arg) << std::endl;
+    std::cout << "  预留地址空间 (--reserve-gb):     " << reserve_gb << " GB" << std::endl;
+    std::cout << "  线程缓存链表上限 (--pool-*):     " << pool_config.max_free_bytes_per_list / 1024 << " KB";
+    for (auto [memory_size, bytes] : pool_config.class_max_free_bytes) {
+        std::cout << ", " << memory_size << "B: " << bytes / 1024 << " KB";
+    }
+    std::cout << std::endl;
+    std::cout << "  内存池增长参数 (--pool-*):       每次向系统申请 " << pool_config.page_allocate_count << " 页, 中心缓存最多 "
+              << pool_config.max_page_group_count << " 组, 最少批量 " << pool_config.min_batch_count << " 个, 缓存上限 "
+              << pool_config.max_cached_unit_size << " B" << std::endl;
+    const latency::timer& timer = latency::timer::get_instance();
+    std::cout << "  单次操作计时:                    " << (timer.uses_tsc() ? "TSC" : "steady_clock") << ", 每个计数 "
+              << std::setprecision(4) << timer.ns_per_tick() << " ns, 计时开销 " << timer.overhead_ns() << " ns (已从每次测量中减去)" << std::endl;
+    {
+        // 在主线程上试着打开一次，工作线程打开的结果与这里相同
+        perf_counters::thread_counters probe;
+        std::cout << "  硬件计数器 (perf_event_open):    "
+                  << (probe.unavailable_reason().empty() ? "可用" : "部分或全部不可用 (" + probe.unavailable_reason() + ")") << std::endl;
+    }
     std::cout << "======================================================" << std::endl;
 
     // --- 1. 生成确定性的操作序列 ---
-    std::cout << "正在为 " << NUM_THREADS << " 个线程生成每个线程 "
-              << NUM_OPERATIONS_PER_THREAD << " 个操作..." << std::endl;
-    std::vector<std::vector<Operation>> ops_per_thread(NUM_THREADS);
-    std::mt19937 master_rng(RANDOM_SEED); // 主随机数生成器，用于生成操作序列
-    std::uniform_int_distribution<size_t> size_dist(MIN_ALLOC_SIZE, MAX_ALLOC_SIZE); // 分配大小分布
-    std::uniform_int_distribution<int> op_dist(1, 100); // 操作类型分布 (1-100)
-
-    for (unsigned int i = 0; i < NUM_THREADS; ++i) {
-        ops_per_thread[i].reserve(NUM_OPERATIONS_PER_THREAD);
-        // 使用主生成器确保整个操作集是确定的
-        // 如果需要每个线程有独立的随机性（但不易复现），可以为每个线程创建单独的生成器
-        for (size_t j = 0; j < NUM_OPERATIONS_PER_THREAD; ++j) {
-            Operation op;
-            op.size = size_dist(master_rng); // 随机生成大小
-            if (op_dist(master_rng) <= ALLOC_PERCENTAGE) {
-                op.type = OpType::ALLOCATE; // 按比例决定是分配还是释放
-            } else {
-                op.type = OpType::DEALLOCATE;
-                // 释放操作的大小在工作线程中会根据记录的分配信息确定，这里生成的大小会被忽略
-            }
-            ops_per_thread[i].push_back(op);
-        }
-    }
+    std::cout << "正在为 " << workload_config.threads << " 个线程生成每个线程 "
+              << workload_config.ops_per_thread << " 个操作..." << std::endl;
+    // 同样的配置总是生成同样的序列，每个分配器执行完全相同的操作
+    const std::vector<std::vector<workload::operation>> ops_per_thread = workload::generate(workload_config);
     std::cout << "操作序列生成完毕。" << std::endl;
 
 
@@ -452,17 +774,52 @@ int main() {
 
 
     // --- 3. 运行各个基准测试 ---
-    // 运行自定义内存池基准测试
+    if (provision_arg == "all") {
+        // 页缓存申请过的页面会一直保留，所以每种策略都要在一个还没有使用过内存池的子进程中测试
+        std::cout << "\n--- 页面准备策略对比 ---" << std::endl;
+        for (const auto& [policy_name, policy] : PROVISION_POLICIES) {
+            std::cout.flush();
+            pid_t pid = fork();
+            if (pid == 0) {
+                memory_pool_v2::page_cache::get_instance().set_provision_policy(policy);
+                Stats policy_stats;
+                run_benchmark("自定义内存池 (provision=" + std::string(policy_name) + ")", ops_per_thread, memory_pool_alloc, memory_pool_dealloc, policy_stats);
+                std::cout.flush();
+                _exit(0);
+            }
+            if (pid > 0) {
+                waitpid(pid, nullptr, 0);
+            } else {
+                std::cerr << "fork 失败，跳过策略: " << policy_name << std::endl;
+            }
+        }
+    }
+
+    // 每个分配器都在单独的子进程中运行，内存占用互不影响
+    // 运行自定义内存池基准测试，指定了 --trace 时把这一轮的负载记录下来，可以用 memory_pool_replay 回放
     Stats pool_stats;
-    run_benchmark("自定义内存池 (Custom Memory Pool)", ops_per_thread, memory_pool_alloc, memory_pool_dealloc, pool_stats);
+    run_in_child(pool_stats, [&](Stats& stats) {
+        if (!trace_path.empty() && !memory_pool_v2::memory_pool::start_trace(trace_path)) {
+            std::cerr << "无法创建记录文件: " << trace_path << std::endl;
+        }
+        run_benchmark("自定义内存池 (Custom Memory Pool)", ops_per_thread, memory_pool_alloc, memory_pool_dealloc, stats);
+        if (memory_pool_v2::trace_recorder::is_recording()) {
+            memory_pool_v2::memory_pool::stop_trace();
+            std::cout << "已记录 " << memory_pool_v2::trace_recorder::get_instance().event_count() << " 次操作到 " << trace_path << std::endl;
+        }
+    });
 
     // 运行标准 malloc/free 基准测试
     Stats malloc_stats;
-    run_benchmark("标准库 malloc/free", ops_per_thread, malloc_alloc, malloc_dealloc, malloc_stats);
+    run_in_child(malloc_stats, [&](Stats& stats) {
+        run_benchmark("标准库 malloc/free", ops_per_thread, malloc_alloc, malloc_dealloc, stats);
+    });
 
     // 运行 C++ PMR 同步池资源基准测试
     Stats pmr_stats;
-    run_benchmark("标准库 std::pmr::synchronized_pool_resource", ops_per_thread, pmr_alloc, pmr_dealloc, pmr_stats);
+    run_in_child(pmr_stats, [&](Stats& stats) {
+        run_benchmark("标准库 std::pmr::synchronized_pool_resource", ops_per_thread, pmr_alloc, pmr_dealloc, stats);
+    });
 
 
     // --- 4. 对比结果 ---
@@ -507,25 +864,23 @@ int main() {
     print_row_double("每秒操作数 (Ops/Sec,越高越好)", pool_stats.ops_per_sec, malloc_stats.ops_per_sec, pmr_stats.ops_per_sec);
     std::cout << std::string(name_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|" << std::endl; // 分隔符
 
-    print_row_double("平均分配延迟 (us, 越低越好)",
-                     (pool_stats.successful_allocs.load() == 0) ? 0.0 : (static_cast<double>(pool_stats.total_alloc_latency_ns.load()) / pool_stats.successful_allocs.load() / 1000.0),
-                     (malloc_stats.successful_allocs.load() == 0) ? 0.0 : (static_cast<double>(malloc_stats.total_alloc_latency_ns.load()) / malloc_stats.successful_allocs.load() / 1000.0),
-                     (pmr_stats.successful_allocs.load() == 0) ? 0.0 : (static_cast<double>(pmr_stats.total_alloc_latency_ns.load()) / pmr_stats.successful_allocs.load() / 1000.0));
-
-    print_row_double("P99 分配延迟 (us, 越低越好)",
-                     static_cast<double>(pool_stats.p99_alloc_latency_ns) / 1000.0,
-                     static_cast<double>(malloc_stats.p99_alloc_latency_ns) / 1000.0,
-                     static_cast<double>(pmr_stats.p99_alloc_latency_ns) / 1000.0);
-
-    print_row_double("平均释放延迟 (us, 越低越好)",
-                     (pool_stats.total_deallocs.load() == 0) ? 0.0 : (static_cast<double>(pool_stats.total_dealloc_latency_ns.load()) / pool_stats.total_deallocs.load() / 1000.0),
-                     (malloc_stats.total_deallocs.load() == 0) ? 0.0 : (static_cast<double>(malloc_stats.total_dealloc_latency_ns.load()) / malloc_stats.total_deallocs.load() / 1000.0),
-                     (pmr_stats.total_deallocs.load() == 0) ? 0.0 : (static_cast<double>(pmr_stats.total_dealloc_latency_ns.load()) / pmr_stats.total_deallocs.load() / 1000.0));
-
-    print_row_double("P99 释放延迟 (us, 越低越好)",
-                     static_cast<double>(pool_stats.p99_dealloc_latency_ns) / 1000.0,
-                     static_cast<double>(malloc_stats.p99_dealloc_latency_ns) / 1000.0,
-                     static_cast<double>(pmr_stats.p99_dealloc_latency_ns) / 1000.0);
+    // 延迟的单位为纳秒，来自每个线程的直方图合并以后的结果，已经减去计时本身的开销
+    auto print_latency_row = [&](const std::string& metric_name, auto field) {
+        print_row_double(metric_name, static_cast<double>(field(pool_stats)), static_cast<double>(field(malloc_stats)),
+                         static_cast<double>(field(pmr_stats)));
+    };
+    print_latency_row("平均分配延迟 (ns, 越低越好)", [](const Stats& stats) { return stats.alloc_latency.mean; });
+    print_latency_row("P50 分配延迟 (ns)", [](const Stats& stats) { return stats.alloc_latency.p50; });
+    print_latency_row("P90 分配延迟 (ns)", [](const Stats& stats) { return stats.alloc_latency.p90; });
+    print_latency_row("P99 分配延迟 (ns)", [](const Stats& stats) { return stats.alloc_latency.p99; });
+    print_latency_row("P99.9 分配延迟 (ns)", [](const Stats& stats) { return stats.alloc_latency.p999; });
+    print_latency_row("最大分配延迟 (ns)", [](const Stats& stats) { return stats.alloc_latency.max; });
+    print_latency_row("平均释放延迟 (ns, 越低越好)", [](const Stats& stats) { return stats.dealloc_latency.mean; });
+    print_latency_row("P50 释放延迟 (ns)", [](const Stats& stats) { return stats.dealloc_latency.p50; });
+    print_latency_row("P90 释放延迟 (ns)", [](const Stats& stats) { return stats.dealloc_latency.p90; });
+    print_latency_row("P99 释放延迟 (ns)", [](const Stats& stats) { return stats.dealloc_latency.p99; });
+    print_latency_row("P99.9 释放延迟 (ns)", [](const Stats& stats) { return stats.dealloc_latency.p999; });
+    print_latency_row("最大释放延迟 (ns)", [](const Stats& stats) { return stats.dealloc_latency.max; });
      std::cout << std::string(name_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|" << std::endl; // 分隔符
 
     print_row_double("峰值内存 (MB, 线程峰值和)",
@@ -533,6 +888,50 @@ int main() {
                      malloc_stats.peak_memory_usage.load() / 1024.0 / 1024.0,
                      pmr_stats.peak_memory_usage.load() / 1024.0 / 1024.0);
 
+    const double mb = 1024.0 * 1024.0;
+    print_row_double("峰值 RSS 增量 (MB)", pool_stats.footprint.peak_rss / mb, malloc_stats.footprint.peak_rss / mb, pmr_stats.footprint.peak_rss / mb);
+    print_row_double("峰值 PSS 增量 (MB)", pool_stats.footprint.peak_pss / mb, malloc_stats.footprint.peak_pss / mb, pmr_stats.footprint.peak_pss / mb);
+    print_row_double("峰值时额外开销 (%, 越低越好)", pool_stats.footprint.overhead_at_peak() * 100.0,
+                     malloc_stats.footprint.overhead_at_peak() * 100.0, pmr_stats.footprint.overhead_at_peak() * 100.0);
+    print_row_double("清理前碎片率 (%, 越低越好)", pool_stats.footprint.end_fragmentation() * 100.0,
+                     malloc_stats.footprint.end_fragmentation() * 100.0, pmr_stats.footprint.end_fragmentation() * 100.0);
+    print_row_double("归还后保留 RSS (MB)", pool_stats.footprint.retained_rss / mb, malloc_stats.footprint.retained_rss / mb,
+                     pmr_stats.footprint.retained_rss / mb);
+    print_row_size("缺页次数 (minor)", pool_stats.minor_faults, malloc_stats.minor_faults, pmr_stats.minor_faults);
+    std::cout << std::string(name_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|-" << std::string(val_w, '-') << "-|" << std::endl; // 分隔符
+
+    // 硬件计数器按成功执行的操作数平均，不可用的计数器显示为 "-"
+    auto per_operation = [](const Stats& stats, perf_counters::event event) -> std::optional<double> {
+        const size_t ops = stats.successful_allocs.load() + stats.total_deallocs.load();
+        if (!stats.counters.has(event) || ops == 0) {
+            return std::nullopt;
+        }
+        return static_cast<double>(stats.counters[event]) / static_cast<double>(ops);
+    };
+    auto print_row_optional = [&](const std::string& metric_name, auto field) {
+        std::cout << std::left << std::setw(name_w) << metric_name;
+        for (const Stats* stats : {&pool_stats, &malloc_stats, &pmr_stats}) {
+            const std::optional<double> value = field(*stats);
+            std::cout << " | " << std::right << std::setw(val_w);
+            if (value.has_value()) {
+                std::cout << std::fixed << std::setprecision(2) << value.value();
+            } else {
+                std::cout << "-";
+            }
+        }
+        std::cout << " |" << std::endl;
+    };
+    for (size_t i = 0; i < perf_counters::EVENT_COUNT; ++i) {
+        const auto event = static_cast<perf_counters::event>(i);
+        print_row_optional(std::string(perf_counters::event_name(event)) + " (每次操作)", [&](const Stats& stats) { return per_operation(stats, event); });
+    }
+    print_row_optional("IPC (指令/周期)", [](const Stats& stats) -> std::optional<double> {
+        if (!stats.counters.has(perf_counters::event::cycles) || !stats.counters.has(perf_counters::event::instructions) ||
+            stats.counters[perf_counters::event::cycles] == 0) {
+            return std::nullopt;
+        }
+        return static_cast<double>(stats.counters[perf_counters::event::instructions]) / static_cast<double>(stats.counters[perf_counters::event::cycles]);
+    });
     print_row_size("成功分配次数", pool_stats.successful_allocs.load(), malloc_stats.successful_allocs.load(), pmr_stats.successful_allocs.load());
     print_row_size("失败分配次数", pool_stats.failed_allocs.load(), malloc_stats.failed_allocs.load(), pmr_stats.failed_allocs.load());
     print_row_size("成功释放次数", pool_stats.total_deallocs.load(), malloc_stats.total_deallocs.load(), pmr_stats.total_deallocs.load());
@@ -541,6 +940,8 @@ int main() {
     std::cout << std::string(name_w + 3 + val_w + 3 + val_w + 3 + val_w + 2, '-') << std::endl;
     std::cout << "注意: Ops/Sec 来自各基准测试的实际运行时间。延迟越低越好。" << std::endl;
     std::cout << "     峰值内存是所有线程各自内部峰值内存使用量的总和（近似值）。" << std::endl;
+    std::cout << "     RSS/PSS 都是相对于各自运行开始前的增量，额外开销 = 存活字节数最大时的 RSS 增量 / 存活的申请字节数 - 1。" << std::endl;
+    std::cout << "     硬件计数器包括计时与写入内存块的开销，适合比较分配器之间的差异，\"-\" 表示当前环境不可用。" << std::endl;
     std::cout << "======================================================" << std::endl;
 
 
@@ -0,0 +1,52 @@
+//
+// Created by ghost-him on 25-5-12.
+//
+
+#ifndef POOL_ALLOCATOR_H
+#define POOL_ALLOCATOR_H
+#include <cstddef>
+#include <new>
+
+#include "memory_pool.h"
+#include "utils.h"
+
+namespace memory_pool_v2 {
+
+// 满足标准库 Allocator 要求的适配器，使 std::vector、std::map 等容器从内存池中申请内存
+// 没有状态，所有实例都相等，可以在不同的容器之间交换与移动元素
+template <typename T>
+class pool_allocator {
+public:
+    using value_type = T;
+    // 内存池只保证 ALIGNMENT 字节对齐
+    static_assert(alignof(T) <= size_utils::ALIGNMENT, "pool_allocator 不支持对齐要求超过 ALIGNMENT 的类型");
+
+    pool_allocator() noexcept = default;
+    template <typename U>
+    pool_allocator(const pool_allocator<U>&) noexcept {}
+
+    /// 申请 n 个元素的空间
+    /// 返回值：指向空间的指针，内存池申请失败时抛出 std::bad_alloc
+    [[nodiscard]] T* allocate(size_t n) {
+        if (n > static_cast<size_t>(-1) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        auto result = memory_pool::allocate(n * sizeof(T));
+        if (!result.has_value()) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(*result);
+    }
+
+    /// 归还 n 个元素的空间，n 需要与申请时相同
+    void deallocate(T* ptr, size_t n) noexcept {
+        memory_pool::deallocate(ptr, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const pool_allocator<U>&) const noexcept { return true; }
+};
+
+} // memory_pool_v2
+
+#endif //POOL_ALLOCATOR_H
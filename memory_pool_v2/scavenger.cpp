@@ -0,0 +1,95 @@
+//
+// Created by ghost-him on 25-5-3.
+//
+
+#include "scavenger.h"
+
+#include <algorithm>
+
+#include "central_cache.h"
+#include "page_cache.h"
+
+namespace memory_pool_v2 {
+    scavenger::scavenger() {
+        // 确保页缓存与中心缓存先于回收线程构造，从而在程序退出时后于回收线程析构
+        page_cache::get_instance();
+        central_cache::get_instance();
+    }
+
+    scavenger::~scavenger() {
+        stop();
+    }
+
+    void scavenger::start(const scavenger_config& config) {
+        stop();
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            m_config = config;
+            m_running.store(true, std::memory_order_relaxed);
+        }
+        // 空的页面先留在中心缓存中供再次申请时重用，由回收线程每轮统一归还，页面最多多保留一个回收间隔
+        central_cache::get_instance().set_defer_span_release(config.trim_central_cache);
+        m_thread = std::thread(&scavenger::run, this);
+    }
+
+    void scavenger::stop() {
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            m_running.store(false, std::memory_order_relaxed);
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+        // 停止以后不会再有人整理中心缓存，已经留下的空页面要在这里归还
+        central_cache::get_instance().set_defer_span_release(false);
+        central_cache::get_instance().release_empty_spans();
+    }
+
+    size_t scavenger::run_once() {
+        scavenger_config config;
+        {
+            std::unique_lock<std::mutex> guard(m_mutex);
+            config = m_config;
+        }
+
+        if (config.trim_central_cache) {
+            m_trimmed_bytes.fetch_add(central_cache::get_instance().trim(config.central_max_free_bytes_per_list), std::memory_order_relaxed);
+        }
+
+        page_cache& cache = page_cache::get_instance();
+        // 按照释放速率计算这一轮最多可以归还多少字节
+        size_t budget = config.release_bytes_per_second / 1000 * std::max<size_t>(config.interval.count(), 1);
+        // 驻留的内存已经低于目标值了，就不需要再归还了
+        const size_t resident = cache.mapped_bytes() - cache.released_bytes();
+        budget = resident > config.target_resident_bytes ? std::min(budget, resident - config.target_resident_bytes) : 0;
+
+        size_t released = 0;
+        if (budget > 0) {
+            released = cache.release_idle_pages(config.idle_threshold, budget);
+        }
+        m_pass_count.fetch_add(1, std::memory_order_relaxed);
+        return released;
+    }
+
+    size_t scavenger::released_bytes() const {
+        return page_cache::get_instance().total_released_bytes();
+    }
+
+    size_t scavenger::refaulted_bytes() const {
+        return page_cache::get_instance().total_refaulted_bytes();
+    }
+
+    void scavenger::run() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> guard(m_mutex);
+                m_cv.wait_for(guard, m_config.interval, [this] { return !m_running.load(std::memory_order_relaxed); });
+                if (!m_running.load(std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            run_once();
+        }
+    }
+} // memory_pool_v2
@@ -0,0 +1,78 @@
+//
+// Created by ghost-him on 25-5-3.
+//
+
+#ifndef SCAVENGER_H
+#define SCAVENGER_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+namespace memory_pool_v2 {
+
+    struct scavenger_config {
+        // 两次回收之间的间隔
+        std::chrono::milliseconds interval {1000};
+        // 空闲页至少要空闲这么久才会被归还给操作系统
+        std::chrono::milliseconds idle_threshold {5000};
+        // 每秒最多归还给操作系统的字节数，用于限制 madvise 的频率
+        size_t release_bytes_per_second = 64 * 1024 * 1024;
+        // 页缓存驻留的内存（申请的总量 - 已经归还的量）不超过这个值时不做归还
+        size_t target_resident_bytes = 0;
+        // 是否延迟归还中心缓存中空的页面，由回收线程每轮统一归还
+        bool trim_central_cache = true;
+        // 中心缓存中空的页面每轮都会归还给页缓存，一种大小的大内存块链表超过这个字节数时也全部归还
+        size_t central_max_free_bytes_per_list = 1024 * 1024;
+    };
+
+    // 后台回收线程，定期将长时间空闲的页面归还给操作系统，避免在分配与回收的路径上进行系统调用
+    class scavenger {
+    public:
+        static scavenger& get_instance() {
+            static scavenger instance;
+            return instance;
+        }
+
+        /// 启动后台回收线程，如果已经启动了，则使用新的配置重新启动
+        void start(const scavenger_config& config);
+
+        /// 停止后台回收线程
+        void stop();
+
+        /// 执行一轮回收，后台线程会定期调用，也可以手动调用
+        /// 返回值：本轮归还给操作系统的字节数
+        size_t run_once();
+
+        bool is_running() const { return m_running.load(std::memory_order_relaxed); }
+
+        /// 已经执行的回收轮数
+        size_t pass_count() const { return m_pass_count.load(std::memory_order_relaxed); }
+        /// 累计从中心缓存归还给页缓存的字节数
+        size_t trimmed_bytes() const { return m_trimmed_bytes.load(std::memory_order_relaxed); }
+        /// 累计归还给操作系统的字节数
+        size_t released_bytes() const;
+        /// 累计重新缺页的字节数（估算值）
+        size_t refaulted_bytes() const;
+
+        ~scavenger();
+    private:
+        scavenger();
+
+        void run();
+
+        scavenger_config m_config;
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        std::atomic<bool> m_running = false;
+
+        std::atomic<size_t> m_pass_count = 0;
+        std::atomic<size_t> m_trimmed_bytes = 0;
+    };
+
+} // memory_pool_v2
+
+#endif //SCAVENGER_H
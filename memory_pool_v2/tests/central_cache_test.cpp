@@ -107,6 +107,64 @@ protected:
         nodes.clear(); // 清空 vector 表示概念上的释放
     }
 
+    // 以下辅助函数用于检查内部状态，central_cache 只把 fixture 本身声明为友元，测试用例中需要通过这些函数访问
+    page_span* find_span(size_t index, std::byte* memory) {
+        auto& page_map = cache.m_page_set[index];
+        auto it = page_map.upper_bound(memory);
+        if (it == page_map.begin()) {
+            return nullptr;
+        }
+        --it;
+        return memory < it->first + it->second.size() ? &it->second : nullptr;
+    }
+
+    bool has_span(size_t index, std::byte* page_start_addr) {
+        return cache.m_page_set[index].contains(page_start_addr);
+    }
+
+    size_t free_unit_count(size_t index) {
+        return cache.m_free_unit_count[index];
+    }
+
+    // 统计所有页面中实际空闲的内存块个数，应该与 free_unit_count 一致
+    size_t count_free_units(size_t index) {
+        size_t count = 0;
+        for (auto& [_, span] : cache.m_page_set[index]) {
+            count += span.total_unit_count() - span.allocated_unit_count();
+        }
+        return count;
+    }
+
+    // 任意一个部分分配的页面，没有时返回 nullptr
+    page_span* any_partial_span(size_t index) {
+        for (auto& list : cache.m_partial_spans[index]) {
+            if (!list.empty()) {
+                return list.front();
+            }
+        }
+        return nullptr;
+    }
+
+    // 检查每个页面都在与其使用情况相符的链表中，并且链表的长度与页面的个数一致
+    void check_span_lists(size_t index) {
+        for (auto& [_, span] : cache.m_page_set[index]) {
+            span_list* list = span_list::list_of(&span);
+            if (span.is_full()) {
+                EXPECT_EQ(list, &cache.m_full_spans[index]);
+            } else if (span.is_empty()) {
+                EXPECT_EQ(list, &cache.m_empty_spans[index]);
+            } else {
+                EXPECT_EQ(list, &cache.m_partial_spans[index][central_cache::occupancy_bucket(&span)]);
+            }
+        }
+        size_t partial_span_count = 0;
+        for (auto& list : cache.m_partial_spans[index]) {
+            partial_span_count += list.size();
+        }
+        EXPECT_EQ(cache.m_full_spans[index].size() + partial_span_count + cache.m_empty_spans[index].size(),
+                  cache.m_page_set[index].size());
+    }
+
     // *** 修改点：将并发任务函数移入 Fixture 并设为 static ***
     // 静态成员函数，用于在单独的线程中执行分配/释放操作
     // 注意：静态成员函数没有 this 指针，需要重新获取单例实例
@@ -470,12 +528,9 @@ TEST_F(CentralCacheTest, DeallocateFreesPageInternalCheck) {
     page_span* managed_span_ptr = nullptr;
 
     { // 作用域用于查找 span
-        auto& page_map = cache.m_page_set[index]; // 访问私有成员
-        auto it_map = page_map.upper_bound(first_block);
-        ASSERT_NE(it_map, page_map.begin()) << "Could not find managing page_span for allocated block " << (void*)first_block << " in m_page_set[" << index << "]";
-        --it_map;
-        page_start_addr = it_map->first;
-        managed_span_ptr = &(it_map->second);
+        managed_span_ptr = find_span(index, first_block);
+        ASSERT_NE(managed_span_ptr, nullptr) << "Could not find managing page_span for allocated block " << (void*)first_block << " in m_page_set[" << index << "]";
+        page_start_addr = managed_span_ptr->data();
 
         // 基本验证
         ASSERT_GE(first_block, page_start_addr);
@@ -518,48 +573,109 @@ TEST_F(CentralCacheTest, DeallocateFreesPageInternalCheck) {
     ASSERT_TRUE(all_allocated_blocks.empty()); // 确认 vector 清空
 
     // 5. 验证内部状态：span 应已从 central_cache 中移除
-    // (验证逻辑与之前相同)
     // 5a. 检查 m_page_set
     {
-        ASSERT_EQ(cache.m_page_set[index].count(page_start_addr), 0)
+        ASSERT_FALSE(has_span(index, page_start_addr))
             << "Page span starting at " << (void*)page_start_addr
             << " was *not* removed from m_page_set[" << index << "] after all its blocks were deallocated.";
     }
 
-    // 5b. 检查 m_free_array
-    {
-        std::byte* current_free = cache.m_free_array[index];
-        std::byte* page_end_addr = page_start_addr + page_original_size;
-        size_t blocks_found_from_freed_page = 0;
-        std::set<std::byte*> visited_free;
-
-        while (current_free != nullptr) {
-            if (!visited_free.insert(current_free).second) {
-                 ADD_FAILURE() << "Cycle detected in free list m_free_array[" << index << "] during verification at " << (void*)current_free;
-                 break;
-            }
-            if (current_free >= page_start_addr && current_free < page_end_addr) {
-                blocks_found_from_freed_page++;
-                 ADD_FAILURE() << "Block " << (void*)current_free << " from the supposedly freed page span ["
-                               << (void*)page_start_addr << ", " << (void*)page_end_addr
-                               << ") was found in the free list m_free_array[" << index << "].";
-            }
-            current_free = *(reinterpret_cast<std::byte**>(current_free));
-        }
-        ASSERT_EQ(blocks_found_from_freed_page, 0)
-            << blocks_found_from_freed_page << " block(s) belonging to the freed page span were found in the central cache's free list.";
-
-        // 5c. 检查 m_free_array_size
-        size_t reported_free_size = cache.m_free_array_size[index];
-        size_t actual_free_count = visited_free.size();
-        ASSERT_EQ(reported_free_size, actual_free_count)
-            << "m_free_array_size[" << index << "] (" << reported_free_size
-            << ") does not match the actual number of nodes in the free list ("
-            << actual_free_count << ") after page deallocation.";
-    }
+    // 5b. 每个页面自己管理空闲的内存块，剩下的页面都在正确的链表中
+    check_span_lists(index);
+
+    // 5c. 检查空闲内存块的计数
+    ASSERT_EQ(free_unit_count(index), count_free_units(index))
+        << "m_free_unit_count[" << index << "] does not match the free units of the remaining spans after page deallocation.";
 }
 // --- End NEW TEST ---
 
+// 优先从使用率最高的页面中分配，使用率低的页面可以变空并被归还
+TEST_F(CentralCacheTest, FullestSpanIsPreferred) {
+    const size_t alloc_size = 2048;
+    const size_t index = size_utils::get_index(alloc_size);
+    ASSERT_EQ(cache.get_span_selection_policy(), span_selection_policy::fullest);
+
+    // 把现有的部分分配的页面先填满，确保接下来的内存块来自新的页面
+    std::vector<std::vector<std::byte*>> fillers;
+    while (page_span* partial = any_partial_span(index)) {
+        auto filler = allocate_and_check(alloc_size, partial->total_unit_count() - partial->allocated_unit_count());
+        ASSERT_TRUE(filler.has_value());
+        fillers.push_back(list_to_vector(filler.value()));
+    }
+
+    // 占满两个新的页面
+    auto first = allocate_and_check(alloc_size, 1);
+    ASSERT_TRUE(first.has_value());
+    page_span* sparse_span = find_span(index, first.value());
+    ASSERT_NE(sparse_span, nullptr);
+    const size_t units = sparse_span->total_unit_count();
+    ASSERT_GE(units, 4);
+    auto rest = allocate_and_check(alloc_size, units - 1);
+    ASSERT_TRUE(rest.has_value());
+    std::vector<std::byte*> sparse_blocks = list_to_vector(rest.value());
+    sparse_blocks.push_back(first.value());
+    auto second = allocate_and_check(alloc_size, units);
+    ASSERT_TRUE(second.has_value());
+    std::vector<std::byte*> dense_blocks = list_to_vector(second.value());
+    page_span* dense_span = find_span(index, dense_blocks.front());
+    ASSERT_NE(dense_span, sparse_span);
+
+    // 第一个页面只留下一个内存块，第二个页面只空出一个内存块
+    std::byte* kept = sparse_blocks.back();
+    sparse_blocks.pop_back();
+    deallocate_vector(sparse_blocks, alloc_size);
+    std::byte* freed = dense_blocks.back();
+    dense_blocks.pop_back();
+    std::vector<std::byte*> single {freed};
+    deallocate_vector(single, alloc_size);
+
+    // 应该从使用率高的第二个页面中分配
+    auto next = allocate_and_check(alloc_size, 1);
+    ASSERT_TRUE(next.has_value());
+    EXPECT_EQ(find_span(index, next.value()), dense_span);
+    dense_blocks.push_back(next.value());
+
+    span_occupancy occupancy = cache.get_span_occupancy(alloc_size);
+    EXPECT_GE(occupancy.full_span_count, 1);
+    EXPECT_GE(occupancy.partial_span_count[0], 1);
+    EXPECT_LE(occupancy.allocated_unit_count, occupancy.total_unit_count);
+
+    std::vector<std::byte*> last {kept};
+    deallocate_vector(last, alloc_size);
+    deallocate_vector(dense_blocks, alloc_size);
+    for (auto& filler : fillers) {
+        deallocate_vector(filler, alloc_size);
+    }
+    check_span_lists(index);
+}
+
+// 交错地分配与回收多个页面中的内存块，每个页面都应该在与其使用情况相符的链表中
+TEST_F(CentralCacheTest, SpanListsStayConsistent) {
+    const size_t alloc_size = 1024;
+    const size_t index = size_utils::get_index(alloc_size);
+    std::vector<std::vector<std::byte*>> batches;
+    for (int i = 0; i < 16; i++) {
+        auto result = allocate_and_check(alloc_size, 64);
+        ASSERT_TRUE(result.has_value());
+        batches.push_back(list_to_vector(result.value()));
+    }
+    check_span_lists(index);
+    EXPECT_EQ(free_unit_count(index), count_free_units(index));
+
+    // 先回收一半的批次，使页面处于部分分配的状态
+    for (size_t i = 0; i < batches.size(); i += 2) {
+        deallocate_vector(batches[i], alloc_size);
+    }
+    check_span_lists(index);
+    EXPECT_EQ(free_unit_count(index), count_free_units(index));
+
+    for (auto& batch : batches) {
+        deallocate_vector(batch, alloc_size);
+    }
+    check_span_lists(index);
+    EXPECT_EQ(free_unit_count(index), count_free_units(index));
+}
+
 TEST_F(CentralCacheTest, AllocateDifferentSizes) {
     const size_t size1 = 16;
     const size_t count1 = 5;
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "heap_profiler.h"
+#include "memory_pool.h"
+
+using namespace memory_pool_v2;
+
+class HeapProfilerTest : public ::testing::Test {
+protected:
+    heap_profiler& profiler = heap_profiler::get_instance();
+
+    void SetUp() override {
+        profiler.clear();
+    }
+
+    void TearDown() override {
+        profiler.stop();
+        profiler.clear();
+    }
+
+    // 已经存在的线程要再申请很多字节以后才会发现开启了采样，所以在新的线程中申请
+    static std::vector<void*> allocate_in_new_thread(size_t count, size_t size) {
+        std::vector<void*> result;
+        std::thread worker([&] {
+            for (size_t i = 0; i < count; i++) {
+                result.push_back(memory_pool::allocate(size).value());
+            }
+        });
+        worker.join();
+        return result;
+    }
+};
+
+// 导出的符号，用于检查折叠的调用栈中能找到调用者
+std::vector<void*> heap_profiler_test_caller(size_t count, size_t size) {
+    std::vector<void*> result;
+    for (size_t i = 0; i < count; i++) {
+        result.push_back(memory_pool::allocate(size).value());
+    }
+    return result;
+}
+
+// 间隔为 1 时每次申请都会被采样，归还以后采样被移除，其他线程归还也一样
+TEST_F(HeapProfilerTest, EveryAllocationIsSampled) {
+    profiler.start(1);
+    auto ptrs = allocate_in_new_thread(100, 64);
+    EXPECT_EQ(profiler.live_sample_count(), 100);
+    for (auto& sample : profiler.live_samples()) {
+        EXPECT_EQ(sample.size, 64);
+        EXPECT_GT(sample.stack_depth, 0);
+    }
+    for (size_t i = 0; i < 50; i++) {
+        memory_pool::deallocate(ptrs[i], 64);
+    }
+    EXPECT_EQ(profiler.live_sample_count(), 50);
+    std::thread other([&] {
+        for (size_t i = 50; i < 100; i++) {
+            memory_pool::deallocate(ptrs[i], 64);
+        }
+    });
+    other.join();
+    EXPECT_EQ(profiler.live_sample_count(), 0);
+}
+
+// 没有开启时不会记录任何采样
+TEST_F(HeapProfilerTest, DisabledRecordsNothing) {
+    auto ptrs = allocate_in_new_thread(100, 64);
+    EXPECT_EQ(profiler.live_sample_count(), 0);
+    for (void* ptr : ptrs) {
+        EXPECT_FALSE(profiler.might_be_sampled(ptr));
+        memory_pool::deallocate(ptr, 64);
+    }
+}
+
+// 按调用栈合并以后输出，间隔为 1 时估算值就是实际值
+TEST_F(HeapProfilerTest, DumpFormats) {
+    profiler.start(1);
+    std::vector<void*> ptrs;
+    std::thread worker([&] { ptrs = heap_profiler_test_caller(100, 64); });
+    worker.join();
+
+    std::ostringstream pprof;
+    memory_pool::dump_heap_profile(pprof, heap_profile_format::pprof);
+    const std::string pprof_text = pprof.str();
+    EXPECT_EQ(pprof_text.rfind("heap profile: 100: 6400 [100: 6400] @ heapprofile\n", 0), 0) << pprof_text.substr(0, 200);
+    EXPECT_NE(pprof_text.find("\nMAPPED_LIBRARIES:\n"), std::string::npos);
+
+    std::ostringstream collapsed;
+    memory_pool::dump_heap_profile(collapsed, heap_profile_format::collapsed);
+    std::istringstream lines(collapsed.str());
+    std::string line;
+    size_t total = 0;
+    bool found_caller = false;
+    while (std::getline(lines, line)) {
+        const size_t space = line.rfind(' ');
+        ASSERT_NE(space, std::string::npos);
+        total += std::stoull(line.substr(space + 1));
+        found_caller |= line.find("heap_profiler_test_caller") != std::string::npos;
+    }
+    EXPECT_EQ(total, 6400);
+    EXPECT_TRUE(found_caller) << collapsed.str();
+
+    for (void* ptr : ptrs) {
+        memory_pool::deallocate(ptr, 64);
+    }
+}
+
+// 放大以后的估算值接近实际存活的字节数
+TEST_F(HeapProfilerTest, EstimateIsUnbiased) {
+    profiler.start(64 * 1024);
+    const size_t count = 1 << 20;
+    auto ptrs = allocate_in_new_thread(count, 64);
+    double estimated = 0;
+    for (auto& sample : profiler.live_samples()) {
+        estimated += sample.size / -std::expm1(-static_cast<double>(sample.size) / sample.sample_interval);
+    }
+    const double actual = static_cast<double>(count * 64);
+    EXPECT_NEAR(estimated / actual, 1.0, 0.15);
+    for (void* ptr : ptrs) {
+        memory_pool::deallocate(ptr, 64);
+    }
+    EXPECT_EQ(profiler.live_sample_count(), 0);
+}
+
+// 单独 mmap 的内存块使用 mremap 调整大小以后，采样跟着移动
+TEST_F(HeapProfilerTest, ReallocateMovesSample) {
+    profiler.start(1);
+    const size_t old_size = 8 * 1024 * 1024;
+    const size_t new_size = 32 * 1024 * 1024;
+    auto ptrs = allocate_in_new_thread(1, old_size);
+    auto grown = memory_pool::reallocate(ptrs[0], old_size, new_size);
+    ASSERT_TRUE(grown.has_value());
+    auto samples = profiler.live_samples();
+    ASSERT_EQ(samples.size(), 1);
+    EXPECT_EQ(samples[0].size, new_size);
+    EXPECT_TRUE(profiler.might_be_sampled(grown.value()));
+    memory_pool::deallocate(grown.value(), new_size);
+    EXPECT_EQ(profiler.live_sample_count(), 0);
+}
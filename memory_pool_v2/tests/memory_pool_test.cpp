@@ -1,6 +1,8 @@
 // 该内容由 gemini 2.5 pro preview 03-25 生成，https://aistudio.google.com/prompts/new_chat
 #include "memory_pool.h" // Include the top-level header
 #include "utils.h"      // Include utils for constants and alignment functions
+#include "pool_allocator.h"
+#include "central_cache.h"
 
 #include <gtest/gtest.h>
 #include <vector>
@@ -10,8 +12,12 @@
 #include <map>
 #include <future>
 #include <atomic>
+#include <cstdlib>
 #include <cstring> // For memset
+#include <fstream>
+#include <sstream>
 #include <limits>  // For numeric_limits
+#include <latch>
 
 
 
@@ -454,5 +460,590 @@ TEST(MemoryPoolTest, AllocationFailure) {
     ASSERT_FALSE(ptr_opt.has_value()) << "Allocation of extremely large size (" << huge_size << ") unexpectedly succeeded.";
 }
 
+// 大内存块按页对齐，回收以后会缓存在线程中，再次申请相同页数的内存块时直接复用
+TEST(MemoryPoolTest, LargeObjectIsCachedPerThread) {
+    const size_t size = 100 * 1024 + 1;
+    auto first = memory_pool_v2::memory_pool::allocate(size);
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first.value()) % memory_pool_v2::size_utils::PAGE_SIZE, 0);
+    memset(first.value(), 0xAB, size);
+    memory_pool_v2::memory_pool::deallocate(first.value(), size);
+
+    // 页数相同的不同大小也可以复用
+    const size_t same_pages_size = 100 * 1024 + 2048;
+    auto second = memory_pool_v2::memory_pool::allocate(same_pages_size);
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(second.value(), first.value());
+    memory_pool_v2::memory_pool::deallocate(second.value(), same_pages_size);
+}
+
+// 超大的内存块单独 mmap，回收时直接归还给系统
+TEST(MemoryPoolTest, VeryLargeObjectIsDirectlyMapped) {
+    auto& pages = memory_pool_v2::page_cache::get_instance();
+    const size_t size = pages.direct_map_threshold() + 1;
+    const size_t before = pages.direct_mapped_bytes();
+    auto ptr = memory_pool_v2::memory_pool::allocate(size);
+    ASSERT_TRUE(ptr.has_value());
+    EXPECT_GE(pages.direct_mapped_bytes(), before + size);
+    memset(ptr.value(), 0xCD, size);
+    memory_pool_v2::memory_pool::deallocate(ptr.value(), size);
+    EXPECT_EQ(pages.direct_mapped_bytes(), before);
+}
+
+// 在一个线程中申请、在另一个线程中回收大内存块，线程退出时缓存的内存块还给中心缓存
+TEST(MemoryPoolTest, LargeObjectCrossThread) {
+    std::vector<std::pair<void*, size_t>> blocks;
+    std::thread producer([&blocks] {
+        for (size_t i = 0; i < 64; i++) {
+            const size_t size = memory_pool_v2::size_utils::MAX_CACHED_UNIT_SIZE + 1 + i * 12345;
+            auto ptr = memory_pool_v2::memory_pool::allocate(size);
+            ASSERT_TRUE(ptr.has_value());
+            memset(ptr.value(), static_cast<int>(i), size);
+            blocks.emplace_back(ptr.value(), size);
+        }
+    });
+    producer.join();
+    ASSERT_EQ(blocks.size(), 64);
+
+    std::thread consumer([&blocks] {
+        for (auto [ptr, size] : blocks) {
+            memory_pool_v2::memory_pool::deallocate(ptr, size);
+        }
+    });
+    consumer.join();
+
+    // 退出的线程缓存的内存块可以被其他线程继续使用
+    for (auto [ptr, size] : blocks) {
+        auto again = memory_pool_v2::memory_pool::allocate(size);
+        ASSERT_TRUE(again.has_value());
+        memset(again.value(), 0xEF, size);
+        memory_pool_v2::memory_pool::deallocate(again.value(), size);
+    }
+}
+
+// 超大的内存块使用 mremap 调整大小，内容保持不变
+TEST(MemoryPoolTest, ReallocateDirectlyMapped) {
+    auto& pages = memory_pool_v2::page_cache::get_instance();
+    const size_t before = pages.direct_mapped_bytes();
+    size_t size = pages.direct_map_threshold() + 1;
+    auto ptr = memory_pool_v2::memory_pool::allocate(size);
+    ASSERT_TRUE(ptr.has_value());
+    memset(ptr.value(), 0x11, size);
+
+    // 反复翻倍，每一次都检查原来的内容
+    for (int i = 0; i < 4; i++) {
+        auto grown = memory_pool_v2::memory_pool::reallocate(ptr.value(), size, size * 2);
+        ASSERT_TRUE(grown.has_value());
+        ptr = grown;
+        auto data = static_cast<unsigned char*>(ptr.value());
+        ASSERT_EQ(data[0], 0x11);
+        ASSERT_EQ(data[size - 1], 0x11);
+        memset(data + size, 0x11, size);
+        size *= 2;
+        EXPECT_GE(pages.direct_mapped_bytes(), before + size);
+    }
+
+    // 缩小到阈值以下时会复制到页面中
+    const size_t small_size = 64 * 1024;
+    auto shrunk = memory_pool_v2::memory_pool::reallocate(ptr.value(), size, small_size);
+    ASSERT_TRUE(shrunk.has_value());
+    EXPECT_EQ(pages.direct_mapped_bytes(), before);
+    EXPECT_EQ(static_cast<unsigned char*>(shrunk.value())[small_size - 1], 0x11);
+    memory_pool_v2::memory_pool::deallocate(shrunk.value(), small_size);
+}
+
+// 小内存块的 reallocate 会复制内容，同一个规格内直接返回原来的地址
+TEST(MemoryPoolTest, ReallocateSmall) {
+    auto ptr = memory_pool_v2::memory_pool::allocate(20);
+    ASSERT_TRUE(ptr.has_value());
+    memset(ptr.value(), 0x22, 20);
+    auto same = memory_pool_v2::memory_pool::reallocate(ptr.value(), 20, 24);
+    ASSERT_TRUE(same.has_value());
+    EXPECT_EQ(same.value(), ptr.value());
+
+    auto grown = memory_pool_v2::memory_pool::reallocate(same.value(), 24, 1000);
+    ASSERT_TRUE(grown.has_value());
+    EXPECT_EQ(static_cast<unsigned char*>(grown.value())[19], 0x22);
+    memory_pool_v2::memory_pool::deallocate(grown.value(), 1000);
+}
+
+// 大小调整为 0 时归还原来的空间并返回 nullptr，与失败时的 nullopt 区分开
+TEST(MemoryPoolTest, ReallocateToZeroFrees) {
+    for (size_t size : {64, 64 * 1024}) {
+        auto ptr = memory_pool_v2::memory_pool::allocate(size);
+        ASSERT_TRUE(ptr.has_value());
+        auto freed = memory_pool_v2::memory_pool::reallocate(ptr.value(), size, 0);
+        ASSERT_TRUE(freed.has_value());
+        EXPECT_EQ(freed.value(), nullptr);
+        // value_or 的常见用法不会留下已经失效的地址
+        EXPECT_EQ(freed.value_or(ptr.value()), nullptr);
+    }
+}
+
+// 修改阈值以后，之前单独 mmap 的内存块仍然能被正确回收
+TEST(MemoryPoolTest, DirectMapThresholdChange) {
+    auto& pages = memory_pool_v2::page_cache::get_instance();
+    const size_t old_threshold = pages.direct_map_threshold();
+    const size_t before = pages.direct_mapped_bytes();
+    memory_pool_v2::memory_pool::set_direct_map_threshold(256 * 1024);
+    // 其他测试没有用过的页数，确保不会从缓存中取到
+    const size_t size = 900 * 1024 + 1;
+    auto ptr = memory_pool_v2::memory_pool::allocate(size);
+    ASSERT_TRUE(ptr.has_value());
+    EXPECT_GE(pages.direct_mapped_bytes(), before + size);
+    memory_pool_v2::memory_pool::set_direct_map_threshold(old_threshold);
+    memory_pool_v2::memory_pool::deallocate(ptr.value(), size);
+    // 可能被缓存在线程缓存中，取出来以后仍然是同一块
+    auto again = memory_pool_v2::memory_pool::allocate(size);
+    ASSERT_TRUE(again.has_value());
+    memset(again.value(), 0x33, size);
+    memory_pool_v2::memory_pool::deallocate(again.value(), size);
+}
+
+// 统计信息快照反映各层的变化，统计时其他线程可以继续分配
+TEST(MemoryPoolTest, StatsSnapshot) {
+    using memory_pool_v2::memory_pool;
+    auto find_class = [](const memory_pool_v2::memory_pool_stats& stats, size_t memory_size) {
+        for (auto& size_class : stats.size_classes) {
+            if (size_class.memory_size == memory_size) {
+                return size_class;
+            }
+        }
+        return memory_pool_v2::size_class_stats {};
+    };
+    const size_t size = 3000;
+    const size_t count = 10;
+    auto before = memory_pool::stats();
+    std::vector<void*> ptrs;
+    for (size_t i = 0; i < count; i++) {
+        auto ptr = memory_pool::allocate(size);
+        ASSERT_TRUE(ptr.has_value());
+        ptrs.push_back(ptr.value());
+    }
+
+    auto allocated = memory_pool::stats();
+    auto size_class = find_class(allocated, size);
+    EXPECT_GE(allocated.thread_count, 1);
+    EXPECT_GT(size_class.refill_count, find_class(before, size).refill_count);
+    EXPECT_GE(size_class.span_count, 1);
+    EXPECT_EQ(size_class.span_bytes % memory_pool_v2::size_utils::PAGE_SIZE, 0);
+    // 空闲的与正在使用的内存块都在这个规格的页面中
+    EXPECT_LE((size_class.thread_cache_count + size_class.central_cache_count + count) * size, size_class.span_bytes);
+    EXPECT_EQ(size_class.thread_cache_bytes, size_class.thread_cache_count * size);
+    EXPECT_GE(allocated.span_bytes, size_class.span_bytes);
+    EXPECT_GE(allocated.pages.mapped_bytes, allocated.span_bytes + allocated.pages.free_bytes);
+
+    for (void* ptr : ptrs) {
+        memory_pool::deallocate(ptr, size);
+    }
+    auto freed = find_class(memory_pool::stats(), size);
+    EXPECT_EQ(freed.thread_cache_count, size_class.thread_cache_count + count);
+
+    // 单独 mmap 的大内存块
+    const size_t large_size = 8 * 1024 * 1024;
+    auto large = memory_pool::allocate(large_size);
+    ASSERT_TRUE(large.has_value());
+    auto large_stats = memory_pool::stats().large;
+    EXPECT_GE(large_stats.direct_mapped_count, 1);
+    EXPECT_GE(large_stats.direct_mapped_bytes, large_size);
+    memory_pool::deallocate(large.value(), large_size);
+
+    // 统计与分配同时进行
+    std::atomic<bool> done = false;
+    std::thread reader([&] {
+        while (!done.load()) {
+            auto stats = memory_pool::stats();
+            EXPECT_LE(stats.pages.committed_bytes, stats.pages.mapped_bytes);
+        }
+    });
+    for (size_t i = 0; i < 100000; i++) {
+        auto ptr = memory_pool::allocate(i % 2048 + 1);
+        ASSERT_TRUE(ptr.has_value());
+        memory_pool::deallocate(ptr.value(), i % 2048 + 1);
+    }
+    done = true;
+    reader.join();
+}
+
+// 线程退出时缓存的小内存块还给中心缓存，不会随着线程一起丢失
+TEST(MemoryPoolTest, ExitingThreadReturnsCachedBlocks) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 5432;
+    auto find_class = [size] {
+        for (auto& size_class : memory_pool::stats().size_classes) {
+            if (size_class.memory_size == memory_pool_v2::size_utils::align(size)) {
+                return size_class;
+            }
+        }
+        return memory_pool_v2::size_class_stats {};
+    };
+    const size_t thread_count_before = memory_pool::stats().thread_count;
+    for (int round = 0; round < 3; round++) {
+        std::thread worker([&] {
+            std::vector<void*> ptrs;
+            for (size_t i = 0; i < 20; i++) {
+                auto ptr = memory_pool::allocate(size);
+                ASSERT_TRUE(ptr.has_value());
+                memset(ptr.value(), 0x5A, size);
+                ptrs.push_back(ptr.value());
+            }
+            for (void* ptr : ptrs) {
+                memory_pool::deallocate(ptr, size);
+            }
+            EXPECT_GE(find_class().thread_cache_count, 20);
+            EXPECT_GE(find_class().span_count, 1);
+        });
+        worker.join();
+        // 所有的内存块都回到了页面中，空的页面还给了页缓存
+        EXPECT_EQ(find_class().thread_cache_count, 0);
+        EXPECT_EQ(find_class().span_count, 0);
+    }
+    EXPECT_EQ(memory_pool::stats().thread_count, thread_count_before);
+}
+
+// 标准库容器通过适配器使用内存池，元素的地址都由内存池管理
+TEST(MemoryPoolTest, PoolAllocatorWithContainers) {
+    using memory_pool_v2::pool_allocator;
+    std::vector<int, pool_allocator<int>> numbers;
+    for (int i = 0; i < 10000; i++) {
+        numbers.push_back(i);
+    }
+    EXPECT_EQ(std::accumulate(numbers.begin(), numbers.end(), 0LL), 49995000LL);
+
+    std::map<int, std::vector<int, pool_allocator<int>>, std::less<>, pool_allocator<std::pair<const int, std::vector<int, pool_allocator<int>>>>> groups;
+    for (int i = 0; i < 1000; i++) {
+        groups[i % 37].push_back(i);
+    }
+    EXPECT_EQ(groups.size(), 37);
+    EXPECT_EQ(groups[0].size(), 28);
+    groups.clear();
+    numbers = {};
+}
+
+// 适配器没有状态，重新绑定到其他类型以后仍然相等
+TEST(MemoryPoolTest, PoolAllocatorRebindEquality) {
+    using memory_pool_v2::pool_allocator;
+    pool_allocator<int> a;
+    pool_allocator<double> b(a);
+    EXPECT_TRUE(a == b);
+    double* values = b.allocate(3000);
+    ASSERT_NE(values, nullptr);
+    values[2999] = 1.5;
+    b.deallocate(values, 3000);
+}
+
+// 预热以后在线程缓存的上限以内申请，不需要再向中心缓存补充
+TEST(MemoryPoolTest, ReserveFillsThreadCache) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 4008;
+    const size_t count = 40;
+    std::thread worker([&] {
+        auto find_class = [size] {
+            for (auto& size_class : memory_pool::stats().size_classes) {
+                if (size_class.memory_size == size) {
+                    return size_class;
+                }
+            }
+            return memory_pool_v2::size_class_stats {};
+        };
+        ASSERT_TRUE(memory_pool::reserve(size, count));
+        const auto warmed = find_class();
+        EXPECT_GE(warmed.thread_cache_count, count);
+
+        std::vector<void*> ptrs;
+        for (size_t i = 0; i < count; i++) {
+            auto ptr = memory_pool::allocate(size);
+            ASSERT_TRUE(ptr.has_value());
+            ptrs.push_back(ptr.value());
+        }
+        EXPECT_EQ(find_class().refill_count, warmed.refill_count);
+        for (void* ptr : ptrs) {
+            memory_pool::deallocate(ptr, size);
+        }
+    });
+    worker.join();
+}
+
+// 超过线程缓存上限的部分留在中心缓存中，而不是还给页缓存
+TEST(MemoryPoolTest, ReserveKeepsSpansInCentralCache) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 8008;
+    const size_t count = 200;
+    std::thread worker([&] {
+        ASSERT_TRUE(memory_pool::reserve(size, count, false));
+        for (auto& size_class : memory_pool::stats().size_classes) {
+            if (size_class.memory_size == size) {
+                EXPECT_GE(size_class.thread_cache_count + size_class.central_cache_count, count);
+                EXPECT_GT(size_class.span_count, 0);
+            }
+        }
+    });
+    worker.join();
+}
+
+// 多个线程同时预热时，每个线程的页面都留在中心缓存中，也不会改变全局的延迟归还设置
+TEST(MemoryPoolTest, ConcurrentReserve) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 6008;
+    const size_t count = 200;
+    const size_t threads = 4;
+    std::latch reserved(threads + 1);
+    std::latch checked(1);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            EXPECT_TRUE(memory_pool::reserve(size, count, false));
+            reserved.count_down();
+            // 等待统计结束再退出，退出时线程缓存会把内存块还给中心缓存
+            checked.wait();
+        });
+    }
+    reserved.arrive_and_wait();
+    EXPECT_FALSE(memory_pool_v2::central_cache::get_instance().defer_span_release());
+    for (auto& size_class : memory_pool::stats().size_classes) {
+        if (size_class.memory_size == size) {
+            // 先结束预热的线程归还的内存块可能被其他线程重新申请，所以只能保证至少有一个线程的量
+            EXPECT_GE(size_class.thread_cache_count + size_class.central_cache_count, count);
+            EXPECT_GT(size_class.span_count, 0);
+        }
+    }
+    checked.count_down();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+TEST(MemoryPoolTest, PrewarmProfile) {
+    using memory_pool_v2::memory_pool;
+    memory_pool_v2::prewarm_profile profile;
+    profile.page_bytes = 4 * 1024 * 1024;
+    profile.entries = {{24, 20000}, {100 * 1024, 4}};
+    std::thread worker([&] {
+        ASSERT_TRUE(memory_pool::prewarm(profile));
+        EXPECT_GE(memory_pool::stats().pages.free_bytes, profile.page_bytes);
+        void* ptr = memory_pool::allocate(24).value_or(nullptr);
+        ASSERT_NE(ptr, nullptr);
+        memory_pool::deallocate(ptr, 24);
+    });
+    worker.join();
+    EXPECT_TRUE(memory_pool::reserve(0, 10));
+}
+
+// 保存学习到的需求，读取以后新的线程第一次就按学习到的个数申请
+TEST(MemoryPoolTest, AllocationProfileRoundTrip) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 7000;
+    const std::string path = testing::TempDir() + "memory_pool_allocation_profile.txt";
+    auto thread_cache_count = [size] {
+        for (auto& size_class : memory_pool::stats().size_classes) {
+            if (size_class.memory_size == size) {
+                return size_class.thread_cache_count;
+            }
+        }
+        return size_t {0};
+    };
+
+    std::thread learner([&] {
+        std::vector<void*> ptrs;
+        for (size_t i = 0; i < 300; i++) {
+            auto ptr = memory_pool::allocate(size);
+            ASSERT_TRUE(ptr.has_value());
+            ptrs.push_back(ptr.value());
+        }
+        for (void* ptr : ptrs) {
+            memory_pool::deallocate(ptr, size);
+        }
+    });
+    learner.join();
+    ASSERT_TRUE(memory_pool::save_allocation_profile(path));
+
+    size_t batch_count = 0;
+    size_t peak_count = 0;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            size_t memory_size = 0;
+            if (line[0] != '#' && fields >> memory_size && memory_size == size) {
+                fields >> batch_count >> peak_count;
+            }
+        }
+    }
+    EXPECT_GT(batch_count, 4);
+    EXPECT_GE(peak_count, 300);
+
+    ASSERT_TRUE(memory_pool::load_allocation_profile(path, false));
+    std::thread worker([&] {
+        const size_t before = thread_cache_count();
+        void* ptr = memory_pool::allocate(size).value_or(nullptr);
+        ASSERT_NE(ptr, nullptr);
+        EXPECT_EQ(thread_cache_count() - before, batch_count - 1);
+        memory_pool::deallocate(ptr, size);
+    });
+    worker.join();
+    memory_pool_v2::thread_cache::set_initial_allocate_count(size, 0);
+
+    // 格式不正确的文件不做任何修改
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << "7000 not numbers\n";
+    }
+    EXPECT_FALSE(memory_pool::load_allocation_profile(path));
+    EXPECT_FALSE(memory_pool::load_allocation_profile(path + ".missing"));
+    std::remove(path.c_str());
+}
+
+// 默认同时预热时，保存的组数不会被预热改变
+TEST(MemoryPoolTest, AllocationProfilePrewarmKeepsGroupCount) {
+    using memory_pool_v2::memory_pool;
+    const size_t size = 5008;
+    const size_t group_count = 5;
+    const std::string path = testing::TempDir() + "memory_pool_allocation_profile_prewarm.txt";
+    {
+        std::ofstream out(path, std::ios::trunc);
+        out << size << " 16 64 " << group_count << "\n";
+    }
+    ASSERT_TRUE(memory_pool::load_allocation_profile(path));
+
+    // 新的线程申请时直接使用预热留下的页面
+    std::thread worker([&] {
+        void* ptr = memory_pool::allocate(size).value_or(nullptr);
+        ASSERT_NE(ptr, nullptr);
+        memory_pool::deallocate(ptr, size);
+    });
+    worker.join();
+    ASSERT_TRUE(memory_pool::save_allocation_profile(path));
+
+    size_t saved_group_count = 0;
+    {
+        std::ifstream in(path);
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            size_t memory_size = 0;
+            size_t batch_count = 0;
+            size_t peak_count = 0;
+            if (line[0] != '#' && fields >> memory_size >> batch_count >> peak_count && memory_size == size) {
+                fields >> saved_group_count;
+            }
+        }
+    }
+#ifdef NDEBUG
+    EXPECT_EQ(saved_group_count, group_count);
+#else
+    // 调试模式下每个页面的大小是固定的，不记录组数
+    EXPECT_EQ(saved_group_count, 0);
+#endif
+    memory_pool_v2::thread_cache::set_initial_allocate_count(size, 0);
+    std::remove(path.c_str());
+}
+
+TEST(MemoryPoolTest, RuntimeConfig) {
+    using memory_pool_v2::memory_pool;
+    using memory_pool_v2::memory_pool_config;
+    memory_pool_config config;
+    EXPECT_TRUE(config.is_valid());
+    EXPECT_TRUE(config.set("max_free_bytes_per_list", "1M"));
+    EXPECT_TRUE(config.set("class_max_free_bytes", "64=2M,4096=16K"));
+    EXPECT_EQ(config.max_free_bytes_per_list, 1024 * 1024);
+    ASSERT_EQ(config.class_max_free_bytes.size(), 2);
+    EXPECT_EQ(config.class_max_free_bytes[0].first, 64);
+    EXPECT_EQ(config.class_max_free_bytes[0].second, 2 * 1024 * 1024);
+    EXPECT_TRUE(config.is_valid());
+
+    // 名称或格式不正确时不做修改
+    EXPECT_FALSE(config.set("unknown", "1"));
+    EXPECT_FALSE(config.set("min_batch_count", "four"));
+    EXPECT_FALSE(config.set("class_max_free_bytes", "64"));
+    EXPECT_FALSE(config.set("page_allocate_count", "17179869184G"));
+    EXPECT_FALSE(config.set("page_allocate_count", "99999999999999999999"));
+    EXPECT_EQ(config.min_batch_count, memory_pool_config::DEFAULT_MIN_BATCH_COUNT);
+    EXPECT_EQ(config.class_max_free_bytes.size(), 2);
+
+    // 空闲链表放不下两个内存块、大小不是 8 的倍数或者超过 MAX_CACHED_UNIT_SIZE 都不合法
+    memory_pool_config invalid;
+    invalid.class_max_free_bytes = {{4096, 4096}};
+    EXPECT_FALSE(invalid.is_valid());
+    invalid = {};
+    invalid.max_cached_unit_size = 1001;
+    EXPECT_FALSE(invalid.is_valid());
+    invalid = {};
+    invalid.max_cached_unit_size = 32 * 1024;
+    EXPECT_FALSE(invalid.is_valid());
+    invalid = {};
+    invalid.min_batch_count = 0;
+    EXPECT_FALSE(invalid.is_valid());
+
+    // 环境变量中不合法的参数全部使用默认值
+    setenv("MEMORY_POOL_MIN_BATCH_COUNT", "16", 1);
+    EXPECT_EQ(memory_pool_config::from_environment().min_batch_count, 16);
+    setenv("MEMORY_POOL_MAX_FREE_BYTES_PER_LIST", "16K", 1);
+    EXPECT_EQ(memory_pool_config::from_environment().min_batch_count, memory_pool_config::DEFAULT_MIN_BATCH_COUNT);
+    unsetenv("MEMORY_POOL_MIN_BATCH_COUNT");
+    unsetenv("MEMORY_POOL_MAX_FREE_BYTES_PER_LIST");
+
+    // 已经申请过内存以后参数不能再改变
+    void* ptr = memory_pool::allocate(64).value_or(nullptr);
+    ASSERT_NE(ptr, nullptr);
+    memory_pool::deallocate(ptr, 64);
+    EXPECT_FALSE(memory_pool::configure(config));
+    EXPECT_EQ(memory_pool::get_config().max_free_bytes_per_list, memory_pool_config::DEFAULT_MAX_FREE_BYTES_PER_LIST);
+    EXPECT_EQ(memory_pool_v2::runtime_config::max_free_bytes(memory_pool_v2::size_utils::get_index(64)),
+              memory_pool_config::DEFAULT_MAX_FREE_BYTES_PER_LIST);
+}
+
+// 设置参数以后的检查，返回第一个失败的步骤，全部通过时返回 0
+// 参数在第一次申请内存时生效，必须在还没有使用过内存池的进程中执行
+static int check_configured_pool() {
+    using memory_pool_v2::memory_pool;
+    constexpr size_t size = 64;
+    memory_pool_v2::memory_pool_config config;
+    // 64 字节的空闲链表最多保存 8 个内存块，最少一次申请的个数大于这个上限
+    config.class_max_free_bytes = {{size, size * 8}};
+    config.min_batch_count = 16;
+    if (!memory_pool::configure(config)) return 1;
+    if (memory_pool::get_config().min_batch_count != 16) return 2;
+
+    auto find_class = [] {
+        for (const auto& size_class : memory_pool::stats().size_classes) {
+            if (size_class.memory_size == size) {
+                return size_class;
+            }
+        }
+        return memory_pool_v2::size_class_stats {};
+    };
+
+    // 第一次申请的个数被限制为上限的一半（4 个），而不是 min_batch_count
+    void* first = memory_pool::allocate(size).value_or(nullptr);
+    if (first == nullptr) return 3;
+    if (find_class().refill_count != 1) return 4;
+    if (find_class().thread_cache_count != 3) return 5;
+
+    // 归还的内存块超过上限时批量还给中心缓存，默认的上限下不会发生
+    std::vector<void*> ptrs = {first};
+    for (int i = 0; i < 100; i++) {
+        void* ptr = memory_pool::allocate(size).value_or(nullptr);
+        if (ptr == nullptr) return 6;
+        ptrs.push_back(ptr);
+    }
+    for (void* ptr : ptrs) {
+        memory_pool::deallocate(ptr, size);
+    }
+    const auto freed = find_class();
+    if (freed.overflow_count == 0) return 7;
+    if (freed.thread_cache_count > 8) return 8;
+
+    // 已经生效以后不能再修改
+    if (memory_pool::configure({})) return 9;
+    return 0;
+}
+
+TEST(MemoryPoolTest, RuntimeConfigTakesEffect) {
+    // threadsafe 模式下子进程会重新启动，执行到这里时还没有使用过内存池
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(std::exit(check_configured_pool()), ::testing::ExitedWithCode(0), "");
+}
+
 // === Main function (provided by GTest::gtest_main) ===
 // No need to write main() if linking against GTest::gtest_main
\ No newline at end of file
@@ -351,4 +351,108 @@ TEST_F(PageCacheTest, AllocateZeroPages) {
          // If the fixed code *always* returns nullopt for 0:
          // ASSERT_FALSE(span_opt.has_value());
      });
-}
\ No newline at end of file
+}
+
+// 每种页面准备策略申请出来的页面都应该是全零且可写的
+TEST_F(PageCacheTest, ProvisionPolicies) {
+    const page_provision_policy policies[] = {
+        page_provision_policy::lazy,
+        page_provision_policy::zero_fill,
+        page_provision_policy::populate,
+        page_provision_policy::locked,
+        page_provision_policy::no_reserve,
+    };
+    const page_provision_policy old_policy = cache.provision_policy();
+    // 在全部检查完之前不归还，确保每种策略都会向系统申请新的页面
+    std::vector<memory_span> spans;
+    for (auto policy : policies) {
+        cache.set_provision_policy(policy);
+        ASSERT_EQ(cache.provision_policy(), policy);
+        // 比一次申请的页面数更多，确保会向系统申请新的页面
+        const size_t num_pages = page_cache::PAGE_ALLOCATE_COUNT * 3 + 1;
+        auto span_opt = cache.allocate_page(num_pages);
+        check_span(span_opt, num_pages);
+        std::byte* data = span_opt->data();
+        for (size_t offset = 0; offset < span_opt->size(); offset += 1024 * PAGE_SIZE) {
+            ASSERT_EQ(static_cast<unsigned char>(data[offset]), 0);
+            data[offset] = std::byte{0x7F};
+        }
+        spans.push_back(span_opt.value());
+    }
+    for (auto& span : spans) {
+        cache.deallocate_page(span);
+    }
+    cache.set_provision_policy(old_policy);
+}
+
+// 大页模式下向系统申请的页面按 2MB 对齐，归还给系统时只归还完整的大页
+TEST_F(PageCacheTest, HugePageMode) {
+    cache.set_huge_page_mode(true);
+    ASSERT_TRUE(cache.huge_page_mode());
+
+    // 比之前所有测试申请过的页面都多，确保会向系统申请新的页面（lazy 策略下只占用虚拟地址空间）
+    const size_t num_pages = page_cache::PAGE_ALLOCATE_COUNT * 64 + 1;
+    auto span_opt = cache.allocate_page(num_pages);
+    check_span(span_opt, num_pages);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(span_opt->data()) % page_cache::HUGE_PAGE_SIZE, 0);
+    cache.deallocate_page(span_opt.value());
+
+    const size_t released = cache.release_idle_pages(std::chrono::seconds(0), SIZE_MAX);
+    EXPECT_EQ(released % page_cache::HUGE_PAGE_SIZE, 0);
+    EXPECT_GE(released, num_pages * PAGE_SIZE / page_cache::HUGE_PAGE_SIZE * page_cache::HUGE_PAGE_SIZE);
+
+    cache.set_huge_page_mode(false);
+}
+
+// 预留地址空间以后的检查，返回第一个失败的步骤，全部通过时返回 0
+// 页缓存是全局的，必须在还没有申请过页面的进程中执行
+static int check_reserved_address_space() {
+    page_cache& cache = page_cache::get_instance();
+    const size_t page_size = size_utils::PAGE_SIZE;
+    if (!cache.reserve_address_space(1024 * 1024 * 1024)) return 1;
+    // 只能预留一次
+    if (cache.reserve_address_space(1024 * 1024 * 1024)) return 2;
+
+    // 每次正好用完一次提交的页面，后一次提交的页面紧跟在前一次的后面
+    auto first = cache.allocate_page(page_cache::PAGE_ALLOCATE_COUNT);
+    auto second = cache.allocate_page(page_cache::PAGE_ALLOCATE_COUNT);
+    if (!first.has_value() || !second.has_value()) return 3;
+    if (second->data() != first->data() + first->size()) return 4;
+    if (!cache.owns(first->data()) || !cache.owns(second->data() + second->size() - 1)) return 5;
+    int local = 0;
+    if (cache.owns(&local)) return 6;
+
+    // 两次提交的页面可以跨过提交的边界合并
+    cache.deallocate_page(first.value());
+    cache.deallocate_page(second.value());
+    auto merged = cache.allocate_page(page_cache::PAGE_ALLOCATE_COUNT * 2);
+    if (!merged.has_value() || merged->data() != first->data()) return 7;
+
+    // 页面映射
+    if (cache.page_owner(merged->data()) != nullptr) return 8;
+    cache.set_page_owner(merged->subspan(page_size, 2 * page_size), &local);
+    if (cache.page_owner(merged->data() + page_size) != &local) return 9;
+    if (cache.page_owner(merged->data() + 3 * page_size - 1) != &local) return 10;
+    if (cache.page_owner(merged->data() + 3 * page_size) != nullptr) return 11;
+    cache.set_page_owner(merged->subspan(page_size, 2 * page_size), nullptr);
+    if (cache.page_owner(merged->data() + page_size) != nullptr) return 12;
+    cache.deallocate_page(merged.value());
+
+    // 预留的空间用完以后退回到单独向系统申请
+    auto large = cache.allocate_page(1024 * 1024 * 1024 / page_size + 1);
+    if (!large.has_value() || !cache.owns(large->data())) return 13;
+    cache.deallocate_page(large.value());
+    return 0;
+}
+
+TEST_F(PageCacheTest, ReservedAddressSpace) {
+    // threadsafe 模式下子进程会重新启动，执行到这里时还没有申请过页面
+    GTEST_FLAG_SET(death_test_style, "threadsafe");
+    EXPECT_EXIT(std::exit(check_reserved_address_space()), ::testing::ExitedWithCode(0), "");
+
+    // 当前进程已经申请过页面了，不能再预留
+    auto span_opt = cache.allocate_page(1);
+    check_span(span_opt, 1);
+    EXPECT_FALSE(cache.reserve_address_space(1024 * 1024 * 1024));
+    cache.deallocate_page(span_opt.value());
+}
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "central_cache.h"
+#include "memory_pool.h"
+#include "page_cache.h"
+#include "scavenger.h"
+#include "utils.h"
+
+using namespace memory_pool_v2;
+using namespace std::chrono_literals;
+
+class ScavengerTest : public ::testing::Test {
+protected:
+    page_cache& pages = page_cache::get_instance();
+    central_cache& central = central_cache::get_instance();
+    static constexpr size_t PAGE_SIZE = size_utils::PAGE_SIZE;
+
+    void TearDown() override {
+        scavenger::get_instance().stop();
+    }
+};
+
+// 刚刚释放的页面不应该被归还
+TEST_F(ScavengerTest, IdleThresholdIsRespected) {
+    auto span = pages.allocate_page(4);
+    ASSERT_TRUE(span.has_value());
+    pages.deallocate_page(span.value());
+
+    EXPECT_EQ(pages.release_idle_pages(1h, SIZE_MAX), 0);
+}
+
+// 空闲的页面被归还以后，再次分配出去时会计入重新缺页的字节数
+TEST_F(ScavengerTest, ReleaseAndRefaultCounters) {
+    auto span = pages.allocate_page(16);
+    ASSERT_TRUE(span.has_value());
+    memset(span->data(), 0xAB, span->size());
+    pages.deallocate_page(span.value());
+
+    const size_t released_before = pages.total_released_bytes();
+    size_t released = pages.release_idle_pages(0ms, SIZE_MAX);
+    EXPECT_GE(released, 16 * PAGE_SIZE);
+    EXPECT_EQ(pages.total_released_bytes(), released_before + released);
+    EXPECT_GE(pages.released_bytes(), 16 * PAGE_SIZE);
+
+    // 全部都已经归还了，再归还一次不会有新的字节
+    EXPECT_EQ(pages.release_idle_pages(0ms, SIZE_MAX), 0);
+
+    const size_t refaulted_before = pages.total_refaulted_bytes();
+    auto again = pages.allocate_page(16);
+    ASSERT_TRUE(again.has_value());
+    EXPECT_GT(pages.total_refaulted_bytes(), refaulted_before);
+    // 归还给操作系统的页面再次访问时为全零
+    EXPECT_EQ(static_cast<unsigned char>(again->data()[0]), 0);
+    memset(again->data(), 0xCD, again->size());
+    pages.deallocate_page(again.value());
+}
+
+// 一次归还的字节数不会超过限制
+TEST_F(ScavengerTest, ReleaseIsCappedByBudget) {
+    auto span = pages.allocate_page(32);
+    ASSERT_TRUE(span.has_value());
+    pages.deallocate_page(span.value());
+
+    size_t released = pages.release_idle_pages(0ms, 4 * PAGE_SIZE);
+    EXPECT_LE(released, 4 * PAGE_SIZE);
+}
+
+// 开启延迟归还以后，空的页面留在中心缓存中，由 trim 归还给页缓存
+TEST_F(ScavengerTest, TrimReturnsDeferredEmptySpans) {
+    scavenger_config config;
+    config.interval = 1h; // 只手动触发
+    scavenger::get_instance().start(config);
+
+    const size_t size = 1024;
+    auto list = central.allocate(size, 8);
+    ASSERT_TRUE(list.has_value());
+    central.deallocate(list.value(), size);
+
+    const size_t trimmed_before = scavenger::get_instance().trimmed_bytes();
+    scavenger::get_instance().run_once();
+    EXPECT_GT(scavenger::get_instance().trimmed_bytes(), trimmed_before);
+
+    // 整理以后仍然可以正常分配
+    auto again = central.allocate(size, 8);
+    ASSERT_TRUE(again.has_value());
+    central.deallocate(again.value(), size);
+}
+
+// 停止回收线程时，已经延迟的空页面也要归还
+TEST_F(ScavengerTest, StopReleasesDeferredEmptySpans) {
+    const size_t size = 1992;
+    auto span_count = [size] {
+        for (const auto& size_class : memory_pool::stats().size_classes) {
+            if (size_class.memory_size == size) {
+                return size_class.span_count;
+            }
+        }
+        return size_t(0);
+    };
+    const size_t spans_before = span_count();
+
+    scavenger_config config;
+    config.interval = 1h;
+    scavenger::get_instance().start(config);
+    auto list = central.allocate(size, 8);
+    ASSERT_TRUE(list.has_value());
+    central.deallocate(list.value(), size);
+    EXPECT_GT(span_count(), spans_before);
+
+    scavenger::get_instance().stop();
+    EXPECT_EQ(span_count(), spans_before);
+}
+
+// 后台线程会定期执行回收
+TEST_F(ScavengerTest, BackgroundThreadRuns) {
+    scavenger_config config;
+    config.interval = 10ms;
+    config.idle_threshold = 0ms;
+    memory_pool::start_scavenger(config);
+    EXPECT_TRUE(scavenger::get_instance().is_running());
+
+    const size_t passes_before = scavenger::get_instance().pass_count();
+    for (int i = 0; i < 100 && scavenger::get_instance().pass_count() < passes_before + 2; i++) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_GE(scavenger::get_instance().pass_count(), passes_before + 2);
+
+    memory_pool::stop_scavenger();
+    EXPECT_FALSE(scavenger::get_instance().is_running());
+}
+
+// 回收线程运行时，内存池仍然可以正常使用
+TEST_F(ScavengerTest, PoolWorksWhileScavenging) {
+    scavenger_config config;
+    config.interval = 1ms;
+    config.idle_threshold = 0ms;
+    config.central_max_free_bytes_per_list = 0;
+    memory_pool::start_scavenger(config);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([] {
+            std::vector<std::pair<void*, size_t>> blocks;
+            for (int round = 0; round < 20; round++) {
+                for (size_t i = 0; i < 2000; i++) {
+                    size_t size = 8 + (i * 40) % 4096;
+                    auto ptr = memory_pool::allocate(size);
+                    ASSERT_TRUE(ptr.has_value());
+                    memset(ptr.value(), 0x5A, size);
+                    blocks.emplace_back(ptr.value(), size);
+                }
+                for (auto [ptr, size] : blocks) {
+                    memory_pool::deallocate(ptr, size);
+                }
+                blocks.clear();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    memory_pool::stop_scavenger();
+}
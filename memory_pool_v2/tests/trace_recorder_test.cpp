@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory_pool.h"
+#include "trace_recorder.h"
+
+using namespace memory_pool_v2;
+
+class TraceRecorderTest : public ::testing::Test {
+protected:
+    std::string path;
+
+    void SetUp() override {
+        path = testing::TempDir() + "memory_pool_trace_test.bin";
+    }
+
+    void TearDown() override {
+        memory_pool::stop_trace();
+        std::remove(path.c_str());
+    }
+};
+
+// varint 的编码与解码
+TEST_F(TraceRecorderTest, VarintRoundTrip) {
+    std::vector<uint8_t> data;
+    const std::vector<uint64_t> values = {0, 1, 127, 128, 300, 1ull << 32, UINT64_MAX};
+    for (uint64_t value : values) {
+        trace_format::write_varint(data, value);
+    }
+    const uint8_t* current = data.data();
+    for (uint64_t value : values) {
+        EXPECT_EQ(trace_format::read_varint(current, data.data() + data.size()), value);
+    }
+    EXPECT_EQ(current, data.data() + data.size());
+    EXPECT_FALSE(trace_format::read_varint(current, data.data() + data.size()).has_value());
+}
+
+// 申请、调整大小与其他线程的回收都被记录，指针编号在调整大小以后保持不变
+TEST_F(TraceRecorderTest, RecordsOperationsInOrder) {
+    void* before = memory_pool::allocate(32).value();
+    ASSERT_TRUE(memory_pool::start_trace(path));
+    void* small = memory_pool::allocate(64).value();
+    void* large = memory_pool::allocate(8 * 1024 * 1024).value();
+    void* grown = memory_pool::reallocate(large, 8 * 1024 * 1024, 16 * 1024 * 1024).value();
+    std::thread other([&] { memory_pool::deallocate(small, 64); });
+    other.join();
+    // 开始记录之前申请的指针不会被记录
+    memory_pool::deallocate(before, 32);
+    memory_pool::deallocate(grown, 16 * 1024 * 1024);
+    memory_pool::stop_trace();
+    EXPECT_EQ(trace_recorder::get_instance().event_count(), 5);
+
+    auto events = trace_reader::read_file(path);
+    ASSERT_TRUE(events.has_value());
+    ASSERT_EQ(events->size(), 5);
+    auto& e = events.value();
+    EXPECT_EQ(e[0].operation, trace_operation::allocate);
+    EXPECT_EQ(e[0].size, 64);
+    EXPECT_EQ(e[1].operation, trace_operation::allocate);
+    EXPECT_EQ(e[1].size, 8 * 1024 * 1024);
+    EXPECT_NE(e[0].pointer_id, e[1].pointer_id);
+    EXPECT_EQ(e[2].operation, trace_operation::reallocate);
+    EXPECT_EQ(e[2].pointer_id, e[1].pointer_id);
+    EXPECT_EQ(e[2].size, 16 * 1024 * 1024);
+    EXPECT_EQ(e[3].operation, trace_operation::deallocate);
+    EXPECT_EQ(e[3].pointer_id, e[0].pointer_id);
+    EXPECT_NE(e[3].thread_id, e[0].thread_id);
+    EXPECT_EQ(e[4].operation, trace_operation::deallocate);
+    EXPECT_EQ(e[4].pointer_id, e[1].pointer_id);
+    EXPECT_EQ(e[4].thread_id, e[0].thread_id);
+    for (size_t i = 1; i < e.size(); i++) {
+        EXPECT_GE(e[i].timestamp_ns, e[i - 1].timestamp_ns);
+    }
+}
+
+// 多个线程同时申请与回收，每个指针的申请都在回收之前
+TEST_F(TraceRecorderTest, ConcurrentThreads) {
+    constexpr size_t THREAD_COUNT = 4;
+    constexpr size_t OPS = 10000;
+    ASSERT_TRUE(memory_pool::start_trace(path));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([t] {
+            for (size_t i = 0; i < OPS; i++) {
+                const size_t size = 8 + (i + t) % 512;
+                void* ptr = memory_pool::allocate(size).value();
+                memory_pool::deallocate(ptr, size);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    memory_pool::stop_trace();
+
+    auto events = trace_reader::read_file(path);
+    ASSERT_TRUE(events.has_value());
+    ASSERT_EQ(events->size(), THREAD_COUNT * OPS * 2);
+    std::vector<int> state(THREAD_COUNT * OPS, 0);
+    for (auto& event : events.value()) {
+        ASSERT_LT(event.pointer_id, state.size());
+        ASSERT_LT(event.thread_id, THREAD_COUNT);
+        if (event.operation == trace_operation::allocate) {
+            EXPECT_EQ(state[event.pointer_id]++, 0);
+        } else {
+            EXPECT_EQ(event.operation, trace_operation::deallocate);
+            EXPECT_EQ(state[event.pointer_id]++, 1);
+        }
+    }
+}
+
+// 损坏的文件不能被解析
+TEST_F(TraceRecorderTest, RejectsInvalidData) {
+    EXPECT_FALSE(trace_reader::read_file(path + ".missing").has_value());
+    std::vector<uint8_t> data(trace_format::MAGIC, trace_format::MAGIC + sizeof(trace_format::MAGIC));
+    EXPECT_FALSE(trace_reader::parse(data).has_value());
+    data.insert(data.end(), {1, 0, 0, 0});
+    EXPECT_TRUE(trace_reader::parse(data).has_value());
+    // 只有一半的记录
+    data.insert(data.end(), {0, 0, 0x80});
+    EXPECT_FALSE(trace_reader::parse(data).has_value());
+}
@@ -5,22 +5,102 @@
 #include "thread_cache.h"
 
 #include <assert.h>
+#include <cstring>
 #include <iostream>
+#include <mutex>
+#include <vector>
 #include <bits/ostream.tcc>
 
 #include "central_cache.h"
+#include "heap_profiler.h"
+#include "instrumentation.h"
+#include "page_cache.h"
 #include "utils.h"
 
 namespace memory_pool_v2 {
+    namespace {
+        // 所有存活的线程缓存，以及已经退出的线程累计的申请与归还次数
+        struct thread_cache_registry {
+            std::mutex mutex;
+            std::vector<thread_cache*> caches;
+            std::array<size_t, size_utils::CACHE_LINE_SIZE> retired_refill_count = {};
+            std::array<size_t, size_utils::CACHE_LINE_SIZE> retired_overflow_count = {};
+        };
+
+        thread_cache_registry& get_registry() {
+            static thread_cache_registry registry;
+            return registry;
+        }
+
+        // 新的线程缓存第一次向中心缓存申请的个数，为 0 时使用默认的最小值
+        std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE>& initial_allocate_count() {
+            static std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> counts = {};
+            return counts;
+        }
+    }
+
+    void thread_cache::set_initial_allocate_count(size_t memory_size, size_t count) {
+        memory_size = size_utils::align(memory_size);
+        if (memory_size == 0 || memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
+            return;
+        }
+        // 与 compute_allocate_count 中的上限相同，上限取决于参数，所以参数要在这之前生效
+        runtime_config::freeze();
+        count = std::min(count, runtime_config::max_free_bytes(size_utils::get_index(memory_size)) / memory_size / 2);
+#ifndef NDEBUG
+        count = std::min(count, page_span::MAX_UNIT_COUNT);
+#endif
+        initial_allocate_count()[size_utils::get_index(memory_size)].store(count, std::memory_order_relaxed);
+    }
+
+    thread_cache::thread_cache() {
+        // 线程缓存创建以后参数不能再改变
+        runtime_config::freeze();
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        registry.caches.push_back(this);
+    }
+
+    void thread_cache::collect_stats(memory_pool_stats& stats) {
+        assert(stats.size_classes.size() == size_utils::CACHE_LINE_SIZE);
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        stats.thread_count = registry.caches.size();
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            stats.size_classes[index].refill_count += registry.retired_refill_count[index];
+            stats.size_classes[index].overflow_count += registry.retired_overflow_count[index];
+        }
+        for (thread_cache* cache : registry.caches) {
+            for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+                size_class_stats& result = stats.size_classes[index];
+                result.thread_cache_count += cache->m_free_cache_size[index].load(std::memory_order_relaxed);
+                result.refill_count += cache->m_refill_count[index].load(std::memory_order_relaxed);
+                result.overflow_count += cache->m_overflow_count[index].load(std::memory_order_relaxed);
+            }
+            stats.large.thread_cache_count += cache->m_large_cached_count.load(std::memory_order_relaxed);
+            stats.large.thread_cache_bytes += cache->m_large_cached_bytes.load(std::memory_order_relaxed);
+        }
+    }
+
     std::optional<void *> thread_cache::allocate(size_t memory_size) {
         if (memory_size == 0) {
             return std::nullopt; // 对于大小为0的情况立即返回nullopt
         }
+        MEMORY_POOL_INSTRUMENT(thread_cache_allocate, memory_size);
 
         // 将memory_size的大小对齐到8字节
         memory_size = size_utils::align(memory_size);
-        if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            return allocate_from_central_cache(memory_size).and_then([](std::byte* memory_addr) { return std::optional<void*>(memory_addr); });
+        // 没有被采样时只有这一次减法
+        m_bytes_until_sample -= static_cast<std::ptrdiff_t>(memory_size);
+        if (m_bytes_until_sample < 0) [[unlikely]] {
+            return allocate_sampled(memory_size);
+        }
+        return allocate_aligned(memory_size);
+    }
+
+    std::optional<void*> thread_cache::allocate_aligned(size_t memory_size) {
+        if (memory_size > runtime_config::max_cached_unit_size()) {
+            return allocate_large(memory_size);
         }
 
         const size_t index = size_utils::get_index(memory_size);
@@ -29,21 +109,36 @@ namespace memory_pool_v2 {
             std::byte* result = m_free_cache[index];
             m_free_cache[index] = *(reinterpret_cast<std::byte**>(result));
 
-            m_free_cache_size[index] --;
+            counter_sub(m_free_cache_size[index], 1);
+            MEMORY_POOL_INSTRUMENT(thread_cache_fast_path, memory_size);
             // 在release模式下会被移除，这个只用于检测代码是否有问题
             return result;
         }
         return allocate_from_central_cache(memory_size).and_then([](std::byte* memory_addr) { return std::optional<void*>(memory_addr); });
     }
 
+    std::optional<void*> thread_cache::allocate_sampled(size_t memory_size) {
+        auto& profiler = heap_profiler::get_instance();
+        m_bytes_until_sample = static_cast<std::ptrdiff_t>(profiler.next_sample_distance());
+        auto result = allocate_aligned(memory_size);
+        if (result.has_value() && profiler.is_running()) {
+            profiler.record_allocation(result.value(), memory_size);
+        }
+        return result;
+    }
+
     void thread_cache::deallocate(void *start_p, size_t memory_size) {
         if (memory_size == 0 || start_p == nullptr) {
             return ;
         }
+        if (heap_profiler::get_instance().might_be_sampled(start_p)) [[unlikely]] {
+            heap_profiler::get_instance().record_deallocation(start_p);
+        }
+        MEMORY_POOL_INSTRUMENT(thread_cache_deallocate, memory_size);
         memory_size = size_utils::align(memory_size);
-        // 如果大于了最大缓存值了，说明是直接从中心缓存区申请的，可以直接返还给中心缓存区
-        if (memory_size > size_utils::MAX_CACHED_UNIT_SIZE) {
-            central_cache::get_instance().deallocate(reinterpret_cast<std::byte*>(start_p), memory_size);
+        // 如果大于了最大缓存值了，则按页数缓存
+        if (memory_size > runtime_config::max_cached_unit_size()) {
+            deallocate_large(reinterpret_cast<std::byte*>(start_p), memory_size);
             return;
         }
 
@@ -52,14 +147,14 @@ namespace memory_pool_v2 {
 
         *(reinterpret_cast<std::byte**>(start_p)) = m_free_cache[index];
         m_free_cache[index] = reinterpret_cast<std::byte*>(start_p);
-        m_free_cache_size[index] ++;
+        counter_add(m_free_cache_size[index], 1);
 
         // 检测一下需不需要回收
         // 如果当前的列表所维护的大小已经超过了阈值，则触发资源回收
         // 维护的大小 = 个数 × 单个空间的大小
-        if (m_free_cache_size[index] * memory_size > MAX_FREE_BYTES_PER_LISTS) {
+        if (m_free_cache_size[index].load(std::memory_order_relaxed) * memory_size > runtime_config::max_free_bytes(index)) {
             // 如果超过了，则回收一半的多余的内存块
-            size_t deallocate_block_size = m_free_cache_size[index] / 2;
+            size_t deallocate_block_size = m_free_cache_size[index].load(std::memory_order_relaxed) / 2;
 
             std::byte* block_to_deallocate = m_free_cache[index];
             std::byte* last_node_to_remove = block_to_deallocate;
@@ -79,10 +174,11 @@ namespace memory_pool_v2 {
             // 断开归还链表与剩余链表的连接
             *(reinterpret_cast<std::byte**>(last_node_to_remove)) = nullptr;
             m_free_cache[index] = new_head;
-            m_free_cache_size[index] -= deallocate_block_size;
+            counter_sub(m_free_cache_size[index], deallocate_block_size);
+            counter_add(m_overflow_count[index], 1);
 
             // 检查当前的链表与要删除的链表的长度是不是一样的
-            assert(check_ptr_length(m_free_cache[index]) == m_free_cache_size[index]);
+            assert(check_ptr_length(m_free_cache[index]) == m_free_cache_size[index].load(std::memory_order_relaxed));
             assert(check_ptr_length(block_to_deallocate) == deallocate_block_size);
 
             // 释放空间
@@ -93,8 +189,106 @@ namespace memory_pool_v2 {
         }
     }
 
+    std::optional<void*> thread_cache::reallocate(void* start_p, size_t old_size, size_t new_size) {
+        if (start_p == nullptr || old_size == 0) {
+            return allocate(new_size);
+        }
+        if (new_size == 0) {
+            // 与失败区分开，原来的地址已经失效了
+            deallocate(start_p, old_size);
+            return nullptr;
+        }
+
+        const size_t old_aligned_size = size_utils::align(old_size);
+        const size_t new_aligned_size = size_utils::align(new_size);
+        if (old_aligned_size > runtime_config::max_cached_unit_size() && new_aligned_size > runtime_config::max_cached_unit_size()) {
+            // 页数没有变化
+            if (size_utils::get_large_index(old_aligned_size) == size_utils::get_large_index(new_aligned_size)) {
+                return start_p;
+            }
+            // 单独 mmap 的内存块直接调整大小
+            auto result = page_cache::get_instance().reallocate_unit(memory_span(static_cast<std::byte*>(start_p), old_aligned_size), new_aligned_size);
+            if (result.has_value()) {
+                if (heap_profiler::get_instance().might_be_sampled(start_p)) {
+                    heap_profiler::get_instance().record_reallocation(start_p, result->data(), new_aligned_size);
+                }
+                return result->data();
+            }
+        } else if (old_aligned_size == new_aligned_size) {
+            return start_p;
+        }
+
+        // 否则申请新的空间并复制
+        auto result = allocate(new_size);
+        if (result.has_value()) {
+            memcpy(result.value(), start_p, std::min(old_size, new_size));
+            deallocate(start_p, old_size);
+        }
+        return result;
+    }
+
+    thread_cache::~thread_cache() {
+        // 每个规格的链表整条还给中心缓存，只存在很短时间的线程退出时不会带走缓存的内存块
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            if (m_free_cache[index] != nullptr) {
+                central_cache::get_instance().deallocate(m_free_cache[index], (index + 1) * size_utils::ALIGNMENT);
+                m_free_cache[index] = nullptr;
+                m_free_cache_size[index].store(0, std::memory_order_relaxed);
+            }
+        }
+        for (size_t index = 0; index < size_utils::LARGE_CACHE_LINE_SIZE; index++) {
+            const size_t memory_size = (index + 1) * size_utils::PAGE_SIZE;
+            while (m_large_free_cache[index] != nullptr) {
+                std::byte* memory = m_large_free_cache[index];
+                m_large_free_cache[index] = *(reinterpret_cast<std::byte**>(memory));
+                central_cache::get_instance().deallocate(memory, memory_size);
+            }
+        }
+        m_large_cached_count.store(0, std::memory_order_relaxed);
+        m_large_cached_bytes.store(0, std::memory_order_relaxed);
+
+        // 注销以后，申请与归还的次数累计到全局
+        auto& registry = get_registry();
+        std::unique_lock<std::mutex> guard(registry.mutex);
+        std::erase(registry.caches, this);
+        for (size_t index = 0; index < size_utils::CACHE_LINE_SIZE; index++) {
+            registry.retired_refill_count[index] += m_refill_count[index].load(std::memory_order_relaxed);
+            registry.retired_overflow_count[index] += m_overflow_count[index].load(std::memory_order_relaxed);
+        }
+    }
+
+    std::optional<void*> thread_cache::allocate_large(size_t memory_size) {
+        if (memory_size <= size_utils::MAX_LARGE_CACHED_UNIT_SIZE) {
+            const size_t index = size_utils::get_large_index(memory_size);
+            if (m_large_free_cache[index] != nullptr) {
+                std::byte* result = m_large_free_cache[index];
+                m_large_free_cache[index] = *(reinterpret_cast<std::byte**>(result));
+                counter_sub(m_large_cached_count, 1);
+                counter_sub(m_large_cached_bytes, (index + 1) * size_utils::PAGE_SIZE);
+                return result;
+            }
+        }
+        return central_cache::get_instance().allocate(memory_size, 1).and_then([](std::byte* memory_addr) { return std::optional<void*>(memory_addr); });
+    }
+
+    void thread_cache::deallocate_large(std::byte* memory, size_t memory_size) {
+        if (memory_size <= size_utils::MAX_LARGE_CACHED_UNIT_SIZE) {
+            const size_t index = size_utils::get_large_index(memory_size);
+            const size_t page_size = (index + 1) * size_utils::PAGE_SIZE;
+            if (m_large_cached_bytes.load(std::memory_order_relaxed) + page_size <= MAX_LARGE_CACHED_BYTES) {
+                *(reinterpret_cast<std::byte**>(memory)) = m_large_free_cache[index];
+                m_large_free_cache[index] = memory;
+                counter_add(m_large_cached_count, 1);
+                counter_add(m_large_cached_bytes, page_size);
+                return;
+            }
+        }
+        central_cache::get_instance().deallocate(memory, memory_size);
+    }
+
     std::optional<std::byte*> thread_cache::allocate_from_central_cache(size_t memory_size) {
         size_t block_count = compute_allocate_count(memory_size);
+        MEMORY_POOL_INSTRUMENT(thread_cache_refill, block_count * memory_size);
         return central_cache::get_instance().allocate(memory_size, block_count).transform([this, memory_size, block_count](std::byte* memory_list) {
             size_t index = size_utils::get_index(memory_size);
             std::byte* list_end = memory_list;
@@ -108,7 +302,8 @@ namespace memory_pool_v2 {
             *(reinterpret_cast<std::byte**>(list_end)) = m_free_cache[index];
             // 将链表指向下一个结点，第一个结点要传出去
             m_free_cache[index] = *reinterpret_cast<std::byte**>(memory_list);
-            m_free_cache_size[index] += block_count - 1;
+            counter_add(m_free_cache_size[index], block_count - 1);
+            counter_add(m_refill_count[index], 1);
             return memory_list;
         });
     }
@@ -121,9 +316,17 @@ namespace memory_pool_v2 {
             return 1;
         }
 
-        // 最少申请4个块
-        size_t result = std::max(m_next_allocate_count[index], static_cast<size_t>(4));
-
+        // 第一次申请时使用上一次运行学习到的个数（如果有），最少申请 min_batch_count 个块（默认为4个）
+        size_t result = m_next_allocate_count[index];
+        if (result == 0) {
+            result = initial_allocate_count()[index].load(std::memory_order_relaxed);
+        }
+        result = std::max(result, runtime_config::min_batch_count());
+        // 最少申请的个数同样不能超过这个规格的上限，否则一次申请就会超过线程缓存的上限
+        result = std::min(result, std::max<size_t>(1, runtime_config::max_free_bytes(index) / memory_size / 2));
+#ifndef NDEBUG
+        result = std::min(result, page_span::MAX_UNIT_COUNT);
+#endif
 
         // 计算下一次要申请的个数，默认乘2
         size_t next_allocate_count = result * 2;
@@ -134,7 +337,7 @@ namespace memory_pool_v2 {
         // 同时也要确保不会超过一个列表维护的最大容量
         // 比如16KB的内存块，不能一次性申请128个吧
         // 256 * 1024 B / 16 * 1024 B / 2 = 8个（这里就将16KB的内存一次性最多申请8个，要给点冗余(除2)，不然可能会反复申请）
-        next_allocate_count = std::min(next_allocate_count, MAX_FREE_BYTES_PER_LISTS / memory_size / 2);
+        next_allocate_count = std::min(next_allocate_count, runtime_config::max_free_bytes(index) / memory_size / 2);
         // 更新下一次要申请的个数
         m_next_allocate_count[index] = next_allocate_count;
         // 返回这一次申请的个数
@@ -5,9 +5,12 @@
 #ifndef THREAD_CACHE_H
 #define THREAD_CACHE_H
 #include <array>
+#include <atomic>
 #include <list>
 #include <optional>
 #include <set>
+#include "memory_pool_config.h"
+#include "memory_pool_stats.h"
 #include "utils.h"
 #include <span>
 #include <unordered_map>
@@ -20,7 +23,10 @@ public:
     /// 这个阈值的设置需要分析，如果常用的分配的量比较少
     /// 比如只申请几个固定大小的空间，则这个值可以设置的大一些
     /// 而申请的内存空间的大小很复杂，则需要设置的小一些，不然可能会让单个线程的空间占用过多
-    static constexpr size_t MAX_FREE_BYTES_PER_LISTS = 256 * 1024;
+    /// 这里是默认值，实际使用的值见 runtime_config::max_free_bytes()，可以为每个规格单独设置
+    static constexpr size_t MAX_FREE_BYTES_PER_LISTS = memory_pool_config::DEFAULT_MAX_FREE_BYTES_PER_LIST;
+    /// 每个线程缓存的大内存块的总字节数上限，超过的部分还给中心缓存
+    static constexpr size_t MAX_LARGE_CACHED_BYTES = 2 * 1024 * 1024;
 
     static thread_cache& get_instance() {
         static thread_local thread_cache instance;
@@ -36,7 +42,41 @@ public:
     /// 参数： start_p:内存开始的地址, size_t：这片地址的大小
     void deallocate(void* start_p, size_t memory_size);
 
+    /// 调整一片空间的大小，保留原来的内容
+    /// 单独 mmap 的超大内存块使用 mremap 调整，不需要复制；调整后仍在同一个规格（或页数相同）时直接返回原来的地址
+    /// 参数：start_p: 原来的地址，为 nullptr 时等同于 allocate，old_size: 原来的大小，new_size: 新的大小，为 0 时等同于 deallocate
+    /// 返回值：新的地址，失败时返回 nullopt，原来的空间不变；new_size 为 0 时归还原来的空间并返回 nullptr
+    [[nodiscard("不应该忽略这个值，原来的地址可能已经失效了")]] std::optional<void*> reallocate(void* start_p, size_t old_size, size_t new_size);
+
+    /// 统计所有线程缓存中空闲的内存块以及申请与归还的次数
+    /// 只在注册与注销线程缓存时加锁，读取其他线程的计数器不会阻塞这些线程的分配
+    /// 参数：stats: 结果，其中的 size_classes 需要已经按下标准备好 CACHE_LINE_SIZE 个元素
+    static void collect_stats(memory_pool_stats& stats);
+
+    /// 设置新的线程缓存第一次向中心缓存申请的个数，通常来自上一次运行学习到的结果，超过上限时按上限处理
+    /// 参数：memory_size: 内存块的大小，count: 申请的个数，为 0 时恢复默认值
+    static void set_initial_allocate_count(size_t memory_size, size_t count);
+
+    /// 创建时注册到全局的线程缓存列表中，用于统计
+    thread_cache();
+
+    /// 线程退出时把缓存的所有内存块还给中心缓存
+    ~thread_cache();
+
 private:
+    /// 只有所属的线程会修改的计数器，用 load + store 代替 fetch_add，不需要带锁的指令，其他线程可以随时读取
+    static void counter_add(std::atomic<size_t>& counter, size_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+    static void counter_sub(std::atomic<size_t>& counter, size_t value) {
+        counter.store(counter.load(std::memory_order_relaxed) - value, std::memory_order_relaxed);
+    }
+
+    /// 申请已经对齐的大小，不经过采样的检查
+    std::optional<void*> allocate_aligned(size_t memory_size);
+
+    /// 采样的计数器减到 0 以下时的慢速路径：申请以后交给堆分析记录，并重新设置计数器
+    std::optional<void*> allocate_sampled(size_t memory_size);
 
     /// 向高层申请一块空间
     std::optional<std::byte*> allocate_from_central_cache(size_t memory_size);
@@ -44,11 +84,27 @@ private:
     /// 当前还没有被分配的内存
     std::array<std::byte* , size_utils::CACHE_LINE_SIZE> m_free_cache = {};
     /// 指定下标存放的大小
-    std::array<size_t, size_utils::CACHE_LINE_SIZE> m_free_cache_size = {};
+    std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> m_free_cache_size = {};
+    /// 向中心缓存批量申请的次数，以及超过上限后批量归还的次数
+    std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> m_refill_count = {};
+    std::array<std::atomic<size_t>, size_utils::CACHE_LINE_SIZE> m_overflow_count = {};
 
     /// 动态分配内存
     size_t compute_allocate_count(size_t memory_size);
 
+    /// 分配与回收大内存块，按页数分组缓存最近回收的内存块
+    std::optional<void*> allocate_large(size_t memory_size);
+    void deallocate_large(std::byte* memory, size_t memory_size);
+
+    /// 按页数分组的大内存块链表
+    std::array<std::byte*, size_utils::LARGE_CACHE_LINE_SIZE> m_large_free_cache = {};
+    /// 缓存的大内存块的个数与总字节数
+    std::atomic<size_t> m_large_cached_count = 0;
+    std::atomic<size_t> m_large_cached_bytes = 0;
+
+    /// 距离下一次采样还要申请的字节数，初始为 0，使第一次申请就读取堆分析的设置
+    std::ptrdiff_t m_bytes_until_sample = 0;
+
     /// 用于表示下一次再申请指定大小的内存时，会申请几个内存
     std::array<size_t, size_utils::CACHE_LINE_SIZE> m_next_allocate_count = {};
 
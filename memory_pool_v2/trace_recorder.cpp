@@ -0,0 +1,116 @@
+//
+// Created by ghost-him on 25-5-9.
+//
+
+#include "trace_recorder.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace memory_pool_v2 {
+    namespace {
+        // 缓冲区超过这个大小时写入文件
+        constexpr size_t FLUSH_THRESHOLD = 1024 * 1024;
+
+        // 线程在某一次记录中的编号
+        struct thread_trace_id {
+            uint64_t generation = 0;
+            uint32_t id = 0;
+        };
+        thread_local thread_trace_id current_thread_id;
+    }
+
+    bool trace_recorder::start(const std::string& path) {
+        stop();
+        std::unique_lock<std::mutex> guard(m_mutex);
+        m_file = fopen(path.c_str(), "wb");
+        if (m_file == nullptr) {
+            return false;
+        }
+        // 先在固定大小的数组中拼好文件头，再一次写入缓冲区
+        std::array<uint8_t, trace_format::HEADER_SIZE> header;
+        const uint32_t version = trace_format::VERSION;
+        memcpy(header.data(), trace_format::MAGIC, sizeof(trace_format::MAGIC));
+        memcpy(header.data() + sizeof(trace_format::MAGIC), &version, sizeof(version));
+        m_buffer.assign(header.begin(), header.end());
+        m_start_time = std::chrono::steady_clock::now();
+        m_last_timestamp = 0;
+        m_pointer_ids.clear();
+        m_next_pointer_id = 0;
+        m_next_thread_id = 0;
+        m_generation ++;
+        m_event_count.store(0, std::memory_order_relaxed);
+        s_recording.store(true, std::memory_order_relaxed);
+        return true;
+    }
+
+    void trace_recorder::stop() {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        s_recording.store(false, std::memory_order_relaxed);
+        if (m_file == nullptr) {
+            return;
+        }
+        flush();
+        fclose(m_file);
+        m_file = nullptr;
+        m_pointer_ids.clear();
+    }
+
+    void trace_recorder::record(trace_operation operation, void* ptr, size_t size, void* old_ptr) {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        if (m_file == nullptr || ptr == nullptr) {
+            return;
+        }
+        uint64_t pointer_id = 0;
+        if (operation == trace_operation::allocate) {
+            pointer_id = m_next_pointer_id ++;
+            m_pointer_ids[ptr] = pointer_id;
+        } else {
+            // 开始记录之前申请的指针没有编号，回放时无法对应，不记录
+            auto it = m_pointer_ids.find(operation == trace_operation::reallocate ? old_ptr : ptr);
+            if (it == m_pointer_ids.end()) {
+                if (operation == trace_operation::deallocate) {
+                    return;
+                }
+                operation = trace_operation::allocate;
+                pointer_id = m_next_pointer_id ++;
+            } else {
+                pointer_id = it->second;
+                m_pointer_ids.erase(it);
+            }
+            if (operation != trace_operation::deallocate) {
+                m_pointer_ids[ptr] = pointer_id;
+            }
+        }
+
+        if (current_thread_id.generation != m_generation) {
+            current_thread_id = {m_generation, m_next_thread_id ++};
+        }
+        // 在锁内取时间，保证写入的顺序与时间的顺序一致
+        const uint64_t timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_start_time).count();
+        const uint64_t delta = timestamp >= m_last_timestamp ? timestamp - m_last_timestamp : 0;
+        m_last_timestamp = std::max(timestamp, m_last_timestamp);
+
+        m_buffer.push_back(static_cast<uint8_t>(operation));
+        trace_format::write_varint(m_buffer, current_thread_id.id);
+        trace_format::write_varint(m_buffer, delta);
+        trace_format::write_varint(m_buffer, pointer_id);
+        trace_format::write_varint(m_buffer, size);
+        m_event_count.fetch_add(1, std::memory_order_relaxed);
+        if (m_buffer.size() >= FLUSH_THRESHOLD) {
+            flush();
+        }
+    }
+
+    void trace_recorder::flush() {
+        if (!m_buffer.empty()) {
+            fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+            m_buffer.clear();
+        }
+    }
+
+    trace_recorder::~trace_recorder() {
+        stop();
+    }
+} // memory_pool_v2
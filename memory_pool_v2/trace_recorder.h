@@ -0,0 +1,176 @@
+//
+// Created by ghost-him on 25-5-9.
+//
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace memory_pool_v2 {
+
+    // 记录的操作
+    enum class trace_operation : uint8_t {
+        allocate = 0,
+        deallocate = 1,
+        // 调整大小，调整以后的指针沿用原来的编号
+        reallocate = 2,
+    };
+
+    // 一条记录，线程编号与指针编号都是从 0 开始按出现的顺序分配的
+    struct trace_event {
+        trace_operation operation = trace_operation::allocate;
+        uint32_t thread_id = 0;
+        uint64_t pointer_id = 0;
+        uint64_t size = 0;
+        // 距离开始记录的纳秒数
+        uint64_t timestamp_ns = 0;
+    };
+
+    // 文件格式：8 字节的魔数 + 4 字节的版本号，之后是一条条变长的记录
+    // 每条记录：1 字节的操作，之后依次是线程编号、与上一条记录的时间差、指针编号、大小，都使用 LEB128 变长编码
+    // 记录按时间顺序写入，时间差总是非负的，一般一条记录只有 6 - 10 字节
+    namespace trace_format {
+        inline constexpr char MAGIC[8] = {'M', 'P', 'T', 'R', 'A', 'C', 'E', '\0'};
+        inline constexpr uint32_t VERSION = 1;
+        inline constexpr size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(VERSION);
+
+        inline void write_varint(std::vector<uint8_t>& out, uint64_t value) {
+            while (value >= 0x80) {
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        inline std::optional<uint64_t> read_varint(const uint8_t*& current, const uint8_t* end) {
+            uint64_t result = 0;
+            for (int shift = 0; current != end && shift < 64; shift += 7) {
+                const uint8_t byte = *current++;
+                result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    return result;
+                }
+            }
+            return std::nullopt;
+        }
+    }
+
+    // 读取整个记录文件
+    class trace_reader {
+    public:
+        /// 读取并解析一个记录文件
+        /// 返回值：所有的记录，文件不存在或者格式不对时返回 nullopt
+        static std::optional<std::vector<trace_event>> read_file(const std::string& path) {
+            FILE* file = fopen(path.c_str(), "rb");
+            if (file == nullptr) {
+                return std::nullopt;
+            }
+            std::vector<uint8_t> data;
+            uint8_t buffer[64 * 1024];
+            size_t read_size = 0;
+            while ((read_size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+                data.insert(data.end(), buffer, buffer + read_size);
+            }
+            fclose(file);
+            return parse(data);
+        }
+
+        static std::optional<std::vector<trace_event>> parse(const std::vector<uint8_t>& data) {
+            if (data.size() < trace_format::HEADER_SIZE || memcmp(data.data(), trace_format::MAGIC, sizeof(trace_format::MAGIC)) != 0) {
+                return std::nullopt;
+            }
+            uint32_t version = 0;
+            memcpy(&version, data.data() + sizeof(trace_format::MAGIC), sizeof(version));
+            if (version != trace_format::VERSION) {
+                return std::nullopt;
+            }
+            std::vector<trace_event> result;
+            const uint8_t* current = data.data() + trace_format::HEADER_SIZE;
+            const uint8_t* end = data.data() + data.size();
+            uint64_t timestamp = 0;
+            while (current != end) {
+                trace_event event;
+                const uint8_t operation = *current++;
+                if (operation > static_cast<uint8_t>(trace_operation::reallocate)) {
+                    return std::nullopt;
+                }
+                event.operation = static_cast<trace_operation>(operation);
+                auto thread_id = trace_format::read_varint(current, end);
+                auto delta = trace_format::read_varint(current, end);
+                auto pointer_id = trace_format::read_varint(current, end);
+                auto size = trace_format::read_varint(current, end);
+                if (!thread_id || !delta || !pointer_id || !size) {
+                    return std::nullopt;
+                }
+                timestamp += *delta;
+                event.thread_id = static_cast<uint32_t>(*thread_id);
+                event.timestamp_ns = timestamp;
+                event.pointer_id = *pointer_id;
+                event.size = *size;
+                result.push_back(event);
+            }
+            return result;
+        }
+    };
+
+    // 把内存池的每一次申请、回收与调整大小记录到文件中，用于之后回放
+    // 没有记录时 memory_pool 的接口只多读取一个原子变量；记录时每一次操作都要加锁，只用于采集真实的负载
+    class trace_recorder {
+    public:
+        static trace_recorder& get_instance() {
+            static trace_recorder instance;
+            return instance;
+        }
+
+        static bool is_recording() { return s_recording.load(std::memory_order_relaxed); }
+
+        /// 开始记录，如果已经在记录了，则先结束之前的记录
+        /// 参数：path: 记录文件的路径
+        /// 返回值：文件是否打开成功
+        bool start(const std::string& path);
+
+        /// 结束记录，把缓冲区中的记录写入文件并关闭
+        void stop();
+
+        /// 记录一次操作
+        /// 参数：ptr: 申请时为申请到的指针，回收时为要回收的指针；old_ptr: 只在调整大小时使用，为原来的指针
+        void record(trace_operation operation, void* ptr, size_t size, void* old_ptr = nullptr);
+
+        /// 已经记录的条数
+        size_t event_count() const { return m_event_count.load(std::memory_order_relaxed); }
+
+        ~trace_recorder();
+    private:
+        trace_recorder() = default;
+
+        void flush();
+
+        static inline std::atomic<bool> s_recording = false;
+
+        std::mutex m_mutex;
+        FILE* m_file = nullptr;
+        std::vector<uint8_t> m_buffer;
+        std::chrono::steady_clock::time_point m_start_time;
+        uint64_t m_last_timestamp = 0;
+        // 存活的指针 -> 编号
+        std::unordered_map<void*, uint64_t> m_pointer_ids;
+        uint64_t m_next_pointer_id = 0;
+        // 每次开始记录时加一，线程在新的一次记录中重新分配编号
+        uint64_t m_generation = 0;
+        uint32_t m_next_thread_id = 0;
+        std::atomic<size_t> m_event_count = 0;
+    };
+
+} // memory_pool_v2
+
+#endif //TRACE_RECORDER_H
@@ -16,6 +16,7 @@ namespace memory_pool_v2 {
         uint64_t index = address_offset / m_unit_size;
         assert(m_allocated_map[index] == 0);
         m_allocated_map[index] = true;
+        m_allocated_unit_count ++;
     }
 
     void page_span::deallocate(memory_span memory) {
@@ -25,9 +26,30 @@ namespace memory_pool_v2 {
         uint64_t index = address_offset / m_unit_size;
         assert(m_allocated_map[index] == 1);
         m_allocated_map[index] = false;
+        m_allocated_unit_count --;
     }
 #endif
 
+    std::byte* page_span::allocate_unit() {
+        assert(!is_full());
+        std::byte* result = m_free_list;
+        if (result != nullptr) {
+            m_free_list = *(reinterpret_cast<std::byte**>(result));
+        } else {
+            // 空闲链表中没有了，再从没有切分过的部分中切分
+            result = m_unused_begin;
+            m_unused_begin += m_unit_size;
+        }
+        allocate(memory_span(result, m_unit_size));
+        return result;
+    }
+
+    void page_span::deallocate_unit(std::byte* memory) {
+        deallocate(memory_span(memory, m_unit_size));
+        *(reinterpret_cast<std::byte**>(memory)) = m_free_list;
+        m_free_list = memory;
+    }
+
     bool page_span::is_valid_unit_span(memory_span memory)  {
         // 如果归还的空间的大小与这个页面管理的大小不一样，则报错
         if (memory.size() != m_unit_size)
@@ -5,6 +5,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 #include <atomic>
+#include <algorithm>
 #include <bitset>
 #include <cassert>
 #include <cstddef>
@@ -22,6 +23,15 @@ namespace memory_pool_v2 {
                 std::this_thread::yield();
             }
         }
+        /// 锁已经被其他线程持有、需要等待时把 contention_count 加一，没有竞争时不会修改这个计数器
+        atomic_flag_guard(std::atomic_flag& flag, std::atomic<size_t>& contention_count):m_flag(flag) {
+            if (m_flag.test_and_set(std::memory_order_acquire)) {
+                contention_count.fetch_add(1, std::memory_order_relaxed);
+                while (m_flag.test_and_set(std::memory_order_acquire)) {
+                    std::this_thread::yield();
+                }
+            }
+        }
         ~atomic_flag_guard() {
             m_flag.clear(std::memory_order_release);
         }
@@ -65,6 +75,9 @@ namespace memory_pool_v2 {
         // 这个值就是缓存的最大的内容
         static constexpr size_t MAX_CACHED_UNIT_SIZE = 16 * 1024; // 16KB 为大内存的临界点
         static constexpr size_t CACHE_LINE_SIZE = MAX_CACHED_UNIT_SIZE / ALIGNMENT;
+        // 大内存块按页对齐，不超过这个大小的大内存块回收以后会按页数缓存起来
+        static constexpr size_t MAX_LARGE_CACHED_UNIT_SIZE = 1024 * 1024;
+        static constexpr size_t LARGE_CACHE_LINE_SIZE = MAX_LARGE_CACHED_UNIT_SIZE / PAGE_SIZE;
         /// 内存字节数对齐，对齐成8的倍数，8字节也是内存池最小的分配大小
         static size_t align(const size_t memory_size, const size_t alignment = ALIGNMENT) {
             return (memory_size + alignment - 1) & ~(alignment - 1);
@@ -73,8 +86,15 @@ namespace memory_pool_v2 {
         static size_t get_index(const size_t memory_size) {
             return align(memory_size) / ALIGNMENT - 1;
         }
+
+        /// 大内存块按页数分组的下标
+        static size_t get_large_index(const size_t memory_size) {
+            return align(memory_size, PAGE_SIZE) / PAGE_SIZE - 1;
+        }
     };
 
+    class span_list;
+
     // 这个 page_span 类用于管理从page_cache中分配下来的内存
     // 这个实现方式可以用于判断指定的内存块是不是被多次分配或多次释放了，因为这个的实现内部使用到了bitset作为判断
     // 也正是因为这个bitset，会导致central_cache一次最高只能分配不超过bitset容量的内存块
@@ -88,7 +108,8 @@ namespace memory_pool_v2 {
         static constexpr size_t MAX_UNIT_COUNT = size_utils::PAGE_SIZE / size_utils::ALIGNMENT;
         /// 初始化这个page_span
         /// 参数：span:这个page_span管理的空间，unit_size
-        page_span(const memory_span span, const size_t unit_size): m_memory(span), m_unit_size(unit_size) { };
+        page_span(const memory_span span, const size_t unit_size): m_memory(span), m_unit_size(unit_size),
+            m_total_unit_count(std::min(span.size() / unit_size, MAX_UNIT_COUNT)), m_unused_begin(span.data()) { };
 
         // 根据内存地址的起始位置进行相比
         auto operator<=>(const page_span& other) const {
@@ -100,6 +121,15 @@ namespace memory_pool_v2 {
             return m_allocated_map.none();
         }
 
+        // 当前的页面是不是已经全部分配出去了
+        bool is_full() { return m_allocated_unit_count == m_total_unit_count; }
+
+        // 从这个页面中取出一个内存块，调用前需要确保页面没有满
+        std::byte* allocate_unit();
+
+        // 把一个内存块放回这个页面的空闲链表中
+        void deallocate_unit(std::byte* memory);
+
         // 申请一块内存
         void allocate(memory_span memory);
 
@@ -123,6 +153,12 @@ namespace memory_pool_v2 {
         // 获得这个所维护的地址
         memory_span get_memory_span() { return m_memory; }
 
+        // 分配出去的内存块的个数
+        size_t allocated_unit_count() const { return m_allocated_unit_count; }
+
+        // 一共可以分配的内存块的个数
+        size_t total_unit_count() const { return m_total_unit_count; }
+
     private:
         // 这个page_span管理的空间大小
         const memory_span m_memory;
@@ -132,6 +168,19 @@ namespace memory_pool_v2 {
         // 这个是可以管理多个page合并的情况的，但是由于bitset是不可以动态分配的
         // 所以这里的值决定了整体的分配情况
         std::bitset<MAX_UNIT_COUNT> m_allocated_map;
+        // 管理的大小
+        const size_t m_total_unit_count;
+        // 分配出去的个数
+        size_t m_allocated_unit_count = 0;
+        // 回收回来的内存块组成的链表
+        std::byte* m_free_list = nullptr;
+        // 还没有切分过的部分的起始地址，按需切分，不需要一开始就访问所有的页面
+        std::byte* m_unused_begin;
+        // 所在的页面链表，由 span_list 维护
+        friend class span_list;
+        span_list* m_list = nullptr;
+        page_span* m_prev = nullptr;
+        page_span* m_next = nullptr;
     };
 #else
 
@@ -139,7 +188,7 @@ namespace memory_pool_v2 {
     public:
         /// 初始化这个page_span
         /// 参数：span:这个page_span管理的空间，unit_size
-        page_span(const memory_span span, const size_t unit_size): m_memory(span), m_unit_size(unit_size) { };
+        page_span(const memory_span span, const size_t unit_size): m_memory(span), m_unit_size(unit_size), m_total_unit_count(span.size() / unit_size), m_unused_begin(span.data()) { };
 
         // 根据内存地址的起始位置进行相比
         auto operator<=>(const page_span& other) const {
@@ -152,6 +201,15 @@ namespace memory_pool_v2 {
             return m_allocated_unit_count == 0;
         }
 
+        // 当前的页面是不是已经全部分配出去了
+        bool is_full() { return m_allocated_unit_count == m_total_unit_count; }
+
+        // 从这个页面中取出一个内存块，调用前需要确保页面没有满
+        std::byte* allocate_unit();
+
+        // 把一个内存块放回这个页面的空闲链表中
+        void deallocate_unit(std::byte* memory);
+
         // 申请一块内存
         void allocate(memory_span memory) { m_allocated_unit_count ++;}
 
@@ -175,15 +233,30 @@ namespace memory_pool_v2 {
         // 获得这个所维护的地址
         memory_span get_memory_span() { return m_memory; }
 
+        // 分配出去的内存块的个数
+        size_t allocated_unit_count() const { return m_allocated_unit_count; }
+
+        // 一共可以分配的内存块的个数
+        size_t total_unit_count() const { return m_total_unit_count; }
+
     private:
         // 这个page_span管理的空间大小
         const memory_span m_memory;
         // 一个分配单位的大小
         const size_t m_unit_size;
         // 管理的大小
-        size_t m_total_unit_count;
+        const size_t m_total_unit_count;
         // 分配出去的个数
-        size_t m_allocated_unit_count;
+        size_t m_allocated_unit_count = 0;
+        // 回收回来的内存块组成的链表
+        std::byte* m_free_list = nullptr;
+        // 还没有切分过的部分的起始地址，按需切分，不需要一开始就访问所有的页面
+        std::byte* m_unused_begin;
+        // 所在的页面链表，由 span_list 维护
+        friend class span_list;
+        span_list* m_list = nullptr;
+        page_span* m_prev = nullptr;
+        page_span* m_next = nullptr;
     };
 
 #endif
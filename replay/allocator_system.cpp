@@ -0,0 +1,53 @@
+//
+// Created by ghost-him on 25-5-11.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <new>
+
+#include "replay_allocator.h"
+
+namespace {
+    std::pmr::synchronized_pool_resource& pmr_resource() {
+        static std::pmr::synchronized_pool_resource resource;
+        return resource;
+    }
+}
+
+replay_allocator malloc_allocator() {
+    return {
+        "malloc",
+        [](size_t size) -> void* { return malloc(size); },
+        [](void* ptr, size_t) { free(ptr); },
+        [](void* ptr, size_t, size_t new_size) -> void* { return realloc(ptr, new_size); },
+    };
+}
+
+replay_allocator pmr_allocator() {
+    return {
+        "pmr",
+        [](size_t size) -> void* {
+            try {
+                return pmr_resource().allocate(size);
+            } catch (const std::bad_alloc&) {
+                return nullptr;
+            }
+        },
+        [](void* ptr, size_t size) { pmr_resource().deallocate(ptr, size); },
+        // 没有调整大小的接口，申请新的空间后复制
+        [](void* ptr, size_t old_size, size_t new_size) -> void* {
+            void* result = nullptr;
+            try {
+                result = pmr_resource().allocate(new_size);
+            } catch (const std::bad_alloc&) {
+                return nullptr;
+            }
+            memcpy(result, ptr, std::min(old_size, new_size));
+            pmr_resource().deallocate(ptr, old_size);
+            return result;
+        },
+    };
+}
@@ -0,0 +1,30 @@
+//
+// Created by ghost-him on 25-5-9.
+//
+
+#include <algorithm>
+#include <cstring>
+
+#include "replay_allocator.h"
+#include "../memory_pool/memory_pool.h"
+
+replay_allocator memory_pool_v1_allocator() {
+    return {
+        "v1",
+        [](size_t size) -> void* {
+            return memory_pool::memory_pool::allocate(size).value_or(nullptr);
+        },
+        [](void* ptr, size_t size) {
+            memory_pool::memory_pool::deallocate(ptr, size);
+        },
+        // 第一版没有调整大小的接口，申请新的空间后复制
+        [](void* ptr, size_t old_size, size_t new_size) -> void* {
+            void* result = memory_pool::memory_pool::allocate(new_size).value_or(nullptr);
+            if (result != nullptr) {
+                memcpy(result, ptr, std::min(old_size, new_size));
+                memory_pool::memory_pool::deallocate(ptr, old_size);
+            }
+            return result;
+        },
+    };
+}
@@ -0,0 +1,21 @@
+//
+// Created by ghost-him on 25-5-9.
+//
+
+#include "replay_allocator.h"
+#include "../memory_pool_v2/memory_pool.h"
+
+replay_allocator memory_pool_v2_allocator() {
+    return {
+        "v2",
+        [](size_t size) -> void* {
+            return memory_pool_v2::memory_pool::allocate(size).value_or(nullptr);
+        },
+        [](void* ptr, size_t size) {
+            memory_pool_v2::memory_pool::deallocate(ptr, size);
+        },
+        [](void* ptr, size_t old_size, size_t new_size) -> void* {
+            return memory_pool_v2::memory_pool::reallocate(ptr, old_size, new_size).value_or(nullptr);
+        },
+    };
+}
@@ -0,0 +1,294 @@
+// 回放 memory_pool_v2 记录的负载（见 memory_pool::start_trace），对比第一版、第二版内存池、malloc 与 std::pmr 的表现
+// 每个记录中的线程对应一个回放线程，默认按记录的时间执行每一次操作，也可以不等待，尽快执行
+// 同一个指针上的操作可能由不同的线程执行，回放时按记录中的顺序等待前一次操作完成
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "replay_allocator.h"
+#include "../memory_pool_v2/trace_recorder.h"
+
+namespace {
+    using memory_pool_v2::trace_event;
+    using memory_pool_v2::trace_operation;
+
+    struct replay_config {
+        std::string trace_path;
+        std::string allocator = "all";
+        // 按记录的时间回放，为 false 时每个线程尽快执行
+        bool faithful = true;
+        // 把申请到的空间全部写一遍，默认只写第一个字节
+        bool touch = false;
+    };
+
+    // 一个回放线程要执行的一次操作
+    struct replay_op {
+        trace_operation operation;
+        // 这是同一个指针上的第几次操作，要等前面的操作都完成以后才能执行
+        uint32_t sequence;
+        uint64_t pointer_id;
+        uint64_t size;
+        uint64_t timestamp_ns;
+    };
+
+    // 一个指针当前的状态，ptr 与 size 由 version 的 release/acquire 保护
+    struct pointer_slot {
+        std::atomic<uint32_t> version = 0;
+        void* ptr = nullptr;
+        size_t size = 0;
+    };
+
+    struct replay_workload {
+        std::vector<std::vector<replay_op>> threads;
+        size_t pointer_count = 0;
+        size_t op_count = 0;
+        uint64_t duration_ns = 0;
+    };
+
+    struct thread_result {
+        std::vector<uint64_t> latencies[3];
+        size_t failed = 0;
+        // 按记录的时间回放时，实际执行的时间比记录的时间最多晚了多少
+        uint64_t max_lag_ns = 0;
+    };
+
+    replay_workload build_workload(const std::vector<trace_event>& events) {
+        replay_workload workload;
+        std::vector<uint32_t> sequences;
+        for (auto& event : events) {
+            if (event.thread_id >= workload.threads.size()) {
+                workload.threads.resize(event.thread_id + 1);
+            }
+            if (event.pointer_id >= sequences.size()) {
+                sequences.resize(event.pointer_id + 1, 0);
+            }
+            workload.threads[event.thread_id].push_back({event.operation, sequences[event.pointer_id]++, event.pointer_id, event.size, event.timestamp_ns});
+        }
+        workload.pointer_count = sequences.size();
+        workload.op_count = events.size();
+        workload.duration_ns = events.empty() ? 0 : events.back().timestamp_ns;
+        return workload;
+    }
+
+    void touch(void* ptr, size_t size, const replay_config& config) {
+        if (ptr == nullptr || size == 0) {
+            return;
+        }
+        if (config.touch) {
+            memset(ptr, 1, size);
+        } else {
+            static_cast<volatile char*>(ptr)[0] = 1;
+        }
+    }
+
+    void wait_until(std::chrono::steady_clock::time_point target) {
+        // 距离较远时先睡眠，最后一小段自旋，避免睡眠的误差
+        constexpr auto SPIN_TIME = std::chrono::microseconds(100);
+        auto now = std::chrono::steady_clock::now();
+        if (target - now > SPIN_TIME) {
+            std::this_thread::sleep_for(target - now - SPIN_TIME);
+        }
+        while (std::chrono::steady_clock::now() < target) {
+        }
+    }
+
+    void replay_thread(const std::vector<replay_op>& ops, std::vector<pointer_slot>& slots, const replay_allocator& allocator,
+                       const replay_config& config, std::chrono::steady_clock::time_point start, thread_result& result) {
+        for (auto& kind : result.latencies) {
+            kind.reserve(ops.size());
+        }
+        for (auto& op : ops) {
+            auto& slot = slots[op.pointer_id];
+            // 等待其他线程完成这个指针上之前的操作
+            while (slot.version.load(std::memory_order_acquire) != op.sequence) {
+                std::this_thread::yield();
+            }
+            if (config.faithful) {
+                const auto target = start + std::chrono::nanoseconds(op.timestamp_ns);
+                wait_until(target);
+                const uint64_t lag = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - target).count();
+                result.max_lag_ns = std::max(result.max_lag_ns, lag);
+            }
+
+            const auto begin = std::chrono::steady_clock::now();
+            if (op.operation == trace_operation::allocate) {
+                slot.ptr = allocator.allocate(op.size);
+                slot.size = op.size;
+            } else if (slot.ptr == nullptr) {
+                // 之前的申请失败了，跳过之后的操作
+            } else if (op.operation == trace_operation::deallocate) {
+                allocator.deallocate(slot.ptr, slot.size);
+                slot.ptr = nullptr;
+            } else {
+                void* new_ptr = allocator.reallocate(slot.ptr, slot.size, op.size);
+                // 失败时原来的空间不变，之后仍然按原来的大小回收
+                if (new_ptr != nullptr) {
+                    slot.ptr = new_ptr;
+                    slot.size = op.size;
+                }
+            }
+            const auto end = std::chrono::steady_clock::now();
+            result.latencies[static_cast<size_t>(op.operation)].push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            if (op.operation != trace_operation::deallocate) {
+                if (slot.ptr == nullptr) {
+                    result.failed++;
+                } else {
+                    touch(slot.ptr, slot.size, config);
+                }
+            }
+            slot.version.store(op.sequence + 1, std::memory_order_release);
+        }
+    }
+
+    size_t peak_rss_kb() {
+        rusage usage {};
+        getrusage(RUSAGE_SELF, &usage);
+        return static_cast<size_t>(usage.ru_maxrss);
+    }
+
+    void print_latencies(const char* name, std::vector<uint64_t>& latencies) {
+        if (latencies.empty()) {
+            return;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) {
+            return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+        };
+        std::cout << "  " << std::left << std::setw(10) << name << std::right << std::setw(12) << latencies.size()
+                  << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.9) << std::setw(10) << percentile(0.99)
+                  << std::setw(10) << percentile(0.999) << std::setw(12) << latencies.back() << std::endl;
+    }
+
+    void run_allocator(const replay_workload& workload, const replay_allocator& allocator, const replay_config& config) {
+        const size_t rss_before_kb = peak_rss_kb();
+        std::vector<pointer_slot> slots(workload.pointer_count);
+        std::vector<thread_result> results(workload.threads.size());
+        std::vector<std::thread> threads;
+        // 留出创建线程的时间，使所有线程从同一个起点开始按时间回放
+        const auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(10);
+        for (size_t i = 0; i < workload.threads.size(); i++) {
+            threads.emplace_back(replay_thread, std::cref(workload.threads[i]), std::ref(slots), std::cref(allocator), std::cref(config), start,
+                                 std::ref(results[i]));
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        const double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        const size_t peak_kb = peak_rss_kb();
+
+        std::vector<uint64_t> latencies[3];
+        size_t failed = 0;
+        uint64_t max_lag_ns = 0;
+        uint64_t total_ns = 0;
+        for (auto& result : results) {
+            for (size_t kind = 0; kind < 3; kind++) {
+                for (uint64_t latency : result.latencies[kind]) {
+                    total_ns += latency;
+                }
+                latencies[kind].insert(latencies[kind].end(), result.latencies[kind].begin(), result.latencies[kind].end());
+            }
+            failed += result.failed;
+            max_lag_ns = std::max(max_lag_ns, result.max_lag_ns);
+        }
+
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "[" << allocator.name << "] 耗时 " << wall_ms << " ms, 吞吐量 " << static_cast<double>(workload.op_count) / wall_ms / 1000.0
+                  << " 百万次/秒, 操作本身的耗时合计 " << static_cast<double>(total_ns) / 1e6 << " ms";
+        if (config.faithful) {
+            std::cout << ", 最多落后记录的时间 " << static_cast<double>(max_lag_ns) / 1e3 << " us";
+        }
+        std::cout << std::endl;
+        std::cout << "  " << std::left << std::setw(10) << "操作(ns)" << std::right << std::setw(12) << "次数" << std::setw(10) << "p50"
+                  << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(12) << "最大" << std::endl;
+        print_latencies("申请", latencies[static_cast<size_t>(trace_operation::allocate)]);
+        print_latencies("回收", latencies[static_cast<size_t>(trace_operation::deallocate)]);
+        print_latencies("调整大小", latencies[static_cast<size_t>(trace_operation::reallocate)]);
+        std::cout << "  峰值 RSS " << static_cast<double>(peak_kb) / 1024.0 << " MB（回放前 " << static_cast<double>(rss_before_kb) / 1024.0
+                  << " MB）, 申请失败 " << failed << " 次" << std::endl;
+
+        // 记录结束时仍然存活的指针，回放结束后归还，不计入统计
+        for (auto& slot : slots) {
+            if (slot.ptr != nullptr) {
+                allocator.deallocate(slot.ptr, slot.size);
+            }
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    replay_config config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--trace=")) {
+            config.trace_path = arg.substr(8);
+        } else if (arg.starts_with("--allocator=")) {
+            config.allocator = arg.substr(12);
+        } else if (arg == "--timing=faithful") {
+            config.faithful = true;
+        } else if (arg == "--timing=asap") {
+            config.faithful = false;
+        } else if (arg == "--touch") {
+            config.touch = true;
+        } else {
+            config.trace_path.clear();
+            break;
+        }
+    }
+    if (config.trace_path.empty()) {
+        std::cerr << "用法: " << argv[0] << " --trace=FILE [--allocator=all|v1|v2|malloc|pmr] [--timing=faithful|asap] [--touch]" << std::endl;
+        return 1;
+    }
+
+    auto events = memory_pool_v2::trace_reader::read_file(config.trace_path);
+    if (!events.has_value()) {
+        std::cerr << "无法读取记录文件: " << config.trace_path << std::endl;
+        return 1;
+    }
+    const replay_workload workload = build_workload(events.value());
+    events.reset();
+
+    std::vector<replay_allocator> allocators;
+    for (auto& allocator : {memory_pool_v1_allocator(), memory_pool_v2_allocator(), malloc_allocator(), pmr_allocator()}) {
+        if (config.allocator == "all" || config.allocator == allocator.name) {
+            allocators.push_back(allocator);
+        }
+    }
+    if (allocators.empty()) {
+        std::cerr << "未知的分配器: " << config.allocator << std::endl;
+        return 1;
+    }
+
+    std::cout << "回放 " << config.trace_path << ": " << workload.threads.size() << " 个线程, " << workload.op_count << " 次操作, 记录时长 "
+              << std::fixed << std::setprecision(2) << static_cast<double>(workload.duration_ns) / 1e6 << " ms, "
+              << (config.faithful ? "按记录的时间回放" : "尽快回放") << std::endl;
+    if (allocators.size() == 1) {
+        run_allocator(workload, allocators.front(), config);
+        return 0;
+    }
+    // 每个分配器在新的子进程中回放，互不影响峰值 RSS
+    for (auto& allocator : allocators) {
+        std::cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            run_allocator(workload, allocator, config);
+            std::cout.flush();
+            _exit(0);
+        }
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return 0;
+}
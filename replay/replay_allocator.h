@@ -0,0 +1,26 @@
+//
+// Created by ghost-him on 25-5-9.
+//
+
+#ifndef REPLAY_ALLOCATOR_H
+#define REPLAY_ALLOCATOR_H
+#include <cstddef>
+
+// 回放与扩展性测试使用的分配器，只保留需要的三个操作
+struct replay_allocator {
+    const char* name;
+    // 失败时返回 nullptr
+    void* (*allocate)(size_t size);
+    void (*deallocate)(void* ptr, size_t size);
+    // 失败时返回 nullptr，原来的空间不变
+    void* (*reallocate)(void* ptr, size_t old_size, size_t new_size);
+};
+
+// 两个版本的内存池使用了相同的头文件保护宏，不能在同一个源文件中包含，所以分别在各自的源文件中实现
+replay_allocator memory_pool_v1_allocator();
+replay_allocator memory_pool_v2_allocator();
+replay_allocator malloc_allocator();
+// std::pmr::synchronized_pool_resource，上游为默认的 new/delete
+replay_allocator pmr_allocator();
+
+#endif //REPLAY_ALLOCATOR_H
@@ -0,0 +1,439 @@
+// 线程扩展性测试：对每一个分配器（第一版、第二版内存池、malloc、std::pmr）依次使用 1, 2, 4, ... N 个线程执行同样的负载
+// 每个线程执行的操作数固定（弱扩展），每一个点都在单独的子进程中运行，输出吞吐量、延迟的百分位数与 RSS
+// 结果可以输出为 JSON 或 CSV，便于画出扩展性曲线或者在每天的测试中比较
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <latch>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "replay_allocator.h"
+#include "../memory_pool_v2/benchmarks/latency_histogram.h"
+#include "../memory_pool_v2/benchmarks/workload.h"
+
+namespace {
+    enum class output_format { text, json, csv };
+
+    struct sweep_config {
+        workload::workload_config workload;
+        std::vector<std::string> allocators = {"v1", "v2", "malloc", "pmr"};
+        std::vector<unsigned int> thread_counts;
+        // 把第 i 个线程绑定到允许使用的第 i 个 CPU 上（超过 CPU 个数时循环）
+        bool pin = false;
+        output_format format = output_format::text;
+        std::string output_path;
+        size_t sample_interval_ms = 10;
+    };
+
+    // 一个点的结果，由子进程通过共享内存传回
+    struct point_result {
+        bool completed = false;
+        uint64_t operations = 0;
+        uint64_t failed_allocations = 0;
+        double seconds = 0;
+        double ops_per_second = 0;
+        latency::percentiles allocate;
+        latency::percentiles deallocate;
+        size_t baseline_rss = 0;
+        // 运行期间采样到的最大 RSS 相对于运行前的增量
+        size_t peak_rss = 0;
+        // 全部归还、线程退出以后仍然占用的 RSS 增量
+        size_t retained_rss = 0;
+    };
+
+    struct point {
+        std::string allocator;
+        unsigned int threads = 0;
+        point_result result;
+    };
+
+    // 每个工作线程自己的统计，结束后由主线程合并
+    struct thread_result {
+        latency::histogram allocate;
+        latency::histogram deallocate;
+        uint64_t failed_allocations = 0;
+        std::chrono::steady_clock::time_point end;
+    };
+
+    size_t read_rss_bytes() {
+        std::ifstream statm("/proc/self/statm");
+        size_t total_pages = 0;
+        size_t resident_pages = 0;
+        if (!(statm >> total_pages >> resident_pages)) {
+            return 0;
+        }
+        return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    std::vector<int> allowed_cpus() {
+        std::vector<int> result;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &set)) {
+                    result.push_back(cpu);
+                }
+            }
+        }
+        return result;
+    }
+
+    void pin_current_thread(int cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    void worker(const std::vector<workload::operation>& ops, const replay_allocator& allocator, int cpu, std::latch& ready,
+                std::latch& start, thread_result& result) {
+        if (cpu >= 0) {
+            pin_current_thread(cpu);
+        }
+        const latency::timer& timer = latency::timer::get_instance();
+        const size_t allocate_count = std::count_if(ops.begin(), ops.end(), [](const workload::operation& op) { return op.type == workload::op_type::allocate; });
+        std::vector<std::pair<void*, size_t>> allocations;
+        allocations.reserve(allocate_count);
+        // 先写一遍，使记录用的缓冲区在记录运行前的 RSS 时已经计入
+        allocations.resize(allocate_count);
+        allocations.clear();
+        ready.count_down();
+        start.wait();
+
+        for (auto& op : ops) {
+            if (op.type == workload::op_type::allocate) {
+                const uint64_t begin = timer.now();
+                void* ptr = allocator.allocate(op.size);
+                result.allocate.record(timer.elapsed_ns(begin, timer.now()));
+                allocations.emplace_back(ptr, op.size);
+                if (ptr == nullptr) {
+                    result.failed_allocations++;
+                    continue;
+                }
+                // 写入每一页，使 RSS 反映实际使用的内存
+                for (size_t offset = 0; offset < op.size; offset += 4096) {
+                    static_cast<volatile char*>(ptr)[offset] = 1;
+                }
+            } else {
+                auto& allocation = allocations[op.target];
+                if (allocation.first == nullptr) {
+                    continue;
+                }
+                const uint64_t begin = timer.now();
+                allocator.deallocate(allocation.first, allocation.second);
+                result.deallocate.record(timer.elapsed_ns(begin, timer.now()));
+                allocation.first = nullptr;
+            }
+        }
+        result.end = std::chrono::steady_clock::now();
+        // 清理不计入时间
+        for (auto& [ptr, size] : allocations) {
+            if (ptr != nullptr) {
+                allocator.deallocate(ptr, size);
+            }
+        }
+    }
+
+    point_result run_point(const std::vector<std::vector<workload::operation>>& ops, const replay_allocator& allocator, const sweep_config& config) {
+        point_result result;
+        const auto cpus = allowed_cpus();
+        const unsigned int thread_count = static_cast<unsigned int>(ops.size());
+        std::vector<thread_result> thread_results(thread_count);
+        std::latch ready(thread_count);
+        std::latch start(1);
+        std::vector<std::thread> threads;
+        for (unsigned int i = 0; i < thread_count; i++) {
+            const int cpu = config.pin && !cpus.empty() ? cpus[i % cpus.size()] : -1;
+            threads.emplace_back(worker, std::cref(ops[i]), std::cref(allocator), cpu, std::ref(ready), std::ref(start), std::ref(thread_results[i]));
+        }
+        ready.wait();
+        result.baseline_rss = read_rss_bytes();
+
+        std::atomic<bool> sampling = true;
+        std::thread sampler([&] {
+            while (sampling.load(std::memory_order_relaxed)) {
+                const size_t rss = read_rss_bytes();
+                result.peak_rss = std::max(result.peak_rss, rss > result.baseline_rss ? rss - result.baseline_rss : 0);
+                std::this_thread::sleep_for(std::chrono::milliseconds(config.sample_interval_ms));
+            }
+        });
+        const auto begin = std::chrono::steady_clock::now();
+        start.count_down();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        sampling.store(false, std::memory_order_relaxed);
+        sampler.join();
+        const size_t rss_after = read_rss_bytes();
+        result.retained_rss = rss_after > result.baseline_rss ? rss_after - result.baseline_rss : 0;
+
+        latency::histogram allocate;
+        latency::histogram deallocate;
+        auto end = begin;
+        for (auto& thread_result : thread_results) {
+            allocate.merge(thread_result.allocate);
+            deallocate.merge(thread_result.deallocate);
+            result.failed_allocations += thread_result.failed_allocations;
+            end = std::max(end, thread_result.end);
+        }
+        result.allocate = latency::summarize(allocate);
+        result.deallocate = latency::summarize(deallocate);
+        result.operations = allocate.count() + deallocate.count();
+        result.seconds = std::chrono::duration<double>(end - begin).count();
+        result.ops_per_second = result.seconds > 0 ? static_cast<double>(result.operations) / result.seconds : 0;
+        result.completed = true;
+        return result;
+    }
+
+    // 在子进程中运行一个点，每个点都从没有使用过分配器的进程状态开始
+    point_result run_point_in_child(const std::vector<std::vector<workload::operation>>& ops, const replay_allocator& allocator,
+                                    const sweep_config& config) {
+        void* shared = mmap(nullptr, sizeof(point_result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (shared == MAP_FAILED) {
+            return run_point(ops, allocator, config);
+        }
+        auto* result = new (shared) point_result();
+        std::cout.flush();
+        std::cerr.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            *result = run_point(ops, allocator, config);
+            _exit(0);
+        }
+        point_result copy;
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+            copy = *result;
+        } else {
+            copy = run_point(ops, allocator, config);
+        }
+        munmap(shared, sizeof(point_result));
+        return copy;
+    }
+
+    std::string json_string(std::string_view text) {
+        std::string result = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                result += '\\';
+            }
+            result += c;
+        }
+        return result + "\"";
+    }
+
+    void write_percentiles_json(std::ostream& out, const latency::percentiles& p) {
+        out << "{\"count\": " << p.count << ", \"mean\": " << p.mean << ", \"p50\": " << p.p50 << ", \"p90\": " << p.p90 << ", \"p99\": " << p.p99
+            << ", \"p999\": " << p.p999 << ", \"max\": " << p.max << "}";
+    }
+
+    void write_json(std::ostream& out, const sweep_config& config, const std::vector<point>& points) {
+        const auto& workload = config.workload;
+        out << std::fixed << std::setprecision(3);
+        out << "{\n  \"config\": {\"preset\": " << json_string(workload.preset) << ", \"sizes\": " << json_string(workload.sizes.describe())
+            << ", \"alloc_percent\": " << workload.alloc_percent << ", \"free_order\": " << json_string(workload::free_order_name(workload.order))
+            << ", \"lifetime\": " << json_string(workload.lifetime.describe()) << ", \"ops_per_thread\": " << workload.ops_per_thread
+            << ", \"seed\": " << workload.seed << ", \"pin\": " << (config.pin ? "true" : "false")
+            << ", \"cpus\": " << allowed_cpus().size() << ", \"timer\": " << json_string(latency::timer::get_instance().uses_tsc() ? "tsc" : "steady_clock") << "},\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < points.size(); i++) {
+            const auto& p = points[i];
+            const auto& r = p.result;
+            out << (i == 0 ? "\n" : ",\n") << "    {\"allocator\": " << json_string(p.allocator) << ", \"threads\": " << p.threads
+                << ", \"completed\": " << (r.completed ? "true" : "false") << ", \"operations\": " << r.operations
+                << ", \"failed_allocations\": " << r.failed_allocations << ", \"seconds\": " << r.seconds << ", \"ops_per_second\": " << r.ops_per_second
+                << ", \"allocate_ns\": ";
+            write_percentiles_json(out, r.allocate);
+            out << ", \"deallocate_ns\": ";
+            write_percentiles_json(out, r.deallocate);
+            out << ", \"baseline_rss_bytes\": " << r.baseline_rss << ", \"peak_rss_bytes\": " << r.peak_rss << ", \"retained_rss_bytes\": " << r.retained_rss << "}";
+        }
+        out << "\n  ]\n}\n";
+    }
+
+    void write_csv(std::ostream& out, const std::vector<point>& points) {
+        out << std::fixed << std::setprecision(3);
+        out << "allocator,threads,completed,operations,failed_allocations,seconds,ops_per_second";
+        for (const char* kind : {"allocate", "deallocate"}) {
+            for (const char* field : {"mean", "p50", "p90", "p99", "p999", "max"}) {
+                out << "," << kind << "_" << field << "_ns";
+            }
+        }
+        out << ",baseline_rss_bytes,peak_rss_bytes,retained_rss_bytes\n";
+        for (const auto& p : points) {
+            const auto& r = p.result;
+            out << p.allocator << "," << p.threads << "," << (r.completed ? 1 : 0) << "," << r.operations << "," << r.failed_allocations << ","
+                << r.seconds << "," << r.ops_per_second;
+            for (const auto* latency : {&r.allocate, &r.deallocate}) {
+                out << "," << latency->mean << "," << latency->p50 << "," << latency->p90 << "," << latency->p99 << "," << latency->p999 << ","
+                    << latency->max;
+            }
+            out << "," << r.baseline_rss << "," << r.peak_rss << "," << r.retained_rss << "\n";
+        }
+    }
+
+    void write_text(std::ostream& out, const std::vector<point>& points) {
+        out << std::fixed << std::setprecision(2);
+        out << std::left << std::setw(8) << "分配器" << std::right << std::setw(6) << "线程" << std::setw(14) << "百万次/秒" << std::setw(12)
+            << "申请 p50" << std::setw(12) << "申请 p99" << std::setw(12) << "申请 p99.9" << std::setw(12) << "归还 p50" << std::setw(12)
+            << "归还 p99" << std::setw(14) << "峰值 RSS MB" << std::endl;
+        for (const auto& p : points) {
+            const auto& r = p.result;
+            out << std::left << std::setw(8) << p.allocator << std::right << std::setw(6) << p.threads;
+            if (!r.completed) {
+                out << "  子进程异常退出" << std::endl;
+                continue;
+            }
+            out << std::setw(14) << r.ops_per_second / 1e6 << std::setw(12) << r.allocate.p50 << std::setw(12) << r.allocate.p99 << std::setw(12)
+                << r.allocate.p999 << std::setw(12) << r.deallocate.p50 << std::setw(12) << r.deallocate.p99 << std::setw(14)
+                << static_cast<double>(r.peak_rss) / 1024.0 / 1024.0 << std::endl;
+        }
+    }
+
+    std::vector<std::string> split(std::string_view text) {
+        std::vector<std::string> result;
+        while (!text.empty()) {
+            const size_t comma = text.find(',');
+            result.emplace_back(text.substr(0, comma));
+            text = comma == std::string_view::npos ? std::string_view() : text.substr(comma + 1);
+        }
+        return result;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    sweep_config config;
+    unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    bool invalid = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::string_view(argv[i]).starts_with("--preset=") && workload::parse_argument(config.workload, argv[i]) != workload::parse_result::ok) {
+            invalid = true;
+        }
+    }
+    for (int i = 1; i < argc && !invalid; i++) {
+        std::string_view arg = argv[i];
+        if (arg.starts_with("--preset=")) {
+            continue;
+        }
+        if (arg.starts_with("--threads=")) {
+            // 扩展性测试的线程数由 --max-threads 与 --thread-counts 决定
+            invalid = true;
+            break;
+        }
+        auto workload_result = workload::parse_argument(config.workload, arg);
+        if (workload_result == workload::parse_result::ok) {
+            continue;
+        }
+        if (workload_result == workload::parse_result::invalid) {
+            invalid = true;
+        } else if (arg.starts_with("--allocator=")) {
+            if (arg.substr(12) != "all") {
+                config.allocators = split(arg.substr(12));
+            }
+        } else if (arg.starts_with("--max-threads=")) {
+            auto value = workload::parse_size(arg.substr(14));
+            invalid = !value || *value == 0;
+            max_threads = value.value_or(1);
+        } else if (arg.starts_with("--thread-counts=")) {
+            for (auto& count : split(arg.substr(16))) {
+                auto value = workload::parse_size(count);
+                invalid |= !value || *value == 0;
+                config.thread_counts.push_back(static_cast<unsigned int>(value.value_or(1)));
+            }
+        } else if (arg == "--pin") {
+            config.pin = true;
+        } else if (arg.starts_with("--format=")) {
+            if (arg.substr(9) == "json") {
+                config.format = output_format::json;
+            } else if (arg.substr(9) == "csv") {
+                config.format = output_format::csv;
+            } else {
+                invalid = arg.substr(9) != "text";
+            }
+        } else if (arg.starts_with("--output=")) {
+            config.output_path = arg.substr(9);
+        } else if (arg.starts_with("--sample-ms=")) {
+            auto value = workload::parse_size(arg.substr(12));
+            invalid = !value || *value == 0;
+            config.sample_interval_ms = value.value_or(10);
+        } else {
+            invalid = true;
+        }
+    }
+
+    std::vector<replay_allocator> allocators;
+    for (auto& name : config.allocators) {
+        bool found = false;
+        for (auto& allocator : {memory_pool_v1_allocator(), memory_pool_v2_allocator(), malloc_allocator(), pmr_allocator()}) {
+            if (name == allocator.name) {
+                allocators.push_back(allocator);
+                found = true;
+            }
+        }
+        invalid |= !found;
+    }
+    if (invalid) {
+        std::cerr << "用法: " << argv[0] << " [--allocator=all|v1,v2,malloc,pmr] [--max-threads=N] [--thread-counts=1,2,4] [--pin]\n"
+                  << "    [--format=text|json|csv] [--output=FILE] [--sample-ms=10]\n    " << workload::usage() << std::endl;
+        return 1;
+    }
+    if (config.thread_counts.empty()) {
+        for (unsigned int threads = 1; threads < max_threads; threads *= 2) {
+            config.thread_counts.push_back(threads);
+        }
+        config.thread_counts.push_back(max_threads);
+    }
+
+    std::cerr << "扩展性测试: 线程数";
+    for (unsigned int threads : config.thread_counts) {
+        std::cerr << " " << threads;
+    }
+    std::cerr << ", 每个线程 " << config.workload.ops_per_thread << " 次操作, 大小 " << config.workload.sizes.describe()
+              << (config.pin ? ", 绑定 CPU" : "") << std::endl;
+
+    // 先校准计时器，子进程会继承校准的结果
+    latency::timer::get_instance();
+    std::vector<point> points;
+    for (unsigned int threads : config.thread_counts) {
+        auto workload_config = config.workload;
+        workload_config.threads = threads;
+        const auto ops = workload::generate(workload_config);
+        for (auto& allocator : allocators) {
+            std::cerr << "  " << allocator.name << " x " << threads << " ..." << std::flush;
+            points.push_back({allocator.name, threads, run_point_in_child(ops, allocator, config)});
+            std::cerr << " " << std::fixed << std::setprecision(2) << points.back().result.ops_per_second / 1e6 << " 百万次/秒" << std::endl;
+        }
+    }
+
+    std::ofstream file;
+    if (!config.output_path.empty()) {
+        file.open(config.output_path);
+        if (!file.is_open()) {
+            std::cerr << "无法创建输出文件: " << config.output_path << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = config.output_path.empty() ? std::cout : file;
+    switch (config.format) {
+        case output_format::text: write_text(out, points); break;
+        case output_format::json: write_json(out, config, points); break;
+        case output_format::csv: write_csv(out, points); break;
+    }
+    return 0;
+}